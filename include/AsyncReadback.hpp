@@ -0,0 +1,93 @@
+#ifndef ASYNCREADBACK_HPP_INCLUDED
+#define ASYNCREADBACK_HPP_INCLUDED
+
+#include <GL/glew.h>
+#include <SFML/OpenGL.hpp>
+
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+/* Class for copying textures or the framebuffer back to the CPU
+ * without stalling the pipeline.
+ *
+ * Each request queues a copy of the texture into one of a ring of
+ * pixel buffer objects, followed by a fence. The copy is retrieved
+ * a few frames later, once the fence is signaled, so the CPU never
+ * waits for the GPU.
+ *
+ * If every buffer of the ring is still pending, the request is dropped.
+ *
+ * The pixels are read as RGBA, bottom row first, which is the grid order
+ * of the Water textures. Components are either bytes (GL_UNSIGNED_BYTE)
+ * or floats (GL_FLOAT).
+ */
+class AsyncReadback
+{
+    public:
+        AsyncReadback (sf::Vector2u size, unsigned int ringSize=3, GLenum type=GL_UNSIGNED_BYTE);
+        ~AsyncReadback();
+
+        /* Disable copy constructor and assignment operator */
+        AsyncReadback (AsyncReadback const& original) = delete;
+        AsyncReadback& operator= (AsyncReadback const& original) = delete;
+
+        sf::Vector2u getSize() const;
+
+        /* Queues the copy of the texture, tagged with the step index.
+         * The texture must have the size given at construction.
+         * Returns false if the request was dropped because the ring is full. */
+        bool request (sf::Texture const& texture, unsigned long step);
+
+        /* Same as above, for the bottom left area of the current read
+         * framebuffer (the back buffer of the active window, by default). */
+        bool requestFramebuffer (unsigned long step);
+
+        /* Never blocks.
+         * If the oldest pending copy is complete, stores it in pixels (RGBA),
+         * its step index in step, and returns true.
+         * Otherwise returns false. */
+        bool retrieve (std::vector<sf::Uint8>& pixels, unsigned long& step);
+
+        /* Same as above, for a readback of type GL_FLOAT. */
+        bool retrieve (std::vector<float>& pixels, unsigned long& step);
+
+        /* Number of pending copies. */
+        unsigned int getPendingCount() const;
+
+        /* Number of requests dropped since construction. */
+        unsigned long getDroppedCount() const;
+
+    private:
+        struct Slot
+        {
+            GLuint bufferID;
+            GLsync fence;
+            unsigned long step;
+        };
+
+        /* Returns the slot for a new request, or nullptr if the ring is full. */
+        Slot* acquireSlot (unsigned long step);
+
+        /* Polls the oldest pending copy and, if complete, copies it
+         * to destination which must hold getBufferSize() bytes. */
+        bool retrieveData (void* destination, unsigned long& step);
+
+        /* In bytes */
+        std::size_t getBufferSize() const;
+
+    private:
+        sf::Vector2u _size;
+        GLenum _type;
+
+        std::vector<Slot> _slots;
+        unsigned int _oldestSlot;
+        unsigned int _pendingCount;
+
+        unsigned long _droppedCount;
+};
+
+#endif // ASYNCREADBACK_HPP_INCLUDED
@@ -0,0 +1,89 @@
+#ifndef ASYNCUPLOAD_HPP_INCLUDED
+#define ASYNCUPLOAD_HPP_INCLUDED
+
+#include <GL/glew.h>
+#include <SFML/OpenGL.hpp>
+
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+/* Class for streaming fields from the CPU to a texture
+ * without stalling the pipeline, the counterpart of AsyncReadback.
+ *
+ * Each frame is written into one of a ring of pixel buffer objects,
+ * then copied to the texture by the GPU, followed by a fence. A buffer
+ * is only written again once its fence is signaled: the producer fills
+ * the next frame while the GPU still copies the previous ones.
+ *
+ * With GL_ARB_buffer_storage the buffers are mapped once and for all
+ * (persistent and coherent mapping), otherwise they are mapped for the
+ * time of each frame, without synchronization.
+ *
+ * The texture holds 2 float channels (RG32F), bottom row first, and is
+ * smooth: it can be sampled at any resolution.
+ */
+class AsyncUpload
+{
+    public:
+        AsyncUpload (sf::Vector2u size, unsigned int ringSize=3);
+        ~AsyncUpload();
+
+        /* Disable copy constructor and assignment operator */
+        AsyncUpload (AsyncUpload const& original) = delete;
+        AsyncUpload& operator= (AsyncUpload const& original) = delete;
+
+        sf::Vector2u getSize() const;
+
+        /* Never blocks.
+         * Returns the memory of the next frame (2 floats per texel, bottom
+         * row first), or nullptr if every buffer of the ring is still being
+         * copied. The memory can be written from any thread, until
+         * endFrame() which must be called from the thread of the context. */
+        float* beginFrame ();
+
+        /* Queues the copy of the frame given by beginFrame() to the texture. */
+        void endFrame ();
+
+        /* Same as beginFrame, copying field, then endFrame.
+         * Returns false if the frame was dropped because the ring is full. */
+        bool upload (const float* field);
+
+        /* Updated by the GPU with the last frame ended. */
+        sf::Texture const& getTexture() const;
+
+        /* Number of frames ended since construction. */
+        unsigned long getUploadedCount() const;
+
+        /* Number of frames dropped since construction. */
+        unsigned long getDroppedCount() const;
+
+    private:
+        struct Slot
+        {
+            GLuint bufferID;
+            GLsync fence;
+            float* data; //mapped memory, persistently or during a frame
+        };
+
+        /* In bytes */
+        std::size_t getBufferSize() const;
+
+    private:
+        sf::Vector2u _size;
+        bool _persistent;
+
+        sf::Texture _texture;
+
+        std::vector<Slot> _slots;
+        unsigned int _nextSlot;
+        bool _writing; //between beginFrame and endFrame
+
+        unsigned long _uploadedCount;
+        unsigned long _droppedCount;
+};
+
+#endif // ASYNCUPLOAD_HPP_INCLUDED
@@ -0,0 +1,41 @@
+#ifndef CONTROLPROTOCOL_HPP_INCLUDED
+#define CONTROLPROTOCOL_HPP_INCLUDED
+
+#include <cstdint>
+
+
+/* Binary protocol of the control socket (see ControlServer).
+ *
+ * A client connects to the Unix domain socket and writes commands
+ * back to back, with no reply: each one is a ControlCommand of 20 bytes,
+ * in the machine's byte order. Commands may be split across writes.
+ * A command of unknown type closes the connection, once the commands
+ * before it are applied.
+ *
+ * The values are those of the matching InputJournal events, and of the
+ * Water and Camera methods they end up calling.
+ *
+ * This header only depends on the standard library, for the clients.
+ */
+
+enum class ControlCommandType : std::uint32_t
+{
+    Touch = 0, //values: x, y, radius, extremum
+    Init = 1, //no value
+    Camera = 2, //values: distance, latitude, longitude
+    Scroll = 3, //values: x, y offset in cells
+    Parameters = 4 //values: propagation, friction, elasticity
+};
+
+struct ControlCommand
+{
+    ControlCommandType type;
+    float values[4];
+};
+
+static_assert(sizeof(ControlCommand) == 20, "the commands must be packed");
+
+/* Default path of the socket, in the working directory */
+const char CONTROL_SOCKET_PATH[] = "control.sock";
+
+#endif // CONTROLPROTOCOL_HPP_INCLUDED
@@ -0,0 +1,93 @@
+#ifndef CONTROLSERVER_HPP_INCLUDED
+#define CONTROLSERVER_HPP_INCLUDED
+
+#include "ControlProtocol.hpp"
+#include "SpscQueue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* Class for driving the simulation from other processes of the host,
+ * through a Unix domain socket (see ControlProtocol.hpp for the protocol).
+ *
+ * A background thread accepts any number of clients and reads their
+ * commands into a lock-free queue, which the render thread drains once
+ * per frame: the render thread never waits for the socket nor for a lock.
+ *
+ * When the queue is full, the server stops reading until the next drain,
+ * so that the clients are slowed down by the socket instead of losing
+ * commands.
+ *
+ * The socket file is removed when the server is destroyed.
+ */
+class ControlServer
+{
+    public:
+        /* Throws an exception if the socket can't be created.
+         * A socket file left by a previous run is replaced. */
+        explicit ControlServer (std::string const& path=CONTROL_SOCKET_PATH,
+                                std::size_t queueCapacity=65536);
+        ~ControlServer();
+
+        /* Disable copy constructor and assignment operator */
+        ControlServer (ControlServer const& original) = delete;
+        ControlServer& operator= (ControlServer const& original) = delete;
+
+        std::string const& getPath() const;
+
+        /* Never blocks.
+         * Appends the commands received since the last call to commands,
+         * in their order of arrival, and returns their number. */
+        std::size_t drain (std::vector<ControlCommand>& commands);
+
+        /* Number of commands received since construction. */
+        unsigned long getReceivedCount() const;
+
+        /* Number of connections closed for an invalid command. */
+        unsigned long getRejectedCount() const;
+
+    private:
+        struct Client
+        {
+            int fd;
+            std::vector<ControlCommand> buffer; //received, not queued yet
+            std::size_t size; //in bytes, the last command may be partial
+            bool closed; //by the client, the buffer is still to be queued
+        };
+
+        /* Background thread: accepts the clients and reads their commands. */
+        void run();
+
+        void accept();
+
+        /* Reads what the client sent. Returns false once it can be removed. */
+        bool read (Client& client);
+
+        /* Queues the complete commands of the buffer, as many as fit.
+         * Returns false once the commands before an invalid one are queued. */
+        bool queue (Client& client);
+
+        static bool isBacklogged (Client const& client);
+
+    private:
+        static const std::size_t BUFFER_COMMANDS = 4096;
+
+        std::string _path;
+        int _socket;
+        int _wakeUpPipe[2]; //written when stopping
+
+        SpscQueue<ControlCommand> _queue;
+        std::atomic<unsigned long> _receivedCount;
+        std::atomic<unsigned long> _rejectedCount;
+
+        /* Only accessed by the background thread */
+        std::vector<Client> _clients;
+
+        std::thread _thread;
+};
+
+#endif // CONTROLSERVER_HPP_INCLUDED
@@ -0,0 +1,99 @@
+#ifndef CPULIGHTSRENDERER_HPP_INCLUDED
+#define CPULIGHTSRENDERER_HPP_INCLUDED
+
+#include "Renderer.hpp"
+#include "CpuTexture.hpp"
+#include "ThreadPool.hpp"
+
+#include "glm.hpp"
+
+#include <SFML/System/Vector2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+
+/* CPU counterpart of LightsRenderer (Points mode, without amortization),
+ * for computing the lights hitting the ground without an OpenGL context.
+ *
+ * The light particles are refracted through the heightmap as in
+ * shaders/computeLights.vert, 4 at a time with SSE2, and splatted into
+ * one accumulation buffer per thread: the threads share no memory while
+ * splatting, so they need neither atomics nor locks. The buffers are then
+ * summed by bands of rows, on all the threads, and post-processed as in
+ * shaders/processLights.frag, relative to the average luminosity.
+ */
+class CpuLightsRenderer: public Renderer
+{
+    public:
+        /* threadsCount=0 for as many threads as the hardware runs. */
+        CpuLightsRenderer (unsigned int quality,
+                           float amplitude=0.3f,
+                           float waterLevel=0.5f,
+                           float eta=0.8f,
+                           glm::vec3 const& lightDir=glm::vec3(0,0,-1),
+                           unsigned int threadsCount=0);
+
+        /* Disable copy constructor and assignment operator */
+        CpuLightsRenderer (CpuLightsRenderer const& original) = delete;
+        CpuLightsRenderer& operator= (CpuLightsRenderer const& original) = delete;
+
+        /* Computes the raw lights and then processes them.
+         * The heightmap (RGBA, bottom row first) must be in the format
+         * of Water::getHeightmap(). */
+        void update (const std::uint8_t* heightmap, sf::Vector2u heightmapSize);
+
+        /* Final lights (RGBA, bottom row first), quality x quality:
+         * the content of LightsRenderer::getTexture(). */
+        std::vector<std::uint8_t> const& getPixels() const;
+
+        /* Raw lights, before post-processing: one float per texel. */
+        std::vector<float> const& getRawLights() const;
+
+        /* Size of the lights texture. */
+        void setQuality (unsigned int quality);
+        unsigned int getQuality() const;
+
+        /* Number of particles per texel of the lights texture, along each side. */
+        void setParticlesPerPixel (unsigned int particles);
+        unsigned int getParticlesPerPixel() const;
+
+    private:
+        /* Allocates the buffers. */
+        void createBuffers ();
+
+        /* Refracts the particles of rows [firstRow, lastRow) of the lattice
+         * and adds them to accumulation. */
+        void splatParticles (CpuTexture const& heightmap,
+                             unsigned int firstRow,
+                             unsigned int lastRow,
+                             float* accumulation) const;
+
+        /* Sums the accumulation buffers into the raw lights, and clears them. */
+        void computeRawLights ();
+
+        /* Post-processes the raw lights: luminosity range adjustments,
+         * relative to the average luminosity. */
+        void computeProcessedLights ();
+
+    private:
+        static const unsigned int BAND_HEIGHT = 16;
+
+        unsigned int _quality;
+        unsigned int _partPerPixel;
+        float _intensity;
+
+        /* Exposure: the luminosity is shifted by _exposureShift*average
+         * then stretched by _exposureStretch/average */
+        float _exposureShift;
+        float _exposureStretch;
+
+        ThreadPool _threadPool;
+
+        std::vector<std::vector<float>> _accumulations; //one per thread, cleared after use
+        std::vector<float> _rawLights;
+        std::vector<double> _bandSums; //luminosity of each band of rows
+        std::vector<std::uint8_t> _pixels;
+};
+
+#endif // CPULIGHTSRENDERER_HPP_INCLUDED
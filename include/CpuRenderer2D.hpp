@@ -0,0 +1,78 @@
+#ifndef CPURENDERER2D_HPP_INCLUDED
+#define CPURENDERER2D_HPP_INCLUDED
+
+#include "Renderer.hpp"
+#include "CpuTexture.hpp"
+#include "ThreadPool.hpp"
+
+#include "glm.hpp"
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+
+/* CPU counterpart of Renderer2D, for rendering without an OpenGL context.
+ *
+ * Same computation as shaders/display2D.frag: the ground refracted through
+ * the normals of the heightmap, the water opacity from the distance
+ * travelled underwater, and the specularity. Both textures are sampled
+ * as the smooth textures of the GPU renderer.
+ *
+ * The rows are rendered by bands on a pool of threads. With SSE2, the
+ * shading is computed for 4 pixels at once, and the 4 channels of each
+ * texture sample are interpolated at once.
+ */
+class CpuRenderer2D: public Renderer
+{
+    public:
+        /* threadsCount=0 for as many threads as the hardware runs. */
+        CpuRenderer2D(float amplitude=0.2f,
+                      float waterLevel=0.5f,
+                      float eta=0.8f,
+                      glm::vec4 const& waterColor=glm::vec4(.1,.1,.8,1),
+                      float viewDistance=2.f,
+                      glm::vec3 const& lightDir=glm::vec3(-1,-1,-4),
+                      unsigned int threadsCount=0);
+
+        /* Disable copy constructor and assignment operator */
+        CpuRenderer2D (CpuRenderer2D const& original) = delete;
+        CpuRenderer2D& operator= (CpuRenderer2D const& original) = delete;
+
+        /* Tiled, as the groundTexture given to Renderer2D.
+         * Its first row is the one at the bottom, as on the GPU. */
+        void setGroundTexture (sf::Image const& image);
+
+        /* Renders the water to pixels (RGBA, bottom row first),
+         * resized to size x height pixels.
+         *
+         * The heightmap (RGBA, bottom row first) must be in the format
+         * of Water::getHeightmap(), as read back by AsyncReadback or
+         * stored by Recorder. */
+        void draw (const std::uint8_t* heightmap,
+                   sf::Vector2u heightmapSize,
+                   sf::Vector2u size,
+                   std::vector<std::uint8_t>& pixels);
+
+    private:
+        /* Renders rows [firstRow, lastRow) of the image. */
+        void drawRows (CpuTexture const& heightmap,
+                       sf::Vector2u size,
+                       unsigned int firstRow,
+                       unsigned int lastRow,
+                       std::uint8_t* pixels) const;
+
+        /* Color of a pixel, in [0,255], as display2D.frag. */
+        glm::vec4 shadePixel (glm::vec4 const& heightColor, glm::vec2 const& coords) const;
+
+    private:
+        static const unsigned int BAND_HEIGHT = 16;
+
+        CpuTexture _groundTexture;
+
+        ThreadPool _threadPool;
+};
+
+#endif // CPURENDERER2D_HPP_INCLUDED
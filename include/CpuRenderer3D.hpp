@@ -0,0 +1,135 @@
+#ifndef CPURENDERER3D_HPP_INCLUDED
+#define CPURENDERER3D_HPP_INCLUDED
+
+#include "Renderer.hpp"
+#include "Camera.hpp"
+#include "CpuTexture.hpp"
+#include "ThreadPool.hpp"
+
+#include "glm.hpp"
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+
+/* CPU counterpart of Renderer3D, for rendering stills without an OpenGL context.
+ *
+ * Instead of rasterizing the surface mesh, each pixel casts a ray:
+ * - entering the tank through a side below the water, it shades the side
+ *   as shaders/display3DCube.frag;
+ * - otherwise it is marched over the heightfield, and the surface is shaded
+ *   as shaders/display3DSurface.frag: refraction onto the lit ground,
+ *   Fresnel mix with the water color, and specularity.
+ *
+ * The marching skips empty space with a pyramid of the minimum and maximum
+ * heights of the heightmap: a cell is only entered if the ray goes below
+ * its maximum, and if the ray ends below its minimum, the intersection is
+ * known to be inside. The heightfield is interpolated bilinearly, as the
+ * smooth heightmap of the GPU renderer.
+ *
+ * The image is rendered by tiles on a pool of threads.
+ */
+class CpuRenderer3D: public Renderer
+{
+    public:
+        /* threadsCount=0 for as many threads as the hardware runs. */
+        CpuRenderer3D(float amplitude=0.2f,
+                      float waterLevel=0.5f,
+                      float eta=0.8f,
+                      glm::vec4 const& waterColor=glm::vec4(.1,.1,.8,1),
+                      float viewDistance=2.f,
+                      glm::vec3 const& lightDir=glm::vec3(-1,-1,-4),
+                      unsigned int threadsCount=0);
+
+        /* Disable copy constructor and assignment operator */
+        CpuRenderer3D (CpuRenderer3D const& original) = delete;
+        CpuRenderer3D& operator= (CpuRenderer3D const& original) = delete;
+
+        /* Tiled, as the groundTexture given to Renderer3D.
+         * Its first row is the one at the bottom, as on the GPU. */
+        void setGroundTexture (sf::Image const& image);
+
+        /* Renders the water to pixels (RGBA, bottom row first), as seen
+         * by the camera, whose aspect ratio should match size.
+         *
+         * The heightmap (RGBA, bottom row first) must be in the format of
+         * Water::getHeightmap(), and the lights (RGBA, bottom row first)
+         * in the format of LightsRenderer::getTexture(), as given
+         * by CpuLightsRenderer::getPixels(). */
+        void draw (const std::uint8_t* heightmap,
+                   sf::Vector2u heightmapSize,
+                   const std::uint8_t* lights,
+                   sf::Vector2u lightsSize,
+                   sf::Vector2u size,
+                   std::vector<std::uint8_t>& pixels);
+
+        Camera& getCamera ();
+
+    private:
+        /* Computes the heights pyramid of _heightmap. */
+        void computePyramid ();
+
+        /* Height of the water, interpolated. */
+        float getHeight (glm::vec2 const& coords) const;
+
+        /* Color of the pixel seen along the ray going from origin to
+         * origin+direction (the near and far clipping planes), in [0,255]. */
+        glm::vec4 castRay (glm::vec3 const& origin,
+                           glm::vec3 const& direction,
+                           glm::vec3 const& eyePos) const;
+
+        /* Looks for the first intersection of the ray with the surface
+         * in [tMin, tMax]. Returns false if there is none. */
+        bool marchSurface (glm::vec3 const& origin,
+                           glm::vec3 const& direction,
+                           float tMin,
+                           float tMax,
+                           float& t) const;
+
+        /* Intersection inside a texel, where the ray goes from above
+         * the surface at tEntry to tExit. certain if the ray is known
+         * to be below the surface at tExit. */
+        bool refineIntersection (glm::vec3 const& origin,
+                                 glm::vec3 const& direction,
+                                 float tEntry,
+                                 float tExit,
+                                 bool certain,
+                                 float& t) const;
+
+        /* As the shaders */
+        glm::vec4 computeGroundColor (glm::vec2 const& pos) const;
+        glm::vec4 computeSurfaceColor (glm::vec3 const& position,
+                                       glm::vec3 const& normalizedNormal,
+                                       glm::vec3 const& normalizedFromEye) const;
+        glm::vec4 computeSpecularity (glm::vec3 const& normalizedNormal,
+                                      glm::vec3 const& normalizedFromEye) const;
+
+    private:
+        struct Bounds
+        {
+            float min;
+            float max;
+        };
+
+        static const unsigned int TILE_SIZE = 32;
+
+        Camera _camera;
+
+        CpuTexture _groundTexture;
+
+        /* Only valid during draw() */
+        CpuTexture _heightmap;
+        CpuTexture _lights;
+
+        /* Level 0: bounds of the interpolated surface over each texel.
+         * Each level then halves the size of the previous one. */
+        std::vector<std::vector<Bounds>> _pyramid;
+        std::vector<sf::Vector2u> _pyramidSizes;
+
+        ThreadPool _threadPool;
+};
+
+#endif // CPURENDERER3D_HPP_INCLUDED
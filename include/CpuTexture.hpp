@@ -0,0 +1,160 @@
+#ifndef CPUTEXTURE_HPP_INCLUDED
+#define CPUTEXTURE_HPP_INCLUDED
+
+#include "glm.hpp"
+
+#include <SFML/System/Vector2.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif // __SSE2__
+
+
+/* RGBA texture sampled on the CPU as a smooth OpenGL texture (GL_LINEAR),
+ * for the CPU renderers.
+ *
+ * The texel (i,j) is centered on ((i+0.5)/width, (j+0.5)/height): row 0 is
+ * the first one given, like the first row uploaded to an OpenGL texture.
+ * Out of [0,1], the coordinates are either wrapped (GL_REPEAT)
+ * or clamped (GL_CLAMP_TO_EDGE).
+ *
+ * The samples are in [0,255]. The sampling functions are inline: they are
+ * called for each pixel. With SSE2, the 4 channels of a texel are
+ * interpolated at once.
+ */
+class CpuTexture
+{
+    public:
+        CpuTexture ();
+
+        /* Copies the pixels (RGBA). */
+        CpuTexture (const std::uint8_t* pixels, sf::Vector2u size, bool repeated);
+
+        sf::Vector2u getSize() const;
+        bool isRepeated() const;
+
+        /* The texture then samples the pixels given, without copying them:
+         * they must outlive it, or the next call. */
+        void reference (const std::uint8_t* pixels, sf::Vector2u size, bool repeated);
+
+        const std::uint8_t* getTexel (unsigned int x, unsigned int y) const;
+
+        glm::vec4 fetch (unsigned int x, unsigned int y) const;
+        glm::vec4 sample (float u, float v) const;
+
+#ifdef __SSE2__
+        __m128 fetch4 (unsigned int x, unsigned int y) const;
+        __m128 sample4 (float u, float v) const;
+#endif // __SSE2__
+
+    private:
+        /* Texels around the coordinates, and the weights of the second ones */
+        void locate (float u, float v,
+                     unsigned int& x0, unsigned int& x1, float& fx,
+                     unsigned int& y0, unsigned int& y1, float& fy) const;
+
+        /* Index of texel i along an axis of n texels */
+        unsigned int address (int i, unsigned int n) const;
+
+    private:
+        std::vector<std::uint8_t> _ownPixels;
+        const std::uint8_t* _pixels;
+        sf::Vector2u _size;
+        bool _repeated;
+};
+
+
+inline const std::uint8_t* CpuTexture::getTexel (unsigned int x, unsigned int y) const
+{
+    return _pixels + 4 * (static_cast<std::size_t>(y) * _size.x + x);
+}
+
+inline unsigned int CpuTexture::address (int i, unsigned int n) const
+{
+    /* i is in [-1, n+1] */
+    if (_repeated)
+        return (i < 0) ? i + n : ((i >= static_cast<int>(n)) ? i - n : i);
+    return (i < 0) ? 0 : std::min(static_cast<unsigned int>(i), n - 1);
+}
+
+inline void CpuTexture::locate (float u, float v,
+                                unsigned int& x0, unsigned int& x1, float& fx,
+                                unsigned int& y0, unsigned int& y1, float& fy) const
+{
+    float x = u * _size.x - 0.5f;
+    float y = v * _size.y - 0.5f;
+
+    /* Brought back to [-1, size] */
+    if (_repeated) {
+        if (x < -1.f || x >= _size.x)
+            x -= _size.x * std::floor(x / _size.x);
+        if (y < -1.f || y >= _size.y)
+            y -= _size.y * std::floor(y / _size.y);
+    } else {
+        x = std::min(std::max(x, -1.f), static_cast<float>(_size.x));
+        y = std::min(std::max(y, -1.f), static_cast<float>(_size.y));
+    }
+
+    /* Truncation is flooring above -1 */
+    int floorX = static_cast<int>(x + 1.f) - 1;
+    int floorY = static_cast<int>(y + 1.f) - 1;
+    fx = x - static_cast<float>(floorX);
+    fy = y - static_cast<float>(floorY);
+
+    x0 = address(floorX, _size.x);
+    x1 = address(floorX + 1, _size.x);
+    y0 = address(floorY, _size.y);
+    y1 = address(floorY + 1, _size.y);
+}
+
+inline glm::vec4 CpuTexture::fetch (unsigned int x, unsigned int y) const
+{
+    const std::uint8_t* texel = getTexel(x, y);
+    return glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+}
+
+inline glm::vec4 CpuTexture::sample (float u, float v) const
+{
+    unsigned int x0, x1, y0, y1;
+    float fx, fy;
+    locate(u, v, x0, x1, fx, y0, y1, fy);
+
+    glm::vec4 bottom = glm::mix(fetch(x0, y0), fetch(x1, y0), fx);
+    glm::vec4 top = glm::mix(fetch(x0, y1), fetch(x1, y1), fx);
+    return glm::mix(bottom, top, fy);
+}
+
+#ifdef __SSE2__
+inline __m128 CpuTexture::fetch4 (unsigned int x, unsigned int y) const
+{
+    std::int32_t rgba;
+    std::memcpy(&rgba, getTexel(x, y), 4);
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bytes = _mm_cvtsi32_si128(rgba);
+    __m128i words = _mm_unpacklo_epi8(bytes, zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+}
+
+inline __m128 CpuTexture::sample4 (float u, float v) const
+{
+    unsigned int x0, x1, y0, y1;
+    float fx, fy;
+    locate(u, v, x0, x1, fx, y0, y1, fy);
+
+    __m128 weightX = _mm_set1_ps(fx);
+    __m128 bottom = fetch4(x0, y0);
+    __m128 top = fetch4(x0, y1);
+    bottom = _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(fetch4(x1, y0), bottom), weightX));
+    top = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(fetch4(x1, y1), top), weightX));
+    return _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), _mm_set1_ps(fy)));
+}
+#endif // __SSE2__
+
+#endif // CPUTEXTURE_HPP_INCLUDED
@@ -0,0 +1,89 @@
+#ifndef CPUWATER_HPP_INCLUDED
+#define CPUWATER_HPP_INCLUDED
+
+#include <SFML/System/Vector2.hpp>
+
+#include <vector>
+
+
+/* CPU counterpart of Water, for offline runs without an OpenGL context.
+ *
+ * Same integration as shaders/update.frag, with the 5-point stencil
+ * and clamped borders. The values are stored as floats, without range
+ * limit nor quantization (as Water::Storage::Float).
+ *
+ * The whole state is held in memory: see OutOfCoreWater for grids
+ * larger than the RAM, which shares the row functions below.
+ */
+class CpuWater
+{
+    public:
+        CpuWater (sf::Vector2u gridSize,
+                  float propagation=20.f,
+                  float friction=0.99f,
+                  float elasticity=0.4f);
+
+        sf::Vector2u getGridSize() const;
+
+        float getPropagation() const;
+        float getFriction() const;
+        float getElasticity() const;
+
+        /* Current state, row by row from the bottom:
+         * for each cell its position, then its velocity (same unit as Decoding.hpp). */
+        const float* getState() const;
+
+        /* Number of calls to update() since construction. */
+        unsigned long getStep () const;
+
+        /* Updates the water surface (Euler integration) */
+        void update (float time);
+
+        /* Initializes the water to be still. */
+        void init ();
+
+        /* Adds a small perturbation, as Water::touch. */
+        void touch (sf::Vector2f pos, float radius=0.1f, float extremum=0.9f);
+
+    public:
+        /* Computes one row of the next state into result, from the current
+         * rows below, at and above it (the same row at the borders).
+         * dt is the integration step, as in shaders/update.frag. */
+        static void updateRow (const float* below,
+                               const float* row,
+                               const float* above,
+                               float* result,
+                               unsigned int width,
+                               float dt,
+                               float propagation,
+                               float friction,
+                               float elasticity);
+
+        /* Adds the perturbation of touch() to row y of a grid. */
+        static void touchRow (float* row,
+                              unsigned int y,
+                              sf::Vector2u gridSize,
+                              sf::Vector2f pos,
+                              float radius,
+                              float extremum);
+
+        /* Range [first, last) of the rows reached by a perturbation. */
+        static void getTouchedRows (sf::Vector2u gridSize,
+                                    sf::Vector2f pos,
+                                    float radius,
+                                    unsigned int& first,
+                                    unsigned int& last);
+
+    private:
+        sf::Vector2u _gridSize;
+
+        float _friction;
+        float _propagation;
+        float _elasticity;
+
+        unsigned int _currentIndex;
+        unsigned long _step;
+        std::vector<float> _buffers[2];
+};
+
+#endif // CPUWATER_HPP_INCLUDED
@@ -0,0 +1,37 @@
+#ifndef DECODING_HPP_INCLUDED
+#define DECODING_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+
+/* CPU counterparts of the storage functions of shaders/utils.glsl.
+ *
+ * A value stored in two 8-bit channels (strong digit first) is
+ * an integer in [0, 65535], mapped linearly to [-RANGE/2, RANGE/2].
+ *
+ * The decoders are vectorized with SSE2 when available.
+ */
+
+/* Must match shaders/utils.glsl */
+const float POS_RANGE = 10.f;
+const float VEL_RANGE = 10.f;
+
+/* Decodes a raw Water state, as returned by Water::getState():
+ * - RG channels: position
+ * - BA channels: velocity
+ * pixels holds cellsCount RGBA pixels, positions and velocities cellsCount floats. */
+void decodeState (const std::uint8_t* pixels,
+                  std::size_t cellsCount,
+                  float* positions,
+                  float* velocities);
+
+/* Decodes a heightmap, as returned by Water::getHeightmap():
+ * - heights receives the relative heights for amplitude 1, in [-0.5, 0.5]
+ * - normals (optional) receives the xyz normals for amplitude 1 */
+void decodeHeightmap (const std::uint8_t* pixels,
+                      std::size_t cellsCount,
+                      float* heights,
+                      float* normals=nullptr);
+
+#endif // DECODING_HPP_INCLUDED
@@ -0,0 +1,114 @@
+#ifndef DISTURBANCES_HPP_INCLUDED
+#define DISTURBANCES_HPP_INCLUDED
+
+#include <GL/glew.h>
+#include <SFML/Graphics/Shader.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <vector>
+
+
+/* Procedural disturbances of the water, evaluated by the update pass
+ * (see shaders/disturbances.glsl) instead of a touch pass each:
+ * - rain: drops falling at random, with a random radius
+ * - point sources: oscillating bumps moving along closed paths
+ * - wave makers: segments oscillating up and down, sending plane waves
+ *
+ * The drops are drawn in the shader from a hash of the step and of the
+ * cell coordinates: the window is divided into rain cells at least as
+ * large as the biggest drop, each one receiving at most MAX_RAIN_DROPS
+ * drops per step, so that a fragment only looks at the 9 rain cells around
+ * it. Beyond that rate, the rain is clamped with a warning. The point sources are moved along their paths on the CPU.
+ * Either way, only a few uniforms are uploaded per update.
+ *
+ * All positions and sizes are normalized in window coordinates.
+ */
+class Disturbances
+{
+    public:
+        struct Rain
+        {
+            float rate; //drops per second over the whole window, 0 for no rain
+            float minRadius;
+            float maxRadius;
+            float extremum; //as in Water::touch, expected in [-1,1]
+        };
+
+        struct PointSource
+        {
+            std::vector<sf::Vector2f> path; //closed
+            float speed; //window sizes per second
+            float radius;
+            float amplitude; //extremum of Water::touch, per second
+            float frequency; //in Hz
+        };
+
+        struct WaveMaker
+        {
+            sf::Vector2f from;
+            sf::Vector2f to;
+            float width; //on each side of the segment
+            float amplitude; //extremum of Water::touch, per second
+            float frequency; //in Hz
+        };
+
+        /* Must match shaders/disturbances.glsl */
+        static const unsigned int MAX_RAIN_DROPS = 4; //per rain cell and per step
+        static const unsigned int MAX_POINT_SOURCES = 4;
+        static const unsigned int MAX_WAVE_MAKERS = 4;
+
+    public:
+        Disturbances ();
+
+        void setRain (Rain const& rain);
+        Rain const& getRain() const;
+
+        /* Throws an exception if there are already MAX_POINT_SOURCES. */
+        void addPointSource (PointSource const& source);
+        std::vector<PointSource> const& getPointSources() const;
+
+        /* Throws an exception if there are already MAX_WAVE_MAKERS. */
+        void addWaveMaker (WaveMaker const& waveMaker);
+        std::vector<WaveMaker> const& getWaveMakers() const;
+
+        /* Removes the rain, the point sources and the wave makers. */
+        void clear ();
+
+        bool isEmpty () const;
+
+        /* Sets the uniforms of shaders/disturbances.glsl, for the update
+         * of duration time at elapsed seconds of simulation.
+         * The shader must be bound. Its uniform locations are kept until
+         * another shader is given. */
+        void setUniforms (sf::Shader const& shader,
+                          unsigned long step,
+                          float elapsed,
+                          float time) const;
+
+        /* Position at distance along a closed path. */
+        static sf::Vector2f getPathPosition (std::vector<sf::Vector2f> const& path, float distance);
+
+    private:
+        struct UniformLocations
+        {
+            GLuint rain;
+            GLuint rainCells;
+            GLuint rainSeed;
+            GLuint pointSourcesCount;
+            GLuint pointSources;
+            GLuint waveMakersCount;
+            GLuint waveMakersSegments;
+            GLuint waveMakers;
+        };
+
+    private:
+        Rain _rain;
+        std::vector<PointSource> _pointSources;
+        std::vector<WaveMaker> _waveMakers;
+
+        mutable GLuint _shaderHandle; //of the cached locations, 0 if none
+        mutable UniformLocations _uniformLocs;
+        mutable bool _rainClamped; //already warned
+};
+
+#endif // DISTURBANCES_HPP_INCLUDED
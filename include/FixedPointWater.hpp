@@ -0,0 +1,118 @@
+#ifndef FIXEDPOINTWATER_HPP_INCLUDED
+#define FIXEDPOINTWATER_HPP_INCLUDED
+
+#include "Water.hpp"
+
+#include <SFML/System/Vector2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+
+/* CPU counterpart of Water with the FixedPoint arithmetic, bit-exact.
+ *
+ * The values are the 16-bit integers of the Base256 storage, minus 32768,
+ * updated with integer operations only, in the same order as the
+ * fixed-point branch of shaders/update.frag:
+ * - two neighbours are averaged rounding up: (a + b + 1) >> 1
+ * - a coefficient is a 15-bit mantissa m and a shift s: x times the
+ *   coefficient is ((x<<s)*m + 2^14) >> 15, or ((x*m + 2^14) >> 15) << s
+ *   if x<<s overflows 16 bits
+ * - the sums and the shifts saturate to 16 bits
+ * so both give the same grids, bit for bit, whatever the hardware.
+ *
+ * With AVX2, 16 cells are updated per instruction.
+ */
+class FixedPointWater
+{
+    public:
+        /* A coefficient: mantissa / 2^15 * 2^shift */
+        struct Coefficient
+        {
+            std::int32_t mantissa; //in [0, 32767]
+            std::int32_t shift; //in [0, 7]
+        };
+
+        /* The coefficients of an update, for a given integration step */
+        struct Coefficients
+        {
+            Coefficient elasticity; //dt * elasticity
+            Coefficient propagation; //dt * propagation
+            Coefficient friction;
+            Coefficient dt;
+        };
+
+    public:
+        FixedPointWater (sf::Vector2u gridSize,
+                         float propagation=20.f,
+                         float friction=0.99f,
+                         float elasticity=0.4f);
+
+        sf::Vector2u getGridSize() const;
+
+        float getPropagation() const;
+        float getFriction() const;
+        float getElasticity() const;
+
+        void setStencil (Water::Stencil stencil);
+        Water::Stencil getStencil() const;
+
+        void setBoundary (Water::Boundary boundary);
+        Water::Boundary getBoundary() const;
+
+        /* Current state in the format of Water::getState() with the Base256
+         * storage (RGBA, bottom row first), for a window that was not scrolled. */
+        void getState (std::vector<std::uint8_t>& pixels) const;
+
+        /* Replaces the current state, in the format of getState(). */
+        void setState (const std::uint8_t* pixels);
+
+        /* Number of calls to update() since construction. */
+        unsigned long getStep () const;
+
+        /* Updates the water surface (Euler integration) */
+        void update (float time);
+
+        /* Initializes the water to be still. */
+        void init ();
+
+        /* Coefficients of an update, as uploaded to shaders/update.frag.
+         * dt is the integration step. */
+        static Coefficients computeCoefficients (float dt,
+                                                 float propagation,
+                                                 float friction,
+                                                 float elasticity);
+
+        static Coefficient toCoefficient (float value);
+
+    private:
+        /* Positions of row y, across the top and bottom borders. */
+        const std::uint16_t* getPositionsRow (int y) const;
+
+        /* Position of cell x of row, across the left and right borders. */
+        std::uint16_t getPosition (const std::uint16_t* row, int x) const;
+
+        /* Computes row y of the next buffer from the current one. */
+        void updateRow (unsigned int y, Coefficients const& coefficients);
+
+    private:
+        /* Encoding of 0 in base 256 (see valueToVec in shaders/utils.glsl) */
+        static const std::uint16_t REST = 32767;
+
+        sf::Vector2u _gridSize;
+
+        float _friction;
+        float _propagation;
+        float _elasticity;
+
+        Water::Stencil _stencil;
+        Water::Boundary _boundary;
+
+        unsigned int _currentIndex;
+        unsigned long _step;
+        std::vector<std::uint16_t> _positions[2];
+        std::vector<std::uint16_t> _velocities[2];
+        std::vector<std::uint16_t> _restRow; //outside of the grid, for the Fixed boundary
+};
+
+#endif // FIXEDPOINTWATER_HPP_INCLUDED
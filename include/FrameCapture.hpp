@@ -0,0 +1,125 @@
+#ifndef FRAMECAPTURE_HPP_INCLUDED
+#define FRAMECAPTURE_HPP_INCLUDED
+
+#include "AsyncReadback.hpp"
+
+#include <SFML/System/Vector2.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* Class for capturing the frames presented by a window to an image sequence.
+ *
+ * Each frame is copied from the back buffer into a ring of pixel buffer
+ * objects and mapped a few frames later (see AsyncReadback), so the render
+ * loop never waits for the GPU. The frames are then encoded and written
+ * by a pool of threads.
+ *
+ * Two formats are available:
+ * - PNG: one file per frame, named path_000000.png, path_000001.png...
+ * - Y4M: a single uncompressed YUV 4:2:0 stream named path.y4m, which
+ *        most video encoders accept as input. The frames are written
+ *        in order whatever the thread that encodes them.
+ *
+ * Frames are dropped, and counted, when the readback ring or the encoding
+ * queue is full. A Y4M stream has a fixed size, so when the window is resized
+ * the frames are dropped until it gets back to its initial size.
+ */
+class FrameCapture
+{
+    public:
+        enum class Format
+        {
+            PNG,
+            Y4M
+        };
+
+    public:
+        /* Throws an exception if the Y4M file can't be created. */
+        FrameCapture (std::string const& path,
+                      Format format,
+                      unsigned int threadsCount=2,
+                      unsigned int framerate=60);
+
+        /* Writes the queued frames.
+         * The copies still in flight on the GPU are discarded. */
+        ~FrameCapture();
+
+        /* Disable copy constructor and assignment operator */
+        FrameCapture (FrameCapture const& original) = delete;
+        FrameCapture& operator= (FrameCapture const& original) = delete;
+
+        /* To be called once per frame, after drawing and before display(),
+         * with the window's context active. size is the size of the window.
+         * Never blocks. */
+        void capture (sf::Vector2u const& size);
+
+        unsigned long getCapturedCount() const;
+        unsigned long getDroppedCount() const;
+
+    private:
+        struct Frame
+        {
+            std::vector<std::uint8_t> pixels; //RGBA, bottom row first
+            sf::Vector2u size;
+            unsigned long index;
+        };
+
+    private:
+        /* Queues a frame read back from the GPU. Never blocks. */
+        void queue (std::vector<std::uint8_t>&& pixels, sf::Vector2u const& size);
+
+        /* Encoding thread */
+        void run();
+
+        void writePNG (Frame const& frame);
+
+        /* Converts to full range BT.601 YUV 4:2:0, top row first. */
+        static void convertToYUV (Frame const& frame, std::vector<std::uint8_t>& yuv);
+
+        /* Writes the frames to the Y4M stream in order.
+         * Must be called with _writeMutex locked. */
+        void writeY4M (unsigned long index, std::vector<std::uint8_t>&& yuv);
+
+    private:
+        static const unsigned int RING_SIZE = 4;
+
+        std::string _path;
+        Format _format;
+        unsigned int _framerate;
+        std::size_t _maxQueuedFrames;
+
+        std::unique_ptr<AsyncReadback> _readback;
+        std::vector<std::uint8_t> _readbackPixels;
+        unsigned long _framesCount; //presented frames, captured or not
+        unsigned long _queuedCount;
+
+        /* Shared with the encoding threads */
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<Frame> _queue;
+        bool _stop;
+        std::atomic<unsigned long> _capturedCount;
+        std::atomic<unsigned long> _droppedCount;
+
+        /* Y4M stream, shared by the encoding threads */
+        std::mutex _writeMutex;
+        std::ofstream _file;
+        sf::Vector2u _streamSize;
+        std::map<unsigned long, std::vector<std::uint8_t>> _pendingWrites;
+        unsigned long _nextWrite;
+
+        std::vector<std::thread> _threads;
+};
+
+#endif // FRAMECAPTURE_HPP_INCLUDED
@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 #include <SFML/OpenGL.hpp>
 #include <SFML/Graphics/Shader.hpp>
+#include <SFML/Graphics/Texture.hpp>
 
 #include "glm.hpp"
 
@@ -23,6 +24,22 @@ GLuint getShaderUniformLoc (GLuint shaderHandle, std::string const& name, bool t
 
 GLuint getShaderAttributeLoc (GLuint shaderHandle, std::string const& name, bool throwExcept=false);
 
+/* Replaces the RGBA8 storage of a texture (typically the one of a sf::RenderTexture)
+ * by a float storage (single channel by default), with room for mipmaps if asked.
+ * The attached framebuffer keeps rendering into it.
+ * The SFML pixel methods (update, copyToImage) must not be used on it anymore. */
+void setFloatStorage (sf::Texture const& texture, GLint internalFormat=GL_R16F, GLenum format=GL_RED, bool mipmaps=true);
+
+/* Regenerates the mipmaps of the texture, on the GPU. */
+void generateMipmaps (sf::Texture const& texture);
+
+/* Index of the 1x1 mipmap level of a texture. */
+unsigned int getTopMipmapLevel (sf::Vector2u const& size);
+
+/* Video memory in use on the device, by every process, in bytes.
+ * Returns false if the driver doesn't report it (GL_NVX_gpu_memory_info only). */
+bool getGpuMemoryUsage (GLuint64& usedBytes);
+
 /* Only computes the 4 sides of a cube. */
 void computeCube (std::vector<glm::vec3>& vertices,
                   std::vector<glm::vec3>& normals);
@@ -0,0 +1,81 @@
+#ifndef HEIGHTMAPPUBLISHER_HPP_INCLUDED
+#define HEIGHTMAPPUBLISHER_HPP_INCLUDED
+
+#include "AsyncReadback.hpp"
+#include "SharedHeightmap.hpp"
+#include "Water.hpp"
+
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/* Class for publishing the heightmap to other processes of the host,
+ * through a POSIX shared memory object (see SharedHeightmap.hpp for the
+ * layout, and HeightmapSubscriber for the reading side).
+ *
+ * The frames are read back from the GPU asynchronously, then copied to
+ * the next slot of the ring. The publisher never waits for the GPU nor
+ * for the subscribers, which may come and go at any time.
+ *
+ * The shared memory object is removed when the publisher is destroyed.
+ */
+class HeightmapPublisher
+{
+    public:
+        /* Throws an exception if the shared memory object can't be created.
+         * An object of the same name left by a previous run is replaced. */
+        HeightmapPublisher (sf::Vector2u size,
+                            std::string const& name=SHARED_HEIGHTMAP_NAME,
+                            unsigned int slotsCount=4,
+                            unsigned int period=1);
+        ~HeightmapPublisher();
+
+        /* Disable copy constructor and assignment operator */
+        HeightmapPublisher (HeightmapPublisher const& original) = delete;
+        HeightmapPublisher& operator= (HeightmapPublisher const& original) = delete;
+
+        std::string const& getName() const;
+
+        /* To be called once per simulation step or once per frame, with an
+         * active OpenGL context. A frame is published once at least period
+         * steps have passed since the last one.
+         * The heightmap must have been generated. Never blocks. */
+        void update (Water const& water);
+
+        /* Same as above for any texture of the publisher size. */
+        void update (sf::Texture const& texture, unsigned long step);
+
+        /* Writes a frame already on the CPU (RGBA, bottom row first)
+         * to the next slot. Ignores the period. */
+        void publish (const std::uint8_t* pixels, unsigned long step);
+
+        unsigned long getPublishedCount() const;
+        unsigned long getDroppedCount() const;
+
+    private:
+        SharedHeightmapSlot* getSlot (unsigned int index);
+
+    private:
+        sf::Vector2u _size;
+        std::string _name;
+        unsigned int _period;
+        bool _hasRequested;
+        unsigned long _lastRequestedStep;
+
+        void* _mapping;
+        std::size_t _mappingSize;
+        SharedHeightmapHeader* _header;
+
+        std::unique_ptr<AsyncReadback> _readback;
+        std::vector<sf::Uint8> _readbackPixels;
+
+        std::uint64_t _frame; //number of the last frame published
+        unsigned long _droppedCount;
+};
+
+#endif // HEIGHTMAPPUBLISHER_HPP_INCLUDED
@@ -0,0 +1,87 @@
+#ifndef HEIGHTMAPSUBSCRIBER_HPP_INCLUDED
+#define HEIGHTMAPSUBSCRIBER_HPP_INCLUDED
+
+#include "SharedHeightmap.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/* Class for reading the heightmap published by HeightmapPublisher
+ * from another process (see SharedHeightmap.hpp for the layout).
+ *
+ * Only depends on the standard library and POSIX: built alone, it is the
+ * reader library (make reader), for any number of local consumers.
+ *
+ * The frames can be read in place, without any copy: acquire the latest
+ * one, use its pixels, then check that it is still valid. The publisher
+ * only rewrites a slot every slotsCount frames, so this fails only for
+ * the consumers slower than that, which can copy the frames instead.
+ *
+ * If the publisher restarts, its new shared memory object is only seen
+ * by new subscribers.
+ */
+class HeightmapSubscriber
+{
+    public:
+        struct Frame
+        {
+            const std::uint8_t* pixels; //in the shared memory, RGBA, bottom row first
+            std::uint64_t frame; //number of the frame, from 1
+            std::uint64_t step;
+            std::uint32_t width;
+            std::uint32_t height;
+            SharedHeightmapFormat format;
+
+            const SharedHeightmapSlot* slot;
+            std::uint64_t sequence;
+        };
+
+    public:
+        /* Throws an exception if the shared memory object doesn't exist
+         * or isn't a heightmap ring of this version. */
+        explicit HeightmapSubscriber (std::string const& name=SHARED_HEIGHTMAP_NAME);
+        ~HeightmapSubscriber();
+
+        /* Disable copy constructor and assignment operator */
+        HeightmapSubscriber (HeightmapSubscriber const& original) = delete;
+        HeightmapSubscriber& operator= (HeightmapSubscriber const& original) = delete;
+
+        /* Number of the last frame published, 0 before the first one.
+         * Cheap enough to be polled. */
+        std::uint64_t getLatestFrame() const;
+
+        /* Never blocks.
+         * Describes the latest frame in frame and returns true, or returns
+         * false if there is none yet, if it is being rewritten, or if its
+         * pixels don't fit in its slot.
+         * The pixels are read in place: check isValid once done with them. */
+        bool acquire (Frame& frame) const;
+
+        /* Whether the slot of the frame wasn't rewritten since it was acquired,
+         * meaning that everything read from its pixels until now is consistent. */
+        bool isValid (Frame const& frame) const;
+
+        /* Copies the latest frame to pixels, retrying if it gets rewritten
+         * in the meantime. Returns false if there is no frame yet, or if
+         * every try failed. frame.pixels points to the shared memory. */
+        bool copy (std::vector<std::uint8_t>& pixels, Frame& frame, unsigned int triesCount=4) const;
+
+    private:
+        const SharedHeightmapSlot* getSlot (unsigned int index) const;
+
+    private:
+        std::string _name;
+
+        const void* _mapping;
+        std::size_t _mappingSize;
+        const SharedHeightmapHeader* _header;
+
+        /* Checked once: only the slots are read from the shared memory afterwards */
+        std::uint32_t _slotsCount;
+        std::uint64_t _slotSize;
+};
+
+#endif // HEIGHTMAPSUBSCRIBER_HPP_INCLUDED
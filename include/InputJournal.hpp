@@ -0,0 +1,84 @@
+#ifndef INPUTJOURNAL_HPP_INCLUDED
+#define INPUTJOURNAL_HPP_INCLUDED
+
+#include <SFML/System/Vector2.hpp>
+
+#include <string>
+#include <vector>
+
+
+/* Journal of every input applied to a simulation, tagged with the
+ * simulation step it was applied at (see Water::getStep()).
+ *
+ * Together with the simulation settings and a fixed timestep, it is
+ * enough to reproduce a session exactly with ReplayDriver.
+ *
+ * It is saved as text, one line per entry. Floats are written in
+ * hexadecimal notation so that they are read back bit-exact.
+ *
+ * The version tells how the inputs were applied, for the replay:
+ * - 1: one pass per touch
+ * - 2: the touches of a step summed in a single pass (see Water::touch)
+ */
+const unsigned int INPUT_JOURNAL_VERSION = 2;
+
+class InputJournal
+{
+    public:
+        struct Settings
+        {
+            sf::Vector2u gridSize;
+            float propagation;
+            float friction;
+            float elasticity;
+            float timestep; //fixed, passed to Water::update()
+        };
+
+        struct Event
+        {
+            enum class Type
+            {
+                Touch, //values: x, y, radius, extremum
+                Init, //no value
+                Camera, //values: distance, latitude, longitude
+                Scroll //values: x, y offset in cells
+            };
+
+            Type type;
+            unsigned long step;
+            float values[4];
+        };
+
+    public:
+        InputJournal();
+
+        void setSettings (Settings const& settings);
+        Settings const& getSettings() const;
+
+        void recordTouch (unsigned long step, sf::Vector2f pos, float radius, float extremum);
+        void recordInit (unsigned long step);
+        void recordCamera (unsigned long step, float distance, float latitude, float longitude);
+        void recordScroll (unsigned long step, sf::Vector2i offset);
+
+        /* INPUT_JOURNAL_VERSION, or the version of the file loaded. */
+        unsigned int getVersion() const;
+
+        /* Number of steps of the recorded session. */
+        void setStepsCount (unsigned long stepsCount);
+        unsigned long getStepsCount() const;
+
+        /* Sorted by step, in recording order for a same step. */
+        std::vector<Event> const& getEvents() const;
+
+        /* Throws an exception if a problem occured. */
+        void save (std::string const& filePath) const;
+        void load (std::string const& filePath);
+
+    private:
+        unsigned int _version;
+        Settings _settings;
+        unsigned long _stepsCount;
+        std::vector<Event> _events;
+};
+
+#endif // INPUTJOURNAL_HPP_INCLUDED
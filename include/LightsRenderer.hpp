@@ -3,6 +3,9 @@
 
 #include "Renderer.hpp"
 
+#include <array>
+#include <vector>
+
 #include <GL/glew.h>
 #include "glm.hpp"
 #include <SFML/OpenGL.hpp>
@@ -15,12 +18,33 @@
 /* Class for computing light rays hitting the ground.
  * They are coming from above the surface and refracted in the water.
  *
- * To do so this class computes the trajectories of "light particles"
- * uniformly spread on the surface to the ground underwater.
+ * Two methods are available:
+ * - Points: computes the trajectories of "light particles" uniformly spread
+ *   on the surface to the ground underwater, and splats them additively.
+ * - AreaRatio: refracts a triangle mesh of the surface (one vertex per texel)
+ *   onto the ground. Each refracted triangle is lit proportionally to the
+ *   ratio between its undistorted area and its refracted area.
+ *
+ * In both modes the rays leaving the box come back from the opposite side,
+ * so that the ground tiles seamlessly.
+ *
+ * The computation can be amortized over several frames: each update only
+ * draws one of the interleaved subsets of particles (or triangles) into a
+ * buffer of its own, and the lights are the sum of these buffers.
  *
+ * The raw lights are accumulated in a single channel float texture, so they
+ * never saturate. The exposure is then derived on the GPU from their average
+ * luminosity, read on the top level of their mipmaps.
  */
 class LightsRenderer: public Renderer
 {
+    public:
+        enum class Mode
+        {
+            Points,
+            AreaRatio
+        };
+
     public:
         LightsRenderer (unsigned int quality,
                         float amplitude=0.3f,
@@ -47,27 +71,93 @@ class LightsRenderer: public Renderer
         /* Returns the final lights texture. */
         sf::Texture const& getTexture() const;
 
+        void setMode (Mode mode);
+        Mode getMode() const;
+
+        /* Number of interleaved subsets the computation is spread over,
+         * rounded to 1, 2 or MAX_SUBSETS. Each update draws only one of them.
+         * 1 disables amortization. */
+        void setAmortization (unsigned int subsets);
+        unsigned int getAmortization() const;
+
+        /* Size of the lights texture, and of the surface mesh (AreaRatio). */
+        void setQuality (unsigned int quality);
+        unsigned int getQuality() const;
+
+        /* Number of particles per texel of the lights texture, along each side (Points). */
+        void setParticlesPerPixel (unsigned int particles);
+        unsigned int getParticlesPerPixel() const;
+
+        /* The lights are only recomputed once every period calls to update(),
+         * for running them at a lower rate than the simulation. */
+        void setUpdatePeriod (unsigned int period);
+        unsigned int getUpdatePeriod() const;
+
+        static const unsigned int MAX_SUBSETS = 4;
+
     private:
-        /* Computes the light hitting the ground.
+        /* Allocates the lights textures. */
+        void createBuffers (unsigned int quality);
+
+        /* Fills the particles and mesh buffers, sorted by subset. */
+        void computeGeometry();
+
+        /* Computes the light hitting the ground into target, for the current subset.
          * The resulting texture still has to be processed.*/
-        void computeRawLights (sf::Texture const& heightmap);
+        void computeRawLights (sf::Texture const& heightmap, sf::RenderTexture& target);
+
+        /* Splats the refracted light particles as points. */
+        void computeRawLightsPoints (sf::Texture const& heightmap);
+
+        /* Draws the refracted surface mesh, lit by area ratio. */
+        void computeRawLightsArea (sf::Texture const& heightmap);
+
+        /* Sets the uniforms shared by both raw lights shaders.
+         * The shader must be bound. */
+        void setRawLightsUniforms (sf::Shader const& shader,
+                                   sf::Texture const& heightmap) const;
 
-        /* Post-processes the raw lights: luminosity range adjustments */
+        /* Sums the raw lights of the subsets into the raw lights. */
+        void accumulateLights();
+
+        /* Post-processes the raw lights: luminosity range adjustments,
+         * relative to the average luminosity. */
         void computeProcessedLights();
 
 
     private:
+        Mode _mode;
+
+        unsigned int _subsets;
+        unsigned int _currentSubset;
+        unsigned int _updatePeriod;
+        unsigned int _updateCounter;
+
         unsigned int _partPerPixel;
         float _intensity;
 
         GLuint _particlesGridBufferID;
         sf::Vector2u _particlesGridSize;
         float _particleSize;
+        std::vector<unsigned int> _particlesSubsetsOffsets;
 
-        sf::RenderTexture _rawLights; //lights only
+        GLuint _meshPosBufferID;
+        GLuint _meshIndexBufferID;
+        sf::Vector2u _meshSize;
+        std::vector<unsigned int> _meshSubsetsOffsets; //in triangles
+
+        sf::RenderTexture _rawLights; //lights only, single channel float
+        std::array<sf::RenderTexture, MAX_SUBSETS> _subsetsLights; //raw lights of each subset when amortized
         sf::RenderTexture _processedLights; //post-processed lights
 
+        /* Exposure: the luminosity is shifted by _exposureShift*average
+         * then stretched by _exposureStretch/average */
+        float _exposureShift;
+        float _exposureStretch;
+
         sf::Shader _computeLightsShader;
+        sf::Shader _computeLightsAreaShader;
+        sf::Shader _accumulateLightsShader;
         sf::Shader _processLightsShader;
 };
 
@@ -0,0 +1,30 @@
+#ifndef MAPPEDFILE_HPP_INCLUDED
+#define MAPPEDFILE_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+
+/* Read-only memory mapping of a whole file (POSIX).
+ * The file pages are loaded lazily by the system when accessed.
+ */
+class MappedFile
+{
+    public:
+        /* Throws an exception if the file can't be opened or mapped. */
+        explicit MappedFile (std::string const& filePath);
+        ~MappedFile();
+
+        /* Disable copy constructor and assignment operator */
+        MappedFile (MappedFile const& original) = delete;
+        MappedFile& operator= (MappedFile const& original) = delete;
+
+        const unsigned char* getData() const;
+        std::size_t getSize() const;
+
+    private:
+        const unsigned char* _data;
+        std::size_t _size;
+};
+
+#endif // MAPPEDFILE_HPP_INCLUDED
@@ -0,0 +1,149 @@
+#ifndef METRICS_HPP_INCLUDED
+#define METRICS_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/* Counter, only increasing. Lock-free, from any thread. */
+class MetricsCounter
+{
+    public:
+        MetricsCounter();
+
+        void increment (std::uint64_t count=1);
+        std::uint64_t getValue() const;
+
+    private:
+        std::atomic<std::uint64_t> _value;
+};
+
+/* Value that goes up and down. Lock-free, from any thread. */
+class MetricsGauge
+{
+    public:
+        MetricsGauge();
+
+        void setValue (double value);
+        double getValue() const;
+
+    private:
+        std::atomic<std::uint64_t> _bits; //of the double
+};
+
+/* Histogram with buckets of bounded relative size, like HDR histograms:
+ * the values below subBucketsCount each have their own bucket, then every
+ * power of two is split into subBucketsCount buckets of equal width.
+ * With 4 sub-buckets, a bucket is at most 25% wider than its lower bound.
+ *
+ * The values are unsigned integers, in a unit given at construction
+ * (1e-6 for microseconds), converted to the base unit when exported.
+ * The values from 2^maxExponent are only counted in an overflow bucket,
+ * which has no upper bound (le="+Inf").
+ *
+ * Recording is lock-free, from any thread: one atomic increment per
+ * bucket, count and sum.
+ */
+class MetricsHistogram
+{
+    public:
+        /* subBucketsCount is rounded up to a power of two. */
+        MetricsHistogram (double unit, unsigned int maxExponent=32, unsigned int subBucketsCount=4);
+
+        /* Disable copy constructor and assignment operator */
+        MetricsHistogram (MetricsHistogram const& original) = delete;
+        MetricsHistogram& operator= (MetricsHistogram const& original) = delete;
+
+        void record (std::uint64_t value);
+
+        double getUnit() const;
+        std::uint64_t getCount() const;
+        std::uint64_t getSum() const;
+
+        /* Without the overflow bucket. */
+        std::size_t getBucketsCount() const;
+        std::uint64_t getBucketCount (std::size_t bucket) const;
+        std::uint64_t getOverflowCount() const;
+
+        /* Largest value of the bucket, in the unit: inclusive, like the
+         * Prometheus le bounds. */
+        std::uint64_t getBucketLimit (std::size_t bucket) const;
+
+        /* Largest value of the bucket holding the quantile q (in [0,1]),
+         * in the unit. 0 if empty, the largest std::uint64_t if the
+         * quantile is in the overflow bucket. */
+        std::uint64_t getQuantile (double q) const;
+
+    private:
+        /* getBucketsCount() for the overflow bucket. */
+        std::size_t getBucket (std::uint64_t value) const;
+
+    private:
+        double _unit;
+        unsigned int _subBucketsShift; //log2 of the sub-buckets count
+        std::vector<std::atomic<std::uint64_t>> _buckets;
+        std::atomic<std::uint64_t> _overflowCount;
+        std::atomic<std::uint64_t> _count;
+        std::atomic<std::uint64_t> _sum;
+};
+
+/* Registry of the metrics of the application, exported in the Prometheus
+ * text format (see MetricsExporter for the endpoint and the snapshots).
+ *
+ * The metrics are registered once, typically at startup, and the
+ * references returned stay valid as long as the registry: the hot paths
+ * update them without any lock. Only the registration and the export
+ * take a lock.
+ *
+ * Names follow the Prometheus conventions: base units (seconds, bytes),
+ * and the _total suffix for counters.
+ */
+class MetricsRegistry
+{
+    public:
+        MetricsRegistry() = default;
+
+        /* Disable copy constructor and assignment operator */
+        MetricsRegistry (MetricsRegistry const& original) = delete;
+        MetricsRegistry& operator= (MetricsRegistry const& original) = delete;
+
+        /* Throws an exception if the name is already registered. */
+        MetricsCounter& addCounter (std::string const& name, std::string const& help);
+        MetricsGauge& addGauge (std::string const& name, std::string const& help);
+        MetricsHistogram& addHistogram (std::string const& name, std::string const& help,
+                                        double unit, unsigned int maxExponent=32, unsigned int subBucketsCount=4);
+
+        /* Every metric, in the Prometheus text exposition format (version 0.0.4). */
+        std::string exportText() const;
+
+        /* Writes exportText() to a temporary file, then renames it:
+         * readers never see a partial snapshot.
+         * Throws an exception if the file can't be written. */
+        void writeSnapshot (std::string const& filePath) const;
+
+    private:
+        struct Metric
+        {
+            Metric (std::string const& name, std::string const& help);
+
+            std::string name;
+            std::string help;
+            std::unique_ptr<MetricsCounter> counter;
+            std::unique_ptr<MetricsGauge> gauge;
+            std::unique_ptr<MetricsHistogram> histogram;
+        };
+
+        /* Registers a metric whose value is already set: the export
+         * may read it as soon as the lock is released. */
+        void addMetric (std::unique_ptr<Metric> metric);
+
+    private:
+        mutable std::mutex _mutex;
+        std::vector<std::unique_ptr<Metric>> _metrics;
+};
+
+#endif // METRICS_HPP_INCLUDED
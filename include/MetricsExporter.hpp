@@ -0,0 +1,82 @@
+#ifndef METRICSEXPORTER_HPP_INCLUDED
+#define METRICSEXPORTER_HPP_INCLUDED
+
+#include "Metrics.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* Class for serving a MetricsRegistry to a Prometheus scraper or to curl,
+ * and for writing it periodically to a file.
+ *
+ * The address is either a port, bound to 127.0.0.1 only, or the path of
+ * a Unix domain socket (curl --unix-socket path http://localhost/metrics).
+ * Any HTTP request is answered with the whole registry, in the text
+ * format: the endpoint is meant for the host, not for the network.
+ *
+ * A background thread serves the requests and writes the snapshots:
+ * the render thread never waits for them. The socket file, if any, is
+ * removed when the exporter is destroyed.
+ */
+class MetricsExporter
+{
+    public:
+        /* No endpoint if the address is empty, no snapshots if the path is.
+         * Throws an exception if the socket can't be created. */
+        MetricsExporter (MetricsRegistry const& registry,
+                         std::string const& address,
+                         std::string const& snapshotPath="",
+                         float snapshotPeriod=10.f);
+        ~MetricsExporter();
+
+        /* Disable copy constructor and assignment operator */
+        MetricsExporter (MetricsExporter const& original) = delete;
+        MetricsExporter& operator= (MetricsExporter const& original) = delete;
+
+        std::string const& getAddress() const;
+
+        /* Number of requests answered since construction. */
+        unsigned long getServedCount() const;
+
+    private:
+        struct Client
+        {
+            int fd;
+            std::string request; //received so far
+        };
+
+        /* Background thread: serves the requests, writes the snapshots. */
+        void run();
+
+        void accept();
+
+        /* Reads what the client sent, and answers once the request is complete.
+         * Returns false once it can be removed. */
+        bool read (Client& client);
+
+        void writeSnapshot();
+
+    private:
+        static const std::size_t MAX_REQUEST_SIZE = 8192;
+
+        MetricsRegistry const& _registry;
+        std::string _address;
+        std::string _socketPath; //empty for a port
+        std::string _snapshotPath;
+        float _snapshotPeriod; //in seconds
+
+        int _socket; //-1 without endpoint
+        int _wakeUpPipe[2]; //written when stopping
+
+        std::atomic<unsigned long> _servedCount;
+
+        /* Only accessed by the background thread */
+        std::vector<Client> _clients;
+
+        std::thread _thread;
+};
+
+#endif // METRICSEXPORTER_HPP_INCLUDED
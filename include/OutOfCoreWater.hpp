@@ -0,0 +1,106 @@
+#ifndef OUTOFCOREWATER_HPP_INCLUDED
+#define OUTOFCOREWATER_HPP_INCLUDED
+
+#include <SFML/System/Vector2.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+/* CPU simulation of grids larger than the RAM, for offline runs.
+ * Same integration as CpuWater, which it matches exactly.
+ *
+ * The state lives in a memory-mapped file (POSIX), with the layout of
+ * CpuWater::getState(), and is updated in place: only the row being
+ * computed and the previous row before its update (the halo) are
+ * kept in memory.
+ *
+ * The rows are processed by bands. While a band is computed, the system
+ * is asked to load the next ones and to start writing the previous one
+ * back, so that the disk works during the computation.
+ *
+ * The sweep direction alternates from one update to the next: the bands
+ * written last, still in the page cache, are the first ones read again.
+ */
+class OutOfCoreWater
+{
+    public:
+        /* The file is created (or overwritten) with the water at rest.
+         * Throws an exception if it can't be created or mapped. */
+        OutOfCoreWater (std::string const& filePath,
+                        sf::Vector2u gridSize,
+                        float propagation=20.f,
+                        float friction=0.99f,
+                        float elasticity=0.4f,
+                        unsigned int bandHeight=64);
+        ~OutOfCoreWater();
+
+        /* Disable copy constructor and assignment operator */
+        OutOfCoreWater (OutOfCoreWater const& original) = delete;
+        OutOfCoreWater& operator= (OutOfCoreWater const& original) = delete;
+
+        sf::Vector2u getGridSize() const;
+        unsigned int getBandHeight() const;
+
+        /* Row y of the current state, same layout as CpuWater::getState().
+         * Reading many rows brings them back from the disk. */
+        const float* getRow (unsigned int y) const;
+
+        /* Number of calls to update() since construction. */
+        unsigned long getStep () const;
+
+        /* Updates the water surface (Euler integration) */
+        void update (float time);
+
+        /* Initializes the water to be still. */
+        void init ();
+
+        /* Adds a small perturbation, as Water::touch. */
+        void touch (sf::Vector2f pos, float radius=0.1f, float extremum=0.9f);
+
+        /* Blocks until the state is written to the file. */
+        void flush ();
+
+    private:
+        void map ();
+        void unmap ();
+
+        /* Range of bytes of the file holding a band, rounded to the pages. */
+        void getBandRange (unsigned int band, std::size_t& offset, std::size_t& length) const;
+
+        /* Asks the system to start loading a band. */
+        void prefetchBand (unsigned int band);
+
+        /* Asks the system to start writing a band back. */
+        void writeBackBand (unsigned int band);
+
+        float* getWritableRow (unsigned int y);
+
+    private:
+        std::string _filePath;
+        sf::Vector2u _gridSize;
+
+        float _friction;
+        float _propagation;
+        float _elasticity;
+
+        unsigned int _bandHeight;
+        unsigned int _bandsCount;
+        bool _upwards; //direction of the next sweep
+
+        unsigned long _step;
+
+        int _fileDescriptor;
+        float* _data;
+        std::size_t _size;
+
+        /* One row each */
+        std::vector<float> _halo;
+        std::vector<float> _result;
+
+        /* Number of bands loaded ahead of the one being computed */
+        static const unsigned int READ_AHEAD_BANDS = 2;
+};
+
+#endif // OUTOFCOREWATER_HPP_INCLUDED
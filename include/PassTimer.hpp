@@ -0,0 +1,68 @@
+#ifndef PASSTIMER_HPP_INCLUDED
+#define PASSTIMER_HPP_INCLUDED
+
+#include <GL/glew.h>
+#include <SFML/OpenGL.hpp>
+
+#include <cstdint>
+#include <vector>
+
+
+/* Class for measuring the GPU time of the passes of a frame,
+ * with timestamp queries (GL_ARB_timer_query).
+ *
+ * A timestamp is written at the beginning of the frame and at the end of
+ * each pass: a pass lasts from the end of the previous one. The results
+ * are read back a few frames later, without waiting for the GPU.
+ * If they are not available in time, the frame is simply not measured.
+ *
+ * The queries belong to the OpenGL context active at construction,
+ * which must be active whenever beginFrame() and endPass() are called.
+ * The passes drawn in other contexts are measured as well, as long as
+ * switching back to this one flushes them (which glXMakeCurrent does).
+ */
+class PassTimer
+{
+    public:
+        PassTimer (unsigned int passesCount, unsigned int latency=3);
+        ~PassTimer();
+
+        /* Disable copy constructor and assignment operator */
+        PassTimer (PassTimer const& original) = delete;
+        PassTimer& operator= (PassTimer const& original) = delete;
+
+        /* Timestamp queries support. Without it, nothing is measured. */
+        static bool isAvailable();
+
+        unsigned int getPassesCount() const;
+
+        void beginFrame ();
+
+        /* Each pass must be ended once per frame, in order. */
+        void endPass (unsigned int pass);
+
+        /* Never blocks.
+         * If the oldest measured frame is available, stores the time of each
+         * of its passes in seconds and returns true. */
+        bool retrieve (std::vector<float>& passTimes);
+
+        /* Same as above, also storing the raw GPU timestamps in nanoseconds:
+         * the beginning of the frame, then the end of each pass. */
+        bool retrieve (std::vector<float>& passTimes, std::vector<std::uint64_t>& timestamps);
+
+        /* Forgets the frames waiting for their results, for instance when the
+         * measures are paused: they would be retrieved long after the fact. */
+        void reset ();
+
+    private:
+        unsigned int _passesCount;
+        unsigned int _latency;
+
+        /* One row of passesCount+1 queries per frame in flight */
+        std::vector<GLuint> _queryIDs;
+        unsigned int _writeSlot;
+        unsigned int _pendingCount;
+        bool _measuring; //false if the current frame is not measured
+};
+
+#endif // PASSTIMER_HPP_INCLUDED
@@ -0,0 +1,118 @@
+#ifndef PROFILER_HPP_INCLUDED
+#define PROFILER_HPP_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+/* Profiler of the CPU side of the frames, exported with the GPU passes
+ * as a Chrome trace (JSON trace events), which Perfetto and
+ * chrome://tracing load.
+ *
+ * The code is instrumented with scoped zones (see the macros below),
+ * which are compiled out unless PROFILING is defined (make PROFILE=1).
+ * While enabled, each zone appends its name and its nanosecond
+ * timestamps to a buffer of its thread: no lock nor allocation, except
+ * when a thread records its first zone or fills a chunk of its buffer.
+ *
+ * The zone names must outlive the trace: string literals, typically.
+ */
+class Profiler
+{
+    public:
+        /* Zones are only recorded while enabled. Enabling starts a new
+         * trace: the zones of the previous one are discarded. */
+        static void setEnabled (bool enabled);
+        static bool isEnabled()
+        {
+            return _enabled.load(std::memory_order_relaxed);
+        }
+
+        /* Name of the calling thread in the trace, "thread N" by default. */
+        static void setThreadName (const char* name);
+
+        /* Nanoseconds, on a steady clock */
+        static std::uint64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /* Never blocks.
+         * Adds a zone to the thread's buffer, or drops it if the buffer is full. */
+        static void record (const char* name, std::uint64_t begin, std::uint64_t end);
+
+        /* Maps the GPU clock onto the profiler's, with a synchronous
+         * timestamp query: to be called with an active OpenGL context,
+         * when a trace starts. Does nothing without timer queries. */
+        static void synchronizeGpuClock ();
+
+        /* Adds a zone measured with GPU timestamps (see PassTimer), on a
+         * track of its own. To be called from a single thread. */
+        static void recordGpu (const char* name, std::uint64_t gpuBegin, std::uint64_t gpuEnd);
+
+        /* Number of zones dropped in the current trace. */
+        static unsigned long getDroppedCount();
+
+        /* Writes the zones of the current trace, of every thread.
+         * Better called once disabled, though the threads may keep on recording.
+         * Throws an exception if the file can't be written. */
+        static void exportTrace (std::string const& filePath);
+
+    private:
+        static std::atomic<bool> _enabled;
+};
+
+/* Zone lasting until the end of its scope. */
+class ProfilerZone
+{
+    public:
+        explicit ProfilerZone (const char* name):
+                    _name (name),
+                    _begin (Profiler::isEnabled() ? Profiler::now() : 0)
+        {
+        }
+
+        ~ProfilerZone()
+        {
+            if (_begin != 0)
+                Profiler::record(_name, _begin, Profiler::now());
+        }
+
+        /* Disable copy constructor and assignment operator */
+        ProfilerZone (ProfilerZone const& original) = delete;
+        ProfilerZone& operator= (ProfilerZone const& original) = delete;
+
+        /* Ends the zone and begins the next one, for consecutive sections. */
+        void next (const char* name)
+        {
+            std::uint64_t time = Profiler::isEnabled() ? Profiler::now() : 0;
+            if (_begin != 0 && time != 0)
+                Profiler::record(_name, _begin, time);
+            _name = name;
+            _begin = time;
+        }
+
+    private:
+        const char* _name;
+        std::uint64_t _begin; //0 if not recorded
+};
+
+/* PROFILE_ZONE(name): zone until the end of the scope.
+ * PROFILE_SECTIONS(name) then PROFILE_NEXT_SECTION(name): consecutive zones,
+ * the last one until the end of the scope. */
+#ifdef PROFILING
+    #define PROFILE_CONCAT_(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+    #define PROFILE_ZONE(name) ProfilerZone PROFILE_CONCAT(profilerZone, __LINE__)(name)
+    #define PROFILE_SECTIONS(name) ProfilerZone profilerSection(name)
+    #define PROFILE_NEXT_SECTION(name) profilerSection.next(name)
+#else
+    #define PROFILE_ZONE(name) do {} while (false)
+    #define PROFILE_SECTIONS(name) do {} while (false)
+    #define PROFILE_NEXT_SECTION(name) do {} while (false)
+#endif // PROFILING
+
+#endif // PROFILER_HPP_INCLUDED
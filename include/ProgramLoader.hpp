@@ -0,0 +1,104 @@
+#ifndef PROGRAMLOADER_HPP_INCLUDED
+#define PROGRAMLOADER_HPP_INCLUDED
+
+#include <GL/glew.h>
+#include <SFML/OpenGL.hpp>
+
+#include <SFML/Graphics/Shader.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/* Class for loading several programs into sf::Shader objects at once,
+ * instead of compiling them one by one with sf::Shader::loadFromMemory.
+ *
+ * The linked programs are stored in an on-disk cache, keyed by a hash of
+ * their sources (defines included) and of the driver strings, and are
+ * restored with glProgramBinary on the next start. A binary rejected by
+ * the driver (after an update, for example) is recompiled and replaced.
+ *
+ * The programs missing from the cache are all compiled and linked before
+ * the first status query, so that with KHR_parallel_shader_compile
+ * the driver compiles them in parallel.
+ *
+ * Without program binaries support (GL_ARB_get_program_binary),
+ * falls back to sf::Shader::loadFromMemory.
+ */
+class ProgramLoader
+{
+    public:
+        /* Directory of the cache, shared by all loaders.
+         * Created if needed. Empty (default) disables the cache. */
+        static void setCacheDirectory (std::string const& directory);
+        static std::string const& getCacheDirectory();
+
+        /* Number of programs restored from the cache, and compiled from
+         * sources, by all loaders since startup. */
+        static unsigned int getCacheHitsCount();
+        static unsigned int getCompiledCount();
+
+    public:
+        ProgramLoader() = default;
+
+        /* Disable copy constructor and assignment operator */
+        ProgramLoader (ProgramLoader const& original) = delete;
+        ProgramLoader& operator= (ProgramLoader const& original) = delete;
+
+        /* Queues a program for the next call to load().
+         * vertex may be empty for a fragment shader only.
+         * errorMessage is the message of the exception thrown if it fails. */
+        void add (sf::Shader& shader,
+                  std::string const& vertex,
+                  std::string const& fragment,
+                  std::string const& errorMessage);
+
+        /* Loads every queued program into its shader, with an active OpenGL context.
+         * Throws an exception if one of them can't be compiled. */
+        void load ();
+
+    private:
+        struct Program
+        {
+            sf::Shader* shader;
+            std::string vertex;
+            std::string fragment;
+            std::string errorMessage;
+            std::uint64_t key;
+
+            /* When compiled by the loader */
+            GLuint vertexID;
+            GLuint fragmentID;
+            GLuint programID;
+        };
+
+    private:
+        /* Returns true if the binary could be restored from the cache. */
+        bool loadFromCache (Program const& program) const;
+
+        /* Compilation without waiting for the result. */
+        void startCompilation (Program& program) const;
+
+        /* Waits for the compilation, then moves the binary to the shader and the cache.
+         * Throws an exception if it failed. */
+        void finishCompilation (Program& program) const;
+
+        /* Deletes the objects created by startCompilation. */
+        static void deleteObjects (Program& program);
+
+        /* Replaces the program of shader by a binary.
+         * Returns false if it is rejected by the driver. */
+        static bool loadBinary (sf::Shader& shader, GLenum format, const void* binary, GLsizei length);
+
+        std::string getCachePath (std::uint64_t key) const;
+
+    private:
+        static std::string _cacheDirectory;
+        static unsigned int _cacheHitsCount;
+        static unsigned int _compiledCount;
+
+        std::vector<Program> _programs;
+};
+
+#endif // PROGRAMLOADER_HPP_INCLUDED
@@ -0,0 +1,79 @@
+#ifndef QUALITYGOVERNOR_HPP_INCLUDED
+#define QUALITYGOVERNOR_HPP_INCLUDED
+
+#include <vector>
+
+
+/* Class for adjusting quality settings at runtime to hold a frame budget,
+ * from the GPU time of each pass of the frames (see PassTimer).
+ *
+ * Each setting is a knob: a ladder of levels, 0 being the cheapest,
+ * charged to one of the passes. Each level is assumed to multiply the
+ * time of its pass by the cost factor of the knob: 4 for a ladder that
+ * doubles a 2D resolution.
+ *
+ * - When the frames stay over budget, the knob with the highest level
+ *   in the most expensive pass is lowered.
+ * - When the frames stay far enough under budget that raising a knob
+ *   would still fit, the knob with the lowest level in the cheapest such
+ *   pass is raised.
+ *
+ * The hysteresis comes from the gap between both thresholds, from the
+ * number of frames each condition must hold, and from the frames ignored
+ * after each change while the timings settle. A knob lowered soon after
+ * being raised waits twice as long before its next raise.
+ */
+class QualityGovernor
+{
+    public:
+        /* targetTime is the GPU budget of a frame, in seconds. */
+        QualityGovernor (float targetTime, unsigned int passesCount);
+
+        void setTargetTime (float targetTime);
+        float getTargetTime() const;
+
+        /* Adds a knob acting on pass, with levelsCount levels, each one
+         * costing about costFactor times the previous one.
+         * Returns its index. */
+        unsigned int addKnob (unsigned int pass, unsigned int levelsCount, unsigned int level, float costFactor=2.f);
+
+        unsigned int getLevel (unsigned int knob) const;
+
+        /* Feeds the GPU time of each pass of a frame, in seconds.
+         * Returns true if a level changed: the knobs must then be applied. */
+        bool update (std::vector<float> const& passTimes);
+
+        /* Smoothed time of each pass, in seconds. */
+        std::vector<float> const& getPassTimes() const;
+
+    private:
+        struct Knob
+        {
+            unsigned int pass;
+            unsigned int levelsCount;
+            unsigned int level;
+            float costFactor; //time of the pass at level+1 over its time at level
+            unsigned int raiseDelay; //frames under budget before a raise
+            unsigned long raisedAt; //frame of the last raise
+        };
+
+    private:
+        /* Returns the index of the knob to change in pass, or -1. */
+        int selectKnob (unsigned int pass, bool raise) const;
+
+        void changeLevel (unsigned int knob, bool raise);
+
+    private:
+        float _targetTime;
+
+        std::vector<float> _passTimes;
+        bool _averaged; //false until the first sample after a change
+        std::vector<Knob> _knobs;
+
+        unsigned long _frame;
+        unsigned int _settleFrames; //frames left to ignore
+        unsigned int _overBudgetFrames;
+        unsigned int _underBudgetFrames;
+};
+
+#endif // QUALITYGOVERNOR_HPP_INCLUDED
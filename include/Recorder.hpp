@@ -0,0 +1,128 @@
+#ifndef RECORDER_HPP_INCLUDED
+#define RECORDER_HPP_INCLUDED
+
+#include "AsyncReadback.hpp"
+#include "Recording.hpp"
+#include "Water.hpp"
+
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+/* Class for recording the water every few simulation steps
+ * to a chunked append-only file (see Recording.hpp for the format).
+ *
+ * The frames are read back from the GPU asynchronously, then encoded
+ * and written by a background thread, so the simulation loop never
+ * waits for the GPU nor for the disk.
+ *
+ * If the background thread falls behind, frames are dropped and counted.
+ * The index is written when the recorder is destroyed.
+ */
+class Recorder
+{
+    public:
+        /* Throws an exception if the file can't be created. */
+        Recorder (std::string const& filePath,
+                  sf::Vector2u size,
+                  RecordingContent content,
+                  unsigned int period=1,
+                  unsigned int keyframePeriod=32);
+
+        /* Writes the pending frames and the index.
+         * The copies still in flight on the GPU are discarded. */
+        ~Recorder();
+
+        /* Disable copy constructor and assignment operator */
+        Recorder (Recorder const& original) = delete;
+        Recorder& operator= (Recorder const& original) = delete;
+
+        /* To be called once per simulation step or once per frame, with an
+         * active OpenGL context. A frame is recorded once at least period
+         * steps have passed since the last one, even if the steps since the
+         * last call went past a multiple of the period.
+         * Records the heightmap or the state, depending on the content.
+         * The heightmap must have been generated. The state can only be
+         * recorded with the Base256 storage. Never blocks. */
+        void update (Water const& water);
+
+        /* Same as above for any texture of the recording size.
+         * origin is the texel at the corner of the window, for a texture
+         * wrapping around like the state once scrolled (see Water::getOrigin):
+         * the frames are rotated back so that it comes first. */
+        void update (sf::Texture const& texture, unsigned long step,
+                     sf::Vector2u origin=sf::Vector2u(0, 0));
+
+        /* Queues a frame already on the CPU (RGBA, bottom row first), with
+         * the texel at the corner of the window as above.
+         * Ignores the recording period. Never blocks. */
+        void record (std::vector<std::uint8_t>&& pixels, unsigned long step,
+                     sf::Vector2u origin=sf::Vector2u(0, 0));
+
+        unsigned long getRecordedCount() const;
+        unsigned long getDroppedCount() const;
+
+    private:
+        /* Background thread: encodes and writes the queued frames. */
+        void run();
+
+        /* Moves the texel at origin to the corner, in place. */
+        void rotate (std::vector<std::uint8_t>& pixels, sf::Vector2u origin);
+
+        void writeFrame (std::vector<std::uint8_t> const& pixels, unsigned long step);
+        void writeIndex ();
+
+    private:
+        struct Frame
+        {
+            std::vector<std::uint8_t> pixels;
+            unsigned long step;
+            sf::Vector2u origin;
+        };
+
+    private:
+        static const std::size_t MAX_QUEUED_FRAMES = 8;
+
+        sf::Vector2u _size;
+        RecordingContent _content;
+        unsigned int _period;
+        unsigned int _keyframePeriod;
+        bool _hasRequested;
+        unsigned long _lastRequestedStep;
+
+        std::unique_ptr<AsyncReadback> _readback;
+        std::vector<std::uint8_t> _readbackPixels;
+        std::deque<std::pair<unsigned long, sf::Vector2u>> _pendingOrigins; //by step, of the copies in flight
+
+        /* Shared with the background thread */
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<Frame> _queue;
+        bool _stop;
+        std::atomic<unsigned long> _recordedCount;
+        std::atomic<unsigned long> _droppedCount;
+
+        /* Only accessed by the background thread */
+        std::ofstream _file;
+        std::uint64_t _offset;
+        std::vector<std::uint8_t> _previousPixels;
+        std::vector<std::uint8_t> _rotatedPixels;
+        std::vector<std::uint8_t> _encoded;
+        std::vector<RecordingIndexEntry> _index;
+
+        std::thread _thread;
+};
+
+#endif // RECORDER_HPP_INCLUDED
@@ -0,0 +1,83 @@
+#ifndef RECORDING_HPP_INCLUDED
+#define RECORDING_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/* File format of the simulation recordings, written by Recorder
+ * and read by RecordingReader. Append-only, in the machine's byte order:
+ *
+ * - RecordingHeader
+ * - for each frame: RecordingFrameHeader followed by the encoded frame
+ * - the index: one RecordingIndexEntry per frame
+ * - RecordingTrailer, giving the position of the index
+ *
+ * A frame is the RGBA pixels of a texture, bottom row first.
+ * It is split into 4 planes (one per channel), delta-encoded against
+ * the previous frame (except for keyframes), then run-length encoded.
+ * Since the strong digits of the state barely change between two
+ * frames, most of the delta planes are runs of zeros.
+ */
+
+enum class RecordingContent : std::uint32_t
+{
+    Heightmap = 0, //Water::getHeightmap()
+    State = 1 //Water::getState()
+};
+
+struct RecordingHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    RecordingContent content;
+    std::uint32_t period; //minimum number of simulation steps between two frames, each has its step
+    std::uint32_t reserved;
+};
+
+struct RecordingFrameHeader
+{
+    std::uint64_t step;
+    std::uint32_t isKeyframe;
+    std::uint32_t encodedSize; //in bytes, following this header
+};
+
+struct RecordingIndexEntry
+{
+    std::uint64_t step;
+    std::uint64_t offset; //of the RecordingFrameHeader, from the file start
+    std::uint32_t isKeyframe;
+    std::uint32_t reserved;
+};
+
+struct RecordingTrailer
+{
+    std::uint64_t indexOffset;
+    std::uint64_t framesCount;
+    char magic[8];
+};
+
+extern const char RECORDING_MAGIC[8];
+extern const char RECORDING_INDEX_MAGIC[8];
+const std::uint32_t RECORDING_VERSION = 1;
+
+/* Encodes pixelsCount RGBA pixels.
+ * previous is the previous frame, or nullptr for a keyframe. */
+void encodeFrame (const std::uint8_t* pixels,
+                  const std::uint8_t* previous,
+                  std::size_t pixelsCount,
+                  std::vector<std::uint8_t>& encoded);
+
+/* Decodes a frame encoded by encodeFrame into pixels (pixelsCount RGBA pixels).
+ * previous is the previous frame, or nullptr for a keyframe.
+ * Returns false if the data is corrupted. */
+bool decodeFrame (const std::uint8_t* encoded,
+                  std::size_t encodedSize,
+                  const std::uint8_t* previous,
+                  std::size_t pixelsCount,
+                  std::uint8_t* pixels);
+
+#endif // RECORDING_HPP_INCLUDED
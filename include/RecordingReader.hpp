@@ -0,0 +1,56 @@
+#ifndef RECORDINGREADER_HPP_INCLUDED
+#define RECORDINGREADER_HPP_INCLUDED
+
+#include "MappedFile.hpp"
+#include "Recording.hpp"
+
+#include <SFML/System/Vector2.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/* Class for reading back a recording written by Recorder.
+ *
+ * The file is memory-mapped, and its index gives random access
+ * to any frame: it is decoded starting from the preceding keyframe.
+ * Reading the frames in order only decodes each of them once.
+ */
+class RecordingReader
+{
+    public:
+        /* Throws an exception if the file is not a complete recording. */
+        explicit RecordingReader (std::string const& filePath);
+
+        sf::Vector2u getSize() const;
+        RecordingContent getContent() const;
+        unsigned int getPeriod() const;
+
+        std::size_t getFramesCount() const;
+
+        /* Simulation step the frame was recorded at. */
+        unsigned long getStep (std::size_t frame) const;
+
+        /* Decodes the frame to pixels (RGBA, bottom row first).
+         * Throws an exception if the frame is corrupted. */
+        void readFrame (std::size_t frame, std::vector<std::uint8_t>& pixels);
+
+    private:
+        /* Decodes one frame on top of _pixels, which must hold the previous one
+         * unless it is a keyframe. */
+        void decode (std::size_t frame);
+
+    private:
+        MappedFile _file;
+        RecordingHeader _header;
+
+        std::vector<RecordingIndexEntry> _index;
+
+        std::vector<std::uint8_t> _pixels; //last decoded frame
+        std::vector<std::uint8_t> _previousPixels;
+        std::size_t _decodedFrame;
+        bool _hasDecodedFrame;
+};
+
+#endif // RECORDINGREADER_HPP_INCLUDED
@@ -48,7 +48,14 @@ class Renderer3D: public Renderer
 
         Camera& getCamera();
 
+        /* Number of vertices of the surface mesh, along each side. */
+        void setQuality (unsigned int quality);
+        unsigned int getQuality() const;
+
     private:
+        /* Fills the surface mesh buffers. */
+        void computeSurfaceGrid ();
+
         void drawSurface (sf::Texture const& heightmap,
                           sf::Texture const& groundTexture,
                           sf::Texture const& lightsTexture) const;
@@ -0,0 +1,47 @@
+#ifndef REPLAYDRIVER_HPP_INCLUDED
+#define REPLAYDRIVER_HPP_INCLUDED
+
+#include "InputJournal.hpp"
+#include "Water.hpp"
+#include "Camera.hpp"
+
+#include <cstddef>
+
+
+/* Replays an InputJournal on a Water (and optionally a Camera),
+ * with the fixed timestep of the journal.
+ *
+ * The water is expected to be built with the journal settings
+ * and to be at step 0. Since the inputs are applied at the same steps
+ * and the integration uses the same timestep, the replay gives the
+ * same results as the recorded session, which makes it a reproducible
+ * workload for benchmarks.
+ *
+ * The touches are applied the way the journal version says: one pass
+ * each for version 1, summed in a pass per step otherwise.
+ */
+class ReplayDriver
+{
+    public:
+        ReplayDriver (InputJournal const& journal,
+                      Water& water,
+                      Camera* camera=nullptr);
+
+        /* Applies the inputs of the current step, then updates the water. */
+        void step();
+
+        /* True once every input of the journal has been applied. */
+        bool isOver() const;
+
+        /* Step of the last input of the journal. */
+        unsigned long getLastStep() const;
+
+    private:
+        InputJournal const& _journal;
+        Water& _water;
+        Camera* _camera;
+
+        std::size_t _nextEvent;
+};
+
+#endif // REPLAYDRIVER_HPP_INCLUDED
@@ -0,0 +1,36 @@
+#ifndef SHADERSOURCES_HPP_INCLUDED
+#define SHADERSOURCES_HPP_INCLUDED
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+
+/* The shaders/ directory is embedded in the executable at build time
+ * by tools/embedShaders.cpp, with the #include directives resolved,
+ * so loading a shader needs no file access. */
+struct EmbeddedShader
+{
+    const char* name; //file name, e.g. "update.frag"
+    const char* source;
+};
+
+extern const EmbeddedShader EMBEDDED_SHADERS[];
+extern const std::size_t EMBEDDED_SHADERS_COUNT;
+
+
+/* #define directives selecting a variant of a shader: name -> value.
+ * The value may be empty. */
+typedef std::map<std::string, std::string> ShaderDefines;
+
+/* Returns the string identifying a set of defines, e.g. "BOUNDARY_FIXED;STENCIL_NINE_POINT".
+ * Two sets have the same key if and only if they define the same variant. */
+std::string getShaderVariantKey (ShaderDefines const& defines);
+
+/* Returns the source of the embedded shader with the defines
+ * inserted right after its #version directive.
+ * Throws an exception if there is no such shader. */
+std::string getShaderSource (std::string const& name,
+                             ShaderDefines const& defines=ShaderDefines());
+
+#endif // SHADERSOURCES_HPP_INCLUDED
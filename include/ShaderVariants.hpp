@@ -0,0 +1,46 @@
+#ifndef SHADERVARIANTS_HPP_INCLUDED
+#define SHADERVARIANTS_HPP_INCLUDED
+
+#include "ShaderSources.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <SFML/Graphics/Shader.hpp>
+
+
+/* Class for the variants of a program, each one compiled from the same
+ * embedded sources with its own set of #define directives.
+ * The choices are made at compile time instead of branching on uniforms.
+ *
+ * A variant is loaded the first time it is requested (see ProgramLoader),
+ * then it is retrieved by its key (see getShaderVariantKey).
+ */
+class ShaderVariants
+{
+    public:
+        /* Names of the embedded shaders.
+         * vertexName may be empty for a fragment shader only. */
+        ShaderVariants (std::string const& vertexName,
+                        std::string const& fragmentName);
+
+        /* Disable copy constructor and assignment operator */
+        ShaderVariants (ShaderVariants const& original) = delete;
+        ShaderVariants& operator= (ShaderVariants const& original) = delete;
+
+        /* Returns the variant for these defines, compiling it if needed.
+         * Throws an exception if the compilation fails. */
+        sf::Shader& get (ShaderDefines const& defines);
+
+        /* Number of variants compiled so far. */
+        unsigned int getCompiledCount() const;
+
+    private:
+        std::string _vertexName;
+        std::string _fragmentName;
+
+        std::map<std::string, std::unique_ptr<sf::Shader>> _variants;
+};
+
+#endif // SHADERVARIANTS_HPP_INCLUDED
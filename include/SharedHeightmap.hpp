@@ -0,0 +1,66 @@
+#ifndef SHAREDHEIGHTMAP_HPP_INCLUDED
+#define SHAREDHEIGHTMAP_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+/* Layout of the shared memory object in which HeightmapPublisher
+ * publishes the heightmap, read by HeightmapSubscriber. In the machine's
+ * byte order, for processes of the same host:
+ *
+ * - SharedHeightmapHeader, padded to SHARED_HEIGHTMAP_SLOTS_OFFSET bytes
+ * - slotsCount slots of slotSize bytes: SharedHeightmapSlot then the pixels
+ *
+ * The slots form a ring, each guarded by a seqlock: the publisher makes
+ * the sequence odd, writes the pixels and the metadata, then makes it
+ * even again. A reader checks that the sequence is even and unchanged
+ * after reading: otherwise the slot was being rewritten. The publisher
+ * never waits for the readers, and since it only comes back to a slot
+ * every slotsCount frames, the readers can use the pixels in place.
+ *
+ * This header only depends on the standard library, for the readers.
+ */
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the sequences must be lock-free to be shared");
+
+enum class SharedHeightmapFormat : std::uint32_t
+{
+    RGBA8 = 0 //Water::getHeightmap(): RGB normal, A height, bottom row first
+};
+
+struct SharedHeightmapHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t slotsCount;
+    std::uint64_t slotSize; //in bytes, header of the slot included
+    std::atomic<std::uint64_t> latest; //number of the last frame published, 0 before the first one
+};
+
+struct SharedHeightmapSlot
+{
+    std::atomic<std::uint64_t> sequence; //odd while being written
+    std::uint64_t frame; //number of the frame, from 1: in slot (frame-1) % slotsCount
+    std::uint64_t step; //simulation step
+    std::uint32_t width;
+    std::uint32_t height;
+    SharedHeightmapFormat format;
+    std::uint32_t reserved;
+};
+
+extern const char SHARED_HEIGHTMAP_MAGIC[8];
+const std::uint32_t SHARED_HEIGHTMAP_VERSION = 1;
+
+/* Slots on their own cache lines: the writer doesn't disturb the readers of other slots */
+const std::uint64_t SHARED_HEIGHTMAP_SLOTS_OFFSET = 64;
+static_assert(sizeof(SharedHeightmapHeader) <= SHARED_HEIGHTMAP_SLOTS_OFFSET, "header too large");
+
+/* Default name of the shared memory object */
+extern const char SHARED_HEIGHTMAP_NAME[];
+
+/* Size of a slot holding width x height pixels, rounded up to cache lines */
+std::uint64_t getSharedHeightmapSlotSize (std::uint32_t width, std::uint32_t height);
+
+#endif // SHAREDHEIGHTMAP_HPP_INCLUDED
@@ -0,0 +1,93 @@
+#ifndef SPSCQUEUE_HPP_INCLUDED
+#define SPSCQUEUE_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+/* Bounded lock-free queue between one producer thread and one consumer
+ * thread, for handing over inputs without ever blocking either of them.
+ *
+ * The elements live in a ring whose capacity is a power of two. Each side
+ * owns one index and only reads the other one: a push or a pop of a whole
+ * batch costs a single atomic store, which is what keeps high rates cheap.
+ * Both indices are on cache lines of their own, so the two threads don't
+ * invalidate each other's line on every element.
+ */
+template <typename T>
+class SpscQueue
+{
+    public:
+        /* The capacity is rounded up to a power of two. */
+        explicit SpscQueue (std::size_t capacity):
+                    _ring (roundCapacity(capacity)),
+                    _mask (_ring.size() - 1),
+                    _head (0),
+                    _tail (0)
+        {
+        }
+
+        /* Disable copy constructor and assignment operator */
+        SpscQueue (SpscQueue const& original) = delete;
+        SpscQueue& operator= (SpscQueue const& original) = delete;
+
+        std::size_t getCapacity() const
+        {
+            return _ring.size();
+        }
+
+        /* Producer only. Never blocks.
+         * Appends as many of the count elements as fit, and returns their number. */
+        std::size_t push (const T* elements, std::size_t count)
+        {
+            std::size_t tail = _tail.load(std::memory_order_relaxed);
+            std::size_t head = _head.load(std::memory_order_acquire);
+            count = std::min(count, _ring.size() - (tail - head));
+
+            for (std::size_t i = 0 ; i < count ; ++i)
+                _ring[(tail + i) & _mask] = elements[i];
+
+            _tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        /* Consumer only. Never blocks.
+         * Appends every element available to elements, and returns their number. */
+        std::size_t pop (std::vector<T>& elements)
+        {
+            std::size_t head = _head.load(std::memory_order_relaxed);
+            std::size_t tail = _tail.load(std::memory_order_acquire);
+
+            for (std::size_t i = head ; i != tail ; ++i)
+                elements.push_back(_ring[i & _mask]);
+
+            _head.store(tail, std::memory_order_release);
+            return tail - head;
+        }
+
+    private:
+        static std::size_t roundCapacity (std::size_t capacity)
+        {
+            std::size_t rounded = 1;
+            while (rounded < capacity)
+                rounded *= 2;
+            return rounded;
+        }
+
+    private:
+        static const std::size_t CACHE_LINE = 64;
+
+        std::vector<T> _ring;
+        std::size_t _mask;
+
+        /* Padded rather than aligned: C++11 allocations don't honour over-alignment */
+        char _headPadding[CACHE_LINE];
+        std::atomic<std::size_t> _head; //next element to pop, written by the consumer
+        char _tailPadding[CACHE_LINE];
+        std::atomic<std::size_t> _tail; //next element to push, written by the producer
+        char _endPadding[CACHE_LINE];
+};
+
+#endif // SPSCQUEUE_HPP_INCLUDED
@@ -0,0 +1,65 @@
+#ifndef THREADPOOL_HPP_INCLUDED
+#define THREADPOOL_HPP_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/* Class for running the tasks of a frame on several threads.
+ *
+ * The threads are created once and wait between two runs, so that
+ * a run costs no more than waking them up. The calling thread takes
+ * part in the run: the pool has threadsCount-1 threads of its own.
+ *
+ * The tasks are handed out one at a time, in order, to the first
+ * thread available: many small tasks balance the load better than
+ * one per thread.
+ */
+class ThreadPool
+{
+    public:
+        /* threadsCount=0 for as many threads as the hardware runs. */
+        explicit ThreadPool (unsigned int threadsCount=0);
+        ~ThreadPool();
+
+        /* Disable copy constructor and assignment operator */
+        ThreadPool (ThreadPool const& original) = delete;
+        ThreadPool& operator= (ThreadPool const& original) = delete;
+
+        /* Including the calling thread. */
+        unsigned int getThreadsCount() const;
+
+        /* Calls task(index, thread) for each index in [0, tasksCount),
+         * thread being in [0, getThreadsCount()): two tasks running at the
+         * same time never share it, so it can select per-thread buffers.
+         * Blocks until all the tasks are done. The tasks must not throw.
+         * Not reentrant: only one thread may call run() at a time. */
+        void run (unsigned int tasksCount, std::function<void(unsigned int, unsigned int)> const& task);
+
+    private:
+        /* Runs tasks until there are none left */
+        void work (unsigned int thread);
+
+        /* Pool thread */
+        void wait (unsigned int thread);
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _startCondition;
+        std::condition_variable _doneCondition;
+        bool _stop;
+        unsigned long _generation; //incremented by each run
+        unsigned int _busyThreads;
+
+        const std::function<void(unsigned int, unsigned int)>* _task;
+        unsigned int _tasksCount;
+        std::atomic<unsigned int> _nextTask;
+
+        std::vector<std::thread> _threads;
+};
+
+#endif // THREADPOOL_HPP_INCLUDED
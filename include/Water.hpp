@@ -1,12 +1,22 @@
 #ifndef WATER_HPP_INCLUDED
 #define WATER_HPP_INCLUDED
 
+#include "AsyncReadback.hpp"
+#include "Disturbances.hpp"
+#include "ShaderVariants.hpp"
+
 #include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <SFML/Graphics/RenderTexture.hpp>
 #include <SFML/Graphics/RenderTarget.hpp>
 #include <SFML/Graphics/Shader.hpp>
+#include <SFML/Graphics/Rect.hpp>
 #include <SFML/System/Vector2.hpp>
+#include <SFML/System/Vector3.hpp>
 #include <SFML/System/Time.hpp>
 
 
@@ -28,36 +38,220 @@
  *
  * This class can export the surface with the generate/getHeightmap methods.
  * Internally it uses another format for more precision.
+ *
+ * The storage format, the stencil and the boundary mode are compile-time
+ * variants of the shaders: changing them selects another program
+ * instead of branching in the shaders.
+ *
+ * The grid is a window over an unbounded surface, which can be scrolled
+ * to follow a point of interest (see scroll()). Positions given to the
+ * methods are relative to the window.
  */
 class Water
 {
+    public:
+        /* State of the water at a probe position */
+        struct Probe
+        {
+            float position; //same unit as Decoding.hpp
+            float velocity; //same unit as Decoding.hpp
+            sf::Vector3f normal; //for an amplitude of 1
+        };
+
+        /* Perturbation, see touch() */
+        struct Touch
+        {
+            sf::Vector2f pos;
+            float radius;
+            float extremum;
+        };
+
+        /* Same as in shaders/touch.frag */
+        static const unsigned int MAX_TOUCHES_PER_PASS = 64;
+
+        /* Format of the state textures, chosen at construction:
+         * - Base256: RGBA8, each value on two channels in base 256
+         * - Float: RGBA32F, each value on one channel, 4 times larger
+         *          but without range limit nor quantization */
+        enum class Storage
+        {
+            Base256,
+            Float
+        };
+
+        /* Neighbours used for the propagation:
+         * - FivePoint: the 4 sides
+         * - NinePoint: the 4 sides and the 4 corners, more isotropic */
+        enum class Stencil
+        {
+            FivePoint,
+            NinePoint
+        };
+
+        /* Behaviour at the borders of the grid (see shaders/boundary.glsl):
+         * - Clamp: the waves are reflected
+         * - Periodic: the grid wraps around
+         * - Fixed: the water outside is at rest */
+        enum class Boundary
+        {
+            Clamp,
+            Periodic,
+            Fixed
+        };
+
+        /* Arithmetic of the update:
+         * - Float: the values are decoded, updated and encoded as floats
+         * - FixedPoint: the 16-bit values of the Base256 storage are updated
+         *   with integer operations, bit-exact with FixedPointWater whatever
+         *   the driver. The other passes are unchanged. */
+        enum class Arithmetic
+        {
+            Float,
+            FixedPoint
+        };
+
     public:
         Water (sf::Vector2u gridSize,
                float propagation=20.f,
                float friction=0.99f,
-               float elasticity=0.4);
+               float elasticity=0.4,
+               Storage storage=Storage::Base256);
         ~Water();
 
+        /* Changes the resolution of the grid. The current state is resampled
+         * (bilinearly), the window keeps its place on the surface. */
+        void setGridSize (sf::Vector2u size);
         sf::Vector2u getGridSize() const;
 
+        Storage getStorage() const;
+
+        void setStencil (Stencil stencil);
+        Stencil getStencil() const;
+
+        void setBoundary (Boundary boundary);
+        Boundary getBoundary() const;
+
+        /* The FixedPoint arithmetic requires the Base256 storage:
+         * throws an exception otherwise. */
+        void setArithmetic (Arithmetic arithmetic);
+        Arithmetic getArithmetic() const;
+
+        void setPropagation (float propagation);
+        float getPropagation() const;
+        void setFriction (float friction);
+        float getFriction() const;
+        void setElasticity (float elasticity);
+        float getElasticity() const;
+
+        /* Rain, point sources and wave makers, applied by every update
+         * (see Disturbances). The elapsed time they follow is the step
+         * times the timestep, which is expected to be fixed.
+         * Ignored with the FixedPoint arithmetic, which stays exact. */
+        void setDisturbances (Disturbances const& disturbances);
+        Disturbances const& getDisturbances() const;
+
+        /* External forcing, blended into the state by every update:
+         * the R channel of forcing holds positions and the G channel
+         * velocities (same unit as Decoding.hpp), over the whole window,
+         * at any resolution (typically AsyncUpload::getTexture()).
+         * Each value moves towards the forcing by its weight, in [0,1]:
+         * 0 ignores the channel, 1 imposes it. The texture must outlive
+         * the forcing; nullptr removes it.
+         * Ignored with the FixedPoint arithmetic, which stays exact. */
+        void setForcing (sf::Texture const* forcing, float positionWeight=1.f, float velocityWeight=0.f);
+        sf::Texture const* getForcing() const;
+
         /* Exports the water surface in a texture:
          * - RGB channels store the normal
          * - A channel stores the height */
         void generateHeightmap();
         sf::Texture const& getHeightmap () const;
 
+        /* Returns the current internal state:
+         * - RG channels store the position
+         * - BA channels store the velocity
+         * each one in base 256 (see shaders/utils.glsl and Decoding.hpp).
+         * With the Float storage, R stores the position and B the velocity.
+         * Once scrolled, the window starts at getOrigin() modulo the grid size. */
+        sf::Texture const& getState () const;
+
+        /* Number of calls to update() since construction. */
+        unsigned long getStep () const;
+
         /* Updates the water surface (Euler integration) */
         void update (float time);
 
         /* Initializes the water to be still. */
         void init ();
 
+        /* Moves the window by offset cells, at constant cost: the content
+         * stays in the textures and only the newly exposed strips are
+         * written, with water at rest (see shaders/scrolling.glsl). */
+        void scroll (sf::Vector2i offset);
+
+        /* Scrolls so that the window is centered on point, as close as whole
+         * cells allow. point is in window sizes, from the initial window corner. */
+        void centerOn (sf::Vector2f point);
+
+        /* Cell of the surface at the corner of the window (0 initially). */
+        sf::Vector2i getOrigin () const;
+
         /* Adds a small perturbation.
          * - pos is the center of the perturbation, normalized in grid coordinates
          * - radius is the maximum effect radius, normalized in grid coordinates
          * - extremum is expected to be in [-1,1] */
         void touch (sf::Vector2f pos, float radius=0.1f, float extremum=0.9f);
 
+        /* Same as above for many perturbations at once, in a pass per
+         * MAX_TOUCHES_PER_PASS of them. They are summed before being added
+         * to the water, so the result only depends on the batch, not on
+         * the order: it may differ slightly from one touch() per perturbation. */
+        void touch (std::vector<Touch> const& touches);
+
+        /* Saves the whole simulation (both buffers, current index, step,
+         * parameters, storage format and origin) to a versioned binary file.
+         * Blocking: the buffers are read back synchronously.
+         * Throws an exception if a problem occured. */
+        void saveCheckpoint (std::string const& filePath) const;
+
+        /* Restores a simulation saved with saveCheckpoint.
+         * The grid is resized if needed. The file is memory-mapped
+         * and the buffers are uploaded directly from the mapping.
+         * The storage formats must match.
+         * Throws an exception if a problem occured. */
+        void loadCheckpoint (std::string const& filePath);
+
+        /* Samples the current state at each point (normalized in grid coordinates),
+         * in a single draw. The results are read back asynchronously:
+         * they are available with retrieveProbes() about one frame later.
+         * Returns false if the request was dropped because too many are pending,
+         * or because more points than ever before are asked while requests are
+         * pending: their buffer can't grow until they are all retrieved. */
+        bool probe (std::vector<sf::Vector2f> const& points);
+
+        /* Never blocks.
+         * If the results of the oldest probe request are available,
+         * stores them in the same order as the points, the step they were
+         * sampled at in step, and returns true. */
+        bool retrieveProbes (std::vector<Probe>& results, unsigned long& step);
+
+
+    private:
+        /* Allocates both state buffers, in the storage format. */
+        void createBuffers (sf::Vector2u size);
+        void createBuffer (unsigned int index, sf::Vector2u size);
+
+        /* Selects the shaders variants matching the current options. */
+        void selectVariants ();
+
+        ShaderDefines getStorageDefines () const;
+
+        /* Origin of the window in the textures, normalized (see shaders/scrolling.glsl). */
+        sf::Vector2f getTextureOrigin () const;
+
+        /* Resets cells of the surface to rest in the current buffer.
+         * The rectangles are in cells of the surface, within the window. */
+        void resetCells (std::vector<sf::IntRect> const& cells);
 
     private:
         float _friction;
@@ -65,14 +259,39 @@ class Water
         float _elasticity;
 
         unsigned int _currentIndex;
+        unsigned long _step;
         std::array<sf::RenderTexture, 2> _buffers;
+        sf::Vector2i _origin;
+
+        Storage _storage;
+        Stencil _stencil;
+        Boundary _boundary;
+        Arithmetic _arithmetic;
+
+        Disturbances _disturbances;
+
+        sf::Texture const* _forcing;
+        sf::Vector2f _forcingWeights;
 
         sf::Shader _initShader;
-        sf::Shader _updateShader;
         sf::Shader _touchShader;
+        ShaderVariants _updateShaders;
+        sf::Shader* _updateShader; //current variant
 
         sf::RenderTexture _heightmap;
-        sf::Shader _generateHeightmapShader;
+        ShaderVariants _generateHeightmapShaders;
+        sf::Shader* _generateHeightmapShader; //current variant
+
+        /* Probes: one texel each, rows of PROBES_TEXTURE_WIDTH */
+        static const unsigned int PROBES_TEXTURE_WIDTH = 64;
+        sf::RenderTexture _probesTexture;
+        GLuint _probesBufferID;
+        sf::Shader _probeShader;
+
+        sf::Shader _resampleShader;
+        std::unique_ptr<AsyncReadback> _probesReadback;
+        std::deque<std::size_t> _pendingProbesCounts;
+        std::vector<float> _probesPixels;
 };
 
 #endif // WATER_HPP_INCLUDED
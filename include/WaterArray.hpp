@@ -0,0 +1,111 @@
+#ifndef WATERARRAY_HPP_INCLUDED
+#define WATERARRAY_HPP_INCLUDED
+
+#include <GL/glew.h>
+#include <SFML/OpenGL.hpp>
+
+#include <SFML/Graphics/Shader.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <array>
+#include <vector>
+
+
+/* Class for simulating many independent water surfaces at once,
+ * typically a parameter sweep over small grids.
+ *
+ * Each surface is a layer of a 2D texture array, with the same encoding
+ * as the Water state (see Water::getState()) and its own parameters.
+ * Each layer is drawn as a quad whose vertices carry its parameters,
+ * all stored in a single vertex buffer.
+ *
+ * When the driver can select the layer from the vertex shader
+ * (GL_ARB_shader_viewport_layer_array or GL_AMD_vertex_shader_layer),
+ * all the layers are updated in a single draw. Otherwise there is
+ * one draw per layer, still without any state change in between.
+ *
+ * The framebuffers belong to the OpenGL context active at construction,
+ * which must be active whenever the surfaces are initialized or updated.
+ */
+class WaterArray
+{
+    public:
+        struct Parameters
+        {
+            float propagation;
+            float friction;
+            float elasticity;
+        };
+
+    public:
+        /* One layer per element of parameters. */
+        WaterArray (sf::Vector2u gridSize,
+                    std::vector<Parameters> const& parameters);
+        ~WaterArray();
+
+        /* Disable copy constructor and assignment operator */
+        WaterArray (WaterArray const& original) = delete;
+        WaterArray& operator= (WaterArray const& original) = delete;
+
+        sf::Vector2u getGridSize() const;
+        unsigned int getLayersCount() const;
+
+        void setParameters (unsigned int layer, Parameters const& parameters);
+        Parameters const& getParameters (unsigned int layer) const;
+
+        /* True if all the layers are updated in a single draw. */
+        bool isLayered() const;
+
+        /* OpenGL name of the GL_TEXTURE_2D_ARRAY storing the current states. */
+        GLuint getStateTexture() const;
+
+        /* Number of calls to update() since construction. */
+        unsigned long getStep () const;
+
+        /* Updates every layer (same integration as Water::update). */
+        void update (float time);
+
+        /* Initializes every layer to be still. */
+        void init ();
+
+        /* Adds a small perturbation to a layer, as Water::touch.
+         * It is applied by the next update, which applies up to
+         * MAX_TOUCHES of them, the others are kept for the following ones. */
+        void touch (unsigned int layer, sf::Vector2f pos, float radius=0.1f, float extremum=0.9f);
+
+    public:
+        static const unsigned int MAX_TOUCHES = 8; //same as shaders/waterArrayUpdate.frag
+
+    private:
+        /* Fills the vertex buffer with the quads and parameters of the layers. */
+        void uploadLayers ();
+
+        /* Draws every layer of the target buffer with shader,
+         * which must be bound with its uniforms set. */
+        void drawLayers (sf::Shader const& shader, unsigned int targetIndex);
+
+    private:
+        struct Touch
+        {
+            float layer;
+            float values[4]; //x, y, radius, extremum
+        };
+
+    private:
+        sf::Vector2u _gridSize;
+        std::vector<Parameters> _parameters;
+        bool _layered;
+
+        unsigned int _currentIndex;
+        unsigned long _step;
+        std::array<GLuint, 2> _textureIDs;
+        std::array<GLuint, 2> _framebufferIDs;
+
+        GLuint _layersBufferID;
+        std::vector<Touch> _pendingTouches;
+
+        sf::Shader _initShader;
+        sf::Shader _updateShader;
+};
+
+#endif // WATERARRAY_HPP_INCLUDED
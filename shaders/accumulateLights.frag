@@ -0,0 +1,26 @@
+#version 130
+
+
+/* Raw lights of each subset, the last one drawn included */
+uniform sampler2D subset0;
+uniform sampler2D subset1;
+uniform sampler2D subset2;
+uniform sampler2D subset3;
+uniform float subsetsCount=1.0; //2 or 4
+uniform vec2 textureSize;
+
+out vec4 fragColor;
+
+
+/* Sum of the raw lights of the subsets: each one weighs exactly 1,
+ * however long ago it was drawn.
+*/
+void main()
+{
+    vec2 coords = gl_FragCoord.xy / textureSize;
+    
+    vec4 sum = texture(subset0, coords) + texture(subset1, coords);
+    if (subsetsCount > 2.5)
+        sum += texture(subset2, coords) + texture(subset3, coords);
+    fragColor = sum;
+}
@@ -0,0 +1,34 @@
+/* Reading the grid across its borders. The behaviour is chosen
+   at compile time:
+    - BOUNDARY_PERIODIC: the grid wraps around, waves leaving on
+      one side come back on the opposite side
+    - BOUNDARY_FIXED: the water outside of the grid is at rest,
+      waves are reflected upside down
+    - otherwise, the cells outside of the grid copy the closest border
+      cell, waves are reflected
+
+   The borders are those of the window (see scrolling.glsl), not those
+   of the texture.
+*/
+
+#include "utils.glsl"
+#include "scrolling.glsl"
+
+
+/* Position of the cell at coords, normalized in window coordinates */
+float fetchPosition (sampler2D grid, vec2 coords)
+{
+#if defined(BOUNDARY_PERIODIC)
+    coords = fract(coords);
+#else
+#if defined(BOUNDARY_FIXED)
+    if (any(lessThan(coords, vec2(0.0))) || any(greaterThan(coords, vec2(1.0))))
+        return 0.0;
+#endif
+    /* The texture is repeated: the filtering must not reach
+       the other side of the window */
+    vec2 halfCell = 0.5 / vec2(textureSize(grid, 0));
+    coords = clamp(coords, halfCell, 1.0 - halfCell);
+#endif
+    return vecToValue(texture(grid, windowToTexture(coords)).rg, POS_RANGE);
+}
@@ -14,7 +14,7 @@ uniform vec3 normalizedLightDir = normalize(vec3(-1,-1,-5));
 attribute vec2 pos;
 
 
-__UTILS__
+#include "utils.glsl"
 
 
 /* Extracts relative height from the pixel color on the heightmap.
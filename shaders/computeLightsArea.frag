@@ -0,0 +1,29 @@
+#version 130
+
+
+uniform float intensity=0.2;
+uniform float maxRatio=20.0; //bounds the intensity where triangles degenerate
+
+in vec2 undistortedPos;
+in vec2 refractedPos;
+
+out vec4 fragColor;
+
+
+/* Area covered by the fragment, computed from screen-space derivatives */
+float computeArea (const vec2 pos)
+{
+    return abs(dFdx(pos).x * dFdy(pos).y - dFdx(pos).y * dFdy(pos).x);
+}
+
+/* The light flux through a triangle is conserved by refraction,
+ * so its intensity is inversely proportional to its refracted area.
+ */
+void main()
+{
+    float undistortedArea = computeArea(undistortedPos);
+    float refractedArea = computeArea(refractedPos);
+    
+    float ratio = min(undistortedArea / max(refractedArea, 1e-12), maxRatio);
+    fragColor = vec4(intensity * ratio);
+}
@@ -17,7 +17,7 @@ in vec2 coordsOnHeightmap;
 out vec4 fragColor;
 
 
-__UTILS__
+#include "utils.glsl"
 
 
 /* Extracts relative height from the pixel color on the heightmap.
@@ -0,0 +1,100 @@
+/* Procedural disturbances, evaluated in the update pass (see Disturbances.hpp).
+
+   The rain is drawn from a hash of the step and of the coordinates of the
+   rain cells: each one holds at most MAX_RAIN_DROPS drops per step, no
+   larger than it, so only the 9 rain cells around a fragment can reach it.
+
+   The heights are the ones of touch.frag, for an extremum given per drop,
+   per point source and per wave maker.
+*/
+
+#include "utils.glsl"
+
+
+const int MAX_RAIN_DROPS = 4;
+const int MAX_POINT_SOURCES = 4;
+const int MAX_WAVE_MAKERS = 4;
+
+uniform vec4 rain; //expected drops per rain cell, min radius, max radius, extremum
+uniform vec2 rainCells; //number of rain cells along each side
+uniform float rainSeed; //changes every step
+
+uniform int pointSourcesCount;
+uniform vec4 pointSources[MAX_POINT_SOURCES]; //x, y, radius, extremum
+
+uniform int waveMakersCount;
+uniform vec4 waveMakersSegments[MAX_WAVE_MAKERS]; //from, to
+uniform vec2 waveMakers[MAX_WAVE_MAKERS]; //width, extremum
+
+
+/* Integer hash with a good avalanche (lowbias32) */
+uint hash (uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/* Uniform in [0,1), the state moving on at each call */
+float random (inout uint state)
+{
+    state = hash(state);
+    return float(state >> 8) / 16777216.0;
+}
+
+/* Same cosine bump as touch.frag: 1 at 0, 0 from 1 */
+float disturbanceBump (float param)
+{
+    return 0.5 * (cos(param*3.141592654) + 1.0) * step(param, 1.0);
+}
+
+float computeRain (vec2 coords)
+{
+    ivec2 cell = ivec2(floor(coords * rainCells));
+    uint seed = hash(uint(rainSeed));
+
+    float extremum = 0.0;
+    for (int dY = -1 ; dY <= 1 ; ++dY) {
+        for (int dX = -1 ; dX <= 1 ; ++dX) {
+            ivec2 neighbour = cell + ivec2(dX, dY);
+            if (any(lessThan(neighbour, ivec2(0))) || any(greaterThanEqual(vec2(neighbour), rainCells)))
+                continue;
+
+            /* floor(rain.x) drops, plus one more with the probability of its fraction */
+            uint state = hash(seed ^ hash(uint(neighbour.x) ^ hash(uint(neighbour.y))));
+            for (int i = 0 ; i < MAX_RAIN_DROPS ; ++i) {
+                if (random(state) >= rain.x - float(i))
+                    break;
+
+                vec2 center = (vec2(neighbour) + vec2(random(state), random(state))) / rainCells;
+                float radius = mix(rain.y, rain.z, random(state));
+                extremum += rain.w * disturbanceBump(length(coords - center) / radius);
+            }
+        }
+    }
+    return extremum;
+}
+
+/* Height added at coords, normalized in window coordinates */
+float computeDisturbances (vec2 coords)
+{
+    float extremum = computeRain(coords);
+
+    for (int i = 0 ; i < pointSourcesCount ; ++i) {
+        float param = length(coords - pointSources[i].xy) / pointSources[i].z;
+        extremum += pointSources[i].w * disturbanceBump(param);
+    }
+
+    for (int i = 0 ; i < waveMakersCount ; ++i) {
+        vec2 from = waveMakersSegments[i].xy;
+        vec2 segment = waveMakersSegments[i].zw - from;
+        float t = clamp(dot(coords - from, segment) / max(dot(segment, segment), 1e-8), 0.0, 1.0);
+        float param = length(coords - (from + t * segment)) / waveMakers[i].x;
+        extremum += waveMakers[i].y * disturbanceBump(param);
+    }
+
+    return 0.5 * POS_RANGE * extremum;
+}
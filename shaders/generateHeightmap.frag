@@ -7,7 +7,7 @@ uniform vec2 cellSize;
 out vec4 fragColor;
 
 
-__UTILS__
+#include "boundary.glsl"
 
 
 /* Returns height relative to the '0' level for an amplitude of 1.
@@ -15,7 +15,7 @@ __UTILS__
  */
 float computeRelativeHeight (const vec2 coords)
 {
-    return vecToValue(texture(grid, coords).rg, POS_RANGE) / POS_RANGE;
+    return fetchPosition(grid, coords) / POS_RANGE;
 }
 
 /* Returns normalized normal for an amplitude of 1,
@@ -4,7 +4,7 @@
 out vec4 fragColor;
 
 
-__UTILS__
+#include "utils.glsl"
 
 
 /* Initializes the cell to be still */
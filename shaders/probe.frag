@@ -0,0 +1,45 @@
+#version 130
+
+
+uniform sampler2D grid;
+uniform vec2 cellSize;
+
+in vec2 coordsOnGrid;
+out vec4 fragColor;
+
+
+#include "sampling.glsl"
+
+
+/* Returns height relative to the '0' level for an amplitude of 1. */
+float computeRelativeHeight (const vec2 coords)
+{
+    return sampleState(grid, coords).x / POS_RANGE;
+}
+
+/* Returns normalized normal for an amplitude of 1,
+ * computed as the cross product of the partial derivatives.
+ */
+vec3 computeNormal (const vec2 coords)
+{
+    vec3 partialX = vec3(2*cellSize.x, 0, 0);
+    partialX.z = computeRelativeHeight(coords + vec2(cellSize.x,0)) -
+                 computeRelativeHeight(coords - vec2(cellSize.x,0));
+    
+    vec3 partialY = vec3(0, 2*cellSize.y, 0);
+    partialY.z = computeRelativeHeight(coords + vec2(0, cellSize.y)) -
+                 computeRelativeHeight(coords - vec2(0, cellSize.y));
+    
+    return normalize(cross(partialX, partialY));
+}
+
+/* Stores position, velocity and the xy components of the normal
+ * (z is positive, so it can be retrieved from them).
+ */
+void main()
+{
+    vec2 state = sampleState(grid, coordsOnGrid);
+    vec3 normal = computeNormal(coordsOnGrid);
+    
+    fragColor = vec4(state, normal.xy);
+}
@@ -0,0 +1,20 @@
+#version 130
+
+
+uniform vec2 probesTextureSize;
+
+// probe position, normalized in grid coordinates
+attribute vec2 coords;
+
+out vec2 coordsOnGrid;
+
+
+/* Each probe is written to its own texel, in the order of the buffer */
+void main()
+{
+    int width = int(probesTextureSize.x);
+    vec2 texel = vec2(gl_VertexID % width, gl_VertexID / width) + 0.5;
+    
+    coordsOnGrid = coords;
+    gl_Position = vec4(2 * texel / probesTextureSize - 1, 0, 1);
+}
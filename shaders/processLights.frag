@@ -1,24 +1,34 @@
 #version 130
 
 
-uniform sampler2D rawLightsTexture;
+uniform sampler2D rawLightsTexture; //single channel, with mipmaps
 uniform vec2 textureSize;
 
-uniform float shift=0;
-uniform float stretch=1;
+uniform float averageLevel=0; //mipmap level of size 1x1
+
+/* Crop and stretch, relative to the average luminosity */
+uniform float shiftFactor=1.5;
+uniform float stretchFactor=0.4;
 
 out vec4 fragColor;
 
 
 /* Post-processes the rawLightsTexture and then adds it the ground texture.
  * The post-processing crops then stretches the lights range to adjust contrast.
+ * Since the light is conserved by refraction, the average luminosity only
+ * depends on the computation method, which makes it a good exposure reference.
+ * The highest values are rolled off instead of being clipped.
 */
 void main()
 {
     vec2 coords = gl_FragCoord.xy / textureSize;
     
-    vec4 lightsColor = texture(rawLightsTexture, coords);
-    lightsColor = max(vec4(0), (lightsColor - shift)) * stretch;
+    float average = max(textureLod(rawLightsTexture, vec2(0.5), averageLevel).r, 0.0001);
+    float shift = shiftFactor * average;
+    float stretch = stretchFactor / average;
+    
+    float lights = texture(rawLightsTexture, coords).r;
+    lights = max(0.0, lights - shift) * stretch;
     
-    fragColor = lightsColor;
+    fragColor = vec4(1.0 - exp(-lights));
 }
@@ -0,0 +1,28 @@
+#version 130
+
+
+/* Previous state, seen from origin (see scrolling.glsl) */
+uniform sampler2D oldGrid;
+
+/* Cell size and origin of the new state */
+uniform vec2 cellSize;
+uniform vec2 newOrigin;
+
+out vec4 fragColor;
+
+
+#include "sampling.glsl"
+
+
+/* Resamples the state to another grid size, keeping the window
+ * at the same place on the surface.
+ * Each fragment is supposed to be a cell of the new grid.
+ */
+void main()
+{
+    vec2 coordsOnGrid = fract(gl_FragCoord.xy * cellSize - newOrigin);
+    vec2 state = sampleState(oldGrid, coordsOnGrid);
+    
+    fragColor = vec4(valueToVec(state.x, POS_RANGE),
+                     valueToVec(state.y, VEL_RANGE));
+}
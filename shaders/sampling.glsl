@@ -0,0 +1,36 @@
+/* Reading the state at any point of the window, for probes and
+   resampling. The cells outside of the window copy the closest
+   border cell.
+*/
+
+#include "utils.glsl"
+#include "scrolling.glsl"
+
+
+/* Position and velocity of a cell, in window cells */
+vec2 fetchCell (sampler2D grid, const ivec2 cell)
+{
+    ivec2 gridSize = textureSize(grid, 0);
+    ivec2 originCell = ivec2(round(origin * vec2(gridSize)));
+    ivec2 texel = (clamp(cell, ivec2(0), gridSize - 1) + originCell) % gridSize;
+    vec4 cellColor = texelFetch(grid, texel, 0);
+    
+    return vec2(vecToValue(cellColor.rg, POS_RANGE),
+                vecToValue(cellColor.ba, VEL_RANGE));
+}
+
+/* Bilinear interpolation of position and velocity, coords in window coordinates.
+ * It has to be done after decoding: interpolating the
+ * base 256 digits themselves would be meaningless.
+ */
+vec2 sampleState (sampler2D grid, const vec2 coords)
+{
+    vec2 texelCoords = coords * vec2(textureSize(grid, 0)) - 0.5;
+    ivec2 cell = ivec2(floor(texelCoords));
+    vec2 weights = texelCoords - floor(texelCoords);
+    
+    vec2 bottom = mix(fetchCell(grid, cell), fetchCell(grid, cell + ivec2(1,0)), weights.x);
+    vec2 top = mix(fetchCell(grid, cell + ivec2(0,1)), fetchCell(grid, cell + ivec2(1,1)), weights.x);
+    
+    return mix(bottom, top, weights.y);
+}
@@ -0,0 +1,23 @@
+/* Toroidal addressing of the state textures (see Water::scroll).
+
+   The grid is a window moving over an unbounded surface. When it moves,
+   its content stays in place: the texel storing its lower left corner
+   (origin) moves instead, and the textures wrap around (repeated).
+
+   Window coordinates are normalized from the corner of the window,
+   texture coordinates are the usual normalized texture coordinates.
+*/
+
+
+uniform vec2 origin = vec2(0.0);
+
+
+vec2 windowToTexture (vec2 coords)
+{
+    return coords + origin;
+}
+
+vec2 textureToWindow (vec2 coords)
+{
+    return fract(coords - origin);
+}
@@ -4,17 +4,18 @@
 uniform sampler2D oldGrid;
 uniform vec2 cellSize;
 
-// both coords and radius are in normalized grid coordinates
-uniform vec2 coords;
-uniform float radius;
+const int MAX_TOUCHES = 64;
 
-// expected in [-1, 1]
-uniform float extremum;
+// x, y, radius, extremum: coords and radius are in normalized grid
+// coordinates, the extremum is expected to be in [-1, 1]
+uniform int touchesCount;
+uniform vec4 touches[MAX_TOUCHES];
 
 out vec4 fragColor;
 
 
-__UTILS__
+#include "utils.glsl"
+#include "scrolling.glsl"
 
 
 /* Expects a parameter in [0,1].
@@ -28,19 +29,23 @@ float bumpFunction (float param)
     return value * step(param, 1);
 }
 
-/* Pushes the water around coords following a 2D cos curve.
+/* Pushes the water around each touch following a 2D cos curve.
  * Each fragment is supposed to be a grid cell.
  */
 void main()
 {
     /* Normalized coords */
-    vec2 coordsOnGrid = gl_FragCoord.xy * cellSize;
-    vec4 cellColor = texture(oldGrid, coordsOnGrid);
+    vec2 coordsOnTexture = gl_FragCoord.xy * cellSize;
+    vec2 coordsOnGrid = textureToWindow(coordsOnTexture);
+    vec4 cellColor = texture(oldGrid, coordsOnTexture);
     
     /* First compute the displacement */
-    float distance = length(coords - coordsOnGrid);
-    float param = distance / radius;
-    float dHeight = 0.5 * POS_RANGE * extremum * bumpFunction(param);
+    float dHeight = 0.0;
+    for (int i = 0 ; i < touchesCount ; ++i) {
+        float distance = length(touches[i].xy - coordsOnGrid);
+        float param = distance / touches[i].z;
+        dHeight += 0.5 * POS_RANGE * touches[i].w * bumpFunction(param);
+    }
     
     /* Then add it to the current height */
     float height = vecToValue(cellColor.rg, POS_RANGE);
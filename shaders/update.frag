@@ -13,17 +13,131 @@ uniform float f = 0.995; //friction
 out vec4 fragColor;
 
 
-__UTILS__
+#include "boundary.glsl"
 
 
+#if defined(ARITHMETIC_FIXED_POINT)
+
+/* Integer formulation on the values of the Base256 storage, minus 32768,
+   bit-exact with FixedPointWater (see its header for the operations).
+   Each coefficient is (mantissa, shift), replacing c, k, f and dt. */
+uniform vec2 fixedC;
+uniform vec2 fixedK;
+uniform vec2 fixedF;
+uniform vec2 fixedDt;
+
+const uint REST = 32767u; //valueToVec(0.0)
+
+/* Position and velocity of a texel, as integers in [0, 65535] */
+uvec2 fetchFixedCell (ivec2 texel)
+{
+    uvec4 digits = uvec4(round(255.0 * texelFetch(oldGrid, texel, 0)));
+    return 256u * digits.xz + digits.yw;
+}
+
+/* Position of a cell of the window, across its borders as fetchPosition */
+uint fetchFixedPosition (ivec2 cell, ivec2 size, ivec2 textureOrigin)
+{
+#if defined(BOUNDARY_PERIODIC)
+    cell = (cell + size) % size;
+#else
+#if defined(BOUNDARY_FIXED)
+    if (any(lessThan(cell, ivec2(0))) || any(greaterThanEqual(cell, size)))
+        return REST;
+#endif
+    cell = clamp(cell, ivec2(0), size - 1);
+#endif
+    return fetchFixedCell((cell + textureOrigin) % size).x;
+}
+
+uint average (uint a, uint b)
+{
+    return (a + b + 1u) >> 1;
+}
+
+int saturate (int x)
+{
+    return clamp(x, -32768, 32767);
+}
+
+/* Product rounded to the nearest */
+int multiply (int x, int mantissa)
+{
+    return (x * mantissa + 16384) >> 15;
+}
+
+/* Exact if x can be shifted first, otherwise shifted after the product */
+int scale (int x, vec2 coefficient)
+{
+    int mantissa = int(coefficient.x);
+    int factor = 1 << int(coefficient.y);
+    int shifted = x * factor;
+    if (shifted == saturate(shifted))
+        return multiply(shifted, mantissa);
+    return saturate(multiply(x, mantissa) * factor);
+}
+
+void main()
+{
+    ivec2 size = textureSize(oldGrid, 0);
+    ivec2 textureOrigin = ivec2(round(origin * vec2(size)));
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 cell = (texel - textureOrigin + size) % size;
+
+    /* Fetch current state */
+    uvec2 state = fetchFixedCell(texel);
+    int pos = int(state.x) - 32768;
+    int vel = int(state.y) - 32768;
+
+    uint sidesPos = average(average(fetchFixedPosition(cell + ivec2(1, 0), size, textureOrigin),
+                                    fetchFixedPosition(cell - ivec2(1, 0), size, textureOrigin)),
+                            average(fetchFixedPosition(cell + ivec2(0, 1), size, textureOrigin),
+                                    fetchFixedPosition(cell - ivec2(0, 1), size, textureOrigin)));
+    int neighboursPos = int(sidesPos) - 32768;
+#if defined(STENCIL_NINE_POINT)
+    /* (4*sides + corners + pos) / 6, with the sides and the corners averaged */
+    uint cornersPos = average(average(fetchFixedPosition(cell + ivec2(1, 1), size, textureOrigin),
+                                      fetchFixedPosition(cell - ivec2(1, 1), size, textureOrigin)),
+                              average(fetchFixedPosition(cell + ivec2(1, -1), size, textureOrigin),
+                                      fetchFixedPosition(cell - ivec2(1, -1), size, textureOrigin)));
+    neighboursPos = saturate(multiply(neighboursPos, 21845) + multiply(int(cornersPos) - 32768, 5461));
+    neighboursPos = saturate(neighboursPos + multiply(pos, 5461));
+#endif
+
+    /* Update velocity */
+    vel = saturate(vel - scale(pos, fixedK)); //vertical spring
+    vel = saturate(vel + scale(saturate(neighboursPos - pos), fixedC)); //surface tension
+    vel = scale(vel, fixedF); //attenuation
+
+    /* Update position */
+    pos = saturate(pos + scale(vel, fixedDt));
+
+    /* Written exactly: the RGBA8 channels receive the digits */
+    uvec2 values = uvec2(ivec2(pos, vel) + 32768);
+    fragColor = vec4(values.x >> 8, values.x & 255u, values.y >> 8, values.y & 255u) / 255.0;
+}
+
+#else
+
+#if defined(DISTURBANCES)
+#include "disturbances.glsl"
+#endif
+
+#if defined(FORCING)
+/* External forcing over the window: position, velocity (see Water::setForcing) */
+uniform sampler2D forcing;
+uniform vec2 forcingWeights;
+#endif
+
 /* Updates the fragment position and velocity.
  * Each fragment is supposed to be a grid cell.
  */
 void main()
 {
     /* Normalized coords */
-    vec2 coordsOnGrid = gl_FragCoord.xy * cellSize;
-    vec4 cellColor = texture(oldGrid, coordsOnGrid);
+    vec2 coordsOnTexture = gl_FragCoord.xy * cellSize;
+    vec2 coordsOnGrid = textureToWindow(coordsOnTexture);
+    vec4 cellColor = texture(oldGrid, coordsOnTexture);
     
     /* Fetch current state */
     float pos = vecToValue(cellColor.rg, POS_RANGE);
@@ -32,11 +146,20 @@ void main()
     /* Update velocity */
     vel += -dt * k * pos; //vertical spring
     
-    float neighboursPos = vecToValue(texture(oldGrid, coordsOnGrid + vec2(cellSize.x, 0)).rg, POS_RANGE) +
-                          vecToValue(texture(oldGrid, coordsOnGrid - vec2(cellSize.x, 0)).rg, POS_RANGE) +
-                          vecToValue(texture(oldGrid, coordsOnGrid + vec2(0,cellSize.y)).rg, POS_RANGE) +
-                          vecToValue(texture(oldGrid, coordsOnGrid - vec2(0,cellSize.y)).rg, POS_RANGE);
-    neighboursPos *= 0.25;
+    float sidesPos = fetchPosition(oldGrid, coordsOnGrid + vec2(cellSize.x, 0)) +
+                     fetchPosition(oldGrid, coordsOnGrid - vec2(cellSize.x, 0)) +
+                     fetchPosition(oldGrid, coordsOnGrid + vec2(0,cellSize.y)) +
+                     fetchPosition(oldGrid, coordsOnGrid - vec2(0,cellSize.y));
+#if defined(STENCIL_NINE_POINT)
+    /* Isotropic laplacian, scaled to give the same wave speed as the 5-point one */
+    float cornersPos = fetchPosition(oldGrid, coordsOnGrid + cellSize) +
+                       fetchPosition(oldGrid, coordsOnGrid - cellSize) +
+                       fetchPosition(oldGrid, coordsOnGrid + vec2(cellSize.x, -cellSize.y)) +
+                       fetchPosition(oldGrid, coordsOnGrid - vec2(cellSize.x, -cellSize.y));
+    float neighboursPos = pos + (4.0*sidesPos + cornersPos - 20.0*pos) / 24.0;
+#else
+    float neighboursPos = 0.25 * sidesPos;
+#endif
     
     vel += dt * c * (neighboursPos - pos); //surface tension
     vel *= f; //attenuation
@@ -44,7 +167,19 @@ void main()
     /* Update position */
     pos += dt * vel;
     
+#if defined(FORCING)
+    vec2 forced = texture(forcing, coordsOnGrid).rg;
+    pos = mix(pos, forced.x, forcingWeights.x);
+    vel = mix(vel, forced.y, forcingWeights.y);
+#endif
+    
+#if defined(DISTURBANCES)
+    /* Spreads from the next step */
+    pos += computeDisturbances(coordsOnGrid);
+#endif
     
     fragColor = vec4(valueToVec(pos, POS_RANGE),
                      valueToVec(vel, VEL_RANGE));
 }
+
+#endif
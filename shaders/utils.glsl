@@ -11,6 +11,9 @@
 
     To store a float value, we scale it to fit in [0, 65535],
     then project it on the base 256.
+
+    With STORAGE_FLOAT defined, the textures have float channels instead
+    and the values are stored as they are.
 */
 
 
@@ -18,6 +21,25 @@ const float POS_RANGE = 10.0;
 const float VEL_RANGE = 10.0;
 
 
+#if defined(STORAGE_FLOAT)
+
+/* Float storage: the value is stored as is in the first channel,
+   the second one is unused. */
+
+/* Gives value in [-RANGE,RANGE] */
+float vecToValue (const vec2 vec, const float RANGE)
+{
+    return vec.x;
+}
+
+/* Expects value in [-RANGE,RANGE] */
+vec2 valueToVec (float value, const float RANGE)
+{
+    return vec2(value, 0.0);
+}
+
+#else
+
 /* Converts value stored in two color channels
    to float value in [0, 65535] */
 float fromBase256 (const vec2 digits)
@@ -54,3 +76,4 @@ vec2 valueToVec (float value, const float RANGE)
     return toBase256(value);
 }
 
+#endif
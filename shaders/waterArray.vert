@@ -0,0 +1,29 @@
+#version 130
+
+#if defined(LAYER_ARB)
+#extension GL_ARB_shader_viewport_layer_array : require
+#elif defined(LAYER_AMD)
+#extension GL_AMD_vertex_shader_layer : require
+#endif
+
+
+// corner of the fullscreen quad of a layer, in [-1,1]x[-1,1]
+attribute vec2 corner;
+
+// propagation, elasticity, friction, layer index
+attribute vec4 parameters;
+
+flat out vec4 layerParameters;
+
+
+/* Each layer is drawn as its own quad, carrying its parameters.
+ * If the driver allows it, the quad is routed to its layer here,
+ * so that all the layers are drawn at once. */
+void main()
+{
+    layerParameters = parameters;
+#if defined(LAYER_ARB) || defined(LAYER_AMD)
+    gl_Layer = int(parameters.w);
+#endif
+    gl_Position = vec4(corner, 0, 1);
+}
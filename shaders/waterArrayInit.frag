@@ -0,0 +1,15 @@
+#version 130
+
+
+out vec4 fragColor;
+
+
+#include "utils.glsl"
+
+
+/* Initializes the cell to be still */
+void main()
+{
+    fragColor = vec4(valueToVec(0.0, POS_RANGE),
+                     valueToVec(0.0, VEL_RANGE));
+}
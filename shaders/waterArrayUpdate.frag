@@ -0,0 +1,81 @@
+#version 130
+
+
+uniform sampler2DArray oldGrids;
+uniform vec2 cellSize;
+
+uniform float dt;
+
+// touches to apply before the update: x, y, radius, extremum
+// (see touch.frag), and the layer they apply to
+const int MAX_TOUCHES = 8;
+uniform int touchesCount;
+uniform vec4 touches[MAX_TOUCHES];
+uniform float touchesLayers[MAX_TOUCHES];
+
+// propagation, elasticity, friction, layer index
+flat in vec4 layerParameters;
+
+out vec4 fragColor;
+
+
+#include "utils.glsl"
+
+
+/* Sum of the touches on this layer at coords, see touch.frag.
+ * They are applied to the neighbours as well, so that a touch has the
+ * same effect as with a separate pass. */
+float computeTouches (const vec2 coords)
+{
+    float dHeight = 0.0;
+    for (int i = 0 ; i < touchesCount ; ++i) {
+        if (touchesLayers[i] == layerParameters.w) {
+            float param = length(touches[i].xy - coords) / touches[i].z;
+            float bump = 0.5 * (cos(param*3.141592654) + 1.0) * step(param, 1.0);
+            dHeight += 0.5 * POS_RANGE * touches[i].w * bump;
+        }
+    }
+    return dHeight;
+}
+
+/* Position of a cell, touches included */
+float fetchPosition (const vec2 coords)
+{
+    return vecToValue(texture(oldGrids, vec3(coords, layerParameters.w)).rg, POS_RANGE) +
+           computeTouches(coords);
+}
+
+/* Same as update.frag, with the parameters of the layer. */
+void main()
+{
+    float c = layerParameters.x;
+    float k = layerParameters.y;
+    float f = layerParameters.z;
+
+    /* Normalized coords */
+    vec2 coordsOnGrid = gl_FragCoord.xy * cellSize;
+    vec4 cellColor = texture(oldGrids, vec3(coordsOnGrid, layerParameters.w));
+    
+    /* Fetch current state, touches included */
+    float pos = fetchPosition(coordsOnGrid);
+    float vel = vecToValue(cellColor.ba, VEL_RANGE);
+    
+    /* Update velocity */
+    vel += -dt * k * pos; //vertical spring
+    
+    float neighboursPos = fetchPosition(coordsOnGrid + vec2(cellSize.x, 0)) +
+                          fetchPosition(coordsOnGrid - vec2(cellSize.x, 0)) +
+                          fetchPosition(coordsOnGrid + vec2(0,cellSize.y)) +
+                          fetchPosition(coordsOnGrid - vec2(0,cellSize.y));
+    neighboursPos *= 0.25;
+    
+    vel += dt * c * (neighboursPos - pos); //surface tension
+    vel *= f; //attenuation
+    
+    /* Update position */
+    pos += dt * vel;
+    
+    
+    fragColor = vec4(valueToVec(pos, POS_RANGE),
+                     valueToVec(vel, VEL_RANGE));
+}
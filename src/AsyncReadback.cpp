@@ -0,0 +1,175 @@
+#include "AsyncReadback.hpp"
+
+#include "GLHelper.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+AsyncReadback::AsyncReadback (sf::Vector2u size, unsigned int ringSize, GLenum type):
+            _size (size),
+            _type (type),
+            _slots (std::max(1u, ringSize)),
+            _oldestSlot (0),
+            _pendingCount (0),
+            _droppedCount (0)
+{
+    if (_type != GL_UNSIGNED_BYTE && _type != GL_FLOAT)
+        throw std::runtime_error("AsyncReadback: unsupported pixel type");
+
+    GLsizeiptr bufferSize = static_cast<GLsizeiptr>(getBufferSize());
+
+    for (Slot& slot : _slots) {
+        slot.fence = 0;
+        slot.step = 0;
+
+        GLCHECK(glGenBuffers(1, &slot.bufferID));
+        GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.bufferID));
+        GLCHECK(glBufferData(GL_PIXEL_PACK_BUFFER, bufferSize, nullptr, GL_STREAM_READ));
+    }
+
+    GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+}
+
+AsyncReadback::~AsyncReadback()
+{
+    for (Slot& slot : _slots) {
+        if (slot.fence != 0) {
+            GLCHECK(glDeleteSync(slot.fence));
+        }
+        GLCHECK(glDeleteBuffers(1, &slot.bufferID));
+    }
+}
+
+sf::Vector2u AsyncReadback::getSize() const
+{
+    return _size;
+}
+
+bool AsyncReadback::request (sf::Texture const& texture, unsigned long step)
+{
+    if (texture.getSize() != _size)
+        throw std::runtime_error("AsyncReadback: texture size mismatch");
+
+    Slot* slot = acquireSlot(step);
+    if (slot == nullptr)
+        return false;
+
+    GLint previousTexture = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+
+    /* With a pack buffer bound, the copy is asynchronous */
+    GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->bufferID));
+    GLCHECK(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, texture.getNativeHandle()));
+    GLCHECK(glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, _type, (void*)0));
+    GLCHECK(slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+    GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+    return true;
+}
+
+bool AsyncReadback::requestFramebuffer (unsigned long step)
+{
+    Slot* slot = acquireSlot(step);
+    if (slot == nullptr)
+        return false;
+
+    /* With a pack buffer bound, the copy is asynchronous */
+    GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->bufferID));
+    GLCHECK(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GLCHECK(glReadPixels(0, 0, _size.x, _size.y, GL_RGBA, _type, (void*)0));
+    GLCHECK(slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+    GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+    return true;
+}
+
+AsyncReadback::Slot* AsyncReadback::acquireSlot (unsigned long step)
+{
+    if (_pendingCount == _slots.size()) {
+        ++_droppedCount;
+        return nullptr;
+    }
+
+    Slot& slot = _slots[(_oldestSlot + _pendingCount) % _slots.size()];
+    slot.step = step;
+    ++_pendingCount;
+
+    return &slot;
+}
+
+bool AsyncReadback::retrieve (std::vector<sf::Uint8>& pixels, unsigned long& step)
+{
+    if (_type != GL_UNSIGNED_BYTE)
+        throw std::runtime_error("AsyncReadback: pixels are not bytes");
+
+    pixels.resize(4 * _size.x * _size.y);
+    return retrieveData(pixels.data(), step);
+}
+
+bool AsyncReadback::retrieve (std::vector<float>& pixels, unsigned long& step)
+{
+    if (_type != GL_FLOAT)
+        throw std::runtime_error("AsyncReadback: pixels are not floats");
+
+    pixels.resize(4 * _size.x * _size.y);
+    return retrieveData(pixels.data(), step);
+}
+
+bool AsyncReadback::retrieveData (void* destination, unsigned long& step)
+{
+    if (_pendingCount == 0)
+        return false;
+
+    Slot& slot = _slots[_oldestSlot];
+
+    /* Zero timeout: only polls the fence */
+    GLenum status = GL_TIMEOUT_EXPIRED;
+    GLCHECK(status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0));
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+
+    GLCHECK(glDeleteSync(slot.fence));
+    slot.fence = 0;
+
+    GLsizeiptr bufferSize = static_cast<GLsizeiptr>(getBufferSize());
+
+    GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.bufferID));
+    void* data = nullptr;
+    GLCHECK(data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bufferSize, GL_MAP_READ_BIT));
+    if (data != nullptr) {
+        std::memcpy(destination, data, bufferSize);
+        GLCHECK(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+    }
+    GLCHECK(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+    step = slot.step;
+    _oldestSlot = (_oldestSlot + 1) % _slots.size();
+    --_pendingCount;
+
+    if (data == nullptr)
+        throw std::runtime_error("AsyncReadback: unable to map buffer");
+
+    return true;
+}
+
+std::size_t AsyncReadback::getBufferSize() const
+{
+    std::size_t componentSize = (_type == GL_FLOAT) ? sizeof(float) : sizeof(sf::Uint8);
+    return 4 * componentSize * _size.x * _size.y;
+}
+
+unsigned int AsyncReadback::getPendingCount() const
+{
+    return _pendingCount;
+}
+
+unsigned long AsyncReadback::getDroppedCount() const
+{
+    return _droppedCount;
+}
@@ -0,0 +1,159 @@
+#include "AsyncUpload.hpp"
+
+#include "GLHelper.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+AsyncUpload::AsyncUpload (sf::Vector2u size, unsigned int ringSize):
+            _size (size),
+            _persistent (GLEW_ARB_buffer_storage),
+            _slots (std::max(1u, ringSize)),
+            _nextSlot (0),
+            _writing (false),
+            _uploadedCount (0),
+            _droppedCount (0)
+{
+    if (!_texture.create(_size.x, _size.y))
+        throw std::runtime_error("AsyncUpload: unable to create texture");
+    _texture.setSmooth(true);
+    setFloatStorage(_texture, GL_RG32F, GL_RG, false);
+
+    GLsizeiptr bufferSize = static_cast<GLsizeiptr>(getBufferSize());
+    const GLbitfield persistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    for (Slot& slot : _slots) {
+        slot.fence = 0;
+        slot.data = nullptr;
+
+        GLCHECK(glGenBuffers(1, &slot.bufferID));
+        GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.bufferID));
+        if (_persistent) {
+            GLCHECK(glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, persistentFlags));
+            GLCHECK(slot.data = static_cast<float*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, persistentFlags)));
+            if (slot.data == nullptr)
+                throw std::runtime_error("AsyncUpload: unable to map buffer");
+        } else {
+            GLCHECK(glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, GL_STREAM_DRAW));
+        }
+    }
+
+    GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
+AsyncUpload::~AsyncUpload()
+{
+    for (Slot& slot : _slots) {
+        if (slot.fence != 0) {
+            GLCHECK(glDeleteSync(slot.fence));
+        }
+        if (slot.data != nullptr) {
+            GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.bufferID));
+            GLCHECK(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+        }
+        GLCHECK(glDeleteBuffers(1, &slot.bufferID));
+    }
+    GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
+sf::Vector2u AsyncUpload::getSize() const
+{
+    return _size;
+}
+
+float* AsyncUpload::beginFrame ()
+{
+    if (_writing)
+        throw std::runtime_error("AsyncUpload: frame already begun");
+
+    Slot& slot = _slots[_nextSlot];
+
+    /* Zero timeout: only polls the fence of the previous copy from this buffer */
+    if (slot.fence != 0) {
+        GLenum status = GL_TIMEOUT_EXPIRED;
+        GLCHECK(status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0));
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            ++_droppedCount;
+            return nullptr;
+        }
+
+        GLCHECK(glDeleteSync(slot.fence));
+        slot.fence = 0;
+    }
+
+    if (!_persistent) {
+        /* The copy is over: no need to synchronize */
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.bufferID));
+        GLCHECK(slot.data = static_cast<float*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(getBufferSize()), flags)));
+        GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+        if (slot.data == nullptr)
+            throw std::runtime_error("AsyncUpload: unable to map buffer");
+    }
+
+    _writing = true;
+    return slot.data;
+}
+
+void AsyncUpload::endFrame ()
+{
+    if (!_writing)
+        throw std::runtime_error("AsyncUpload: no frame begun");
+
+    Slot& slot = _slots[_nextSlot];
+
+    GLint previousTexture = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+
+    GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.bufferID));
+    if (!_persistent) {
+        GLCHECK(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+        slot.data = nullptr;
+    }
+
+    /* With an unpack buffer bound, the copy is asynchronous */
+    GLCHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, _texture.getNativeHandle()));
+    GLCHECK(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _size.x, _size.y, GL_RG, GL_FLOAT, (void*)0));
+    GLCHECK(slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+    GLCHECK(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+    _nextSlot = (_nextSlot + 1) % _slots.size();
+    _writing = false;
+    ++_uploadedCount;
+}
+
+bool AsyncUpload::upload (const float* field)
+{
+    float* data = beginFrame();
+    if (data == nullptr)
+        return false;
+
+    std::memcpy(data, field, getBufferSize());
+    endFrame();
+    return true;
+}
+
+sf::Texture const& AsyncUpload::getTexture() const
+{
+    return _texture;
+}
+
+unsigned long AsyncUpload::getUploadedCount() const
+{
+    return _uploadedCount;
+}
+
+unsigned long AsyncUpload::getDroppedCount() const
+{
+    return _droppedCount;
+}
+
+std::size_t AsyncUpload::getBufferSize() const
+{
+    return 2 * sizeof(float) * static_cast<std::size_t>(_size.x) * _size.y;
+}
@@ -0,0 +1,208 @@
+#include "ControlServer.hpp"
+
+#include "Profiler.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+ControlServer::ControlServer (std::string const& path, std::size_t queueCapacity):
+            _path (path),
+            _socket (-1),
+            _queue (queueCapacity),
+            _receivedCount (0),
+            _rejectedCount (0)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (_path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("ControlServer: socket path too long: " + _path + ".");
+    std::strcpy(address.sun_path, _path.c_str());
+
+    _socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_socket < 0)
+        throw std::runtime_error("ControlServer: unable to create socket.");
+
+    unlink(_path.c_str());
+    if (bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(_socket, 16) != 0) {
+        close(_socket);
+        throw std::runtime_error("ControlServer: unable to listen on " + _path + ".");
+    }
+    fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL) | O_NONBLOCK);
+
+    if (pipe(_wakeUpPipe) != 0) {
+        close(_socket);
+        unlink(_path.c_str());
+        throw std::runtime_error("ControlServer: unable to create pipe.");
+    }
+
+    _thread = std::thread(&ControlServer::run, this);
+}
+
+ControlServer::~ControlServer()
+{
+    char byte = 0;
+    while (write(_wakeUpPipe[1], &byte, 1) < 0 && errno == EINTR);
+    _thread.join();
+
+    for (Client& client : _clients)
+        close(client.fd);
+    close(_wakeUpPipe[0]);
+    close(_wakeUpPipe[1]);
+    close(_socket);
+    unlink(_path.c_str());
+}
+
+std::string const& ControlServer::getPath() const
+{
+    return _path;
+}
+
+std::size_t ControlServer::drain (std::vector<ControlCommand>& commands)
+{
+    return _queue.pop(commands);
+}
+
+unsigned long ControlServer::getReceivedCount() const
+{
+    return _receivedCount;
+}
+
+unsigned long ControlServer::getRejectedCount() const
+{
+    return _rejectedCount;
+}
+
+void ControlServer::run()
+{
+    Profiler::setThreadName("control server");
+
+    std::vector<pollfd> fds;
+    while (true) {
+        /* The backlogged clients are not read until the queue is drained */
+        bool backlogged = false;
+        fds.clear();
+        fds.push_back({_wakeUpPipe[0], POLLIN, 0});
+        fds.push_back({_socket, POLLIN, 0});
+        for (Client const& client : _clients) {
+            bool clientBacklogged = isBacklogged(client);
+            backlogged = backlogged || clientBacklogged;
+            /* Negative descriptors are ignored, hang-ups included */
+            fds.push_back({clientBacklogged || client.closed ? -1 : client.fd, POLLIN, 0});
+        }
+
+        /* The drains are not signaled: the backlog is retried every millisecond */
+        if (poll(fds.data(), fds.size(), backlogged ? 1 : -1) < 0 && errno != EINTR)
+            return;
+
+        if (fds[0].revents != 0)
+            return;
+
+        if (fds[1].revents & POLLIN)
+            accept();
+
+        /* The clients accepted above are not in fds yet */
+        std::size_t polledCount = fds.size() - 2;
+        std::size_t kept = 0;
+        for (std::size_t i = 0 ; i < _clients.size() ; ++i) {
+            Client& client = _clients[i];
+            bool isReadable = (i < polledCount) && (fds[i + 2].revents != 0);
+
+            bool keep = isReadable ? read(client) : queue(client);
+            keep = keep && !(client.closed && client.size < sizeof(ControlCommand));
+            if (!keep) {
+                close(client.fd);
+                continue;
+            }
+
+            if (kept != i)
+                _clients[kept] = std::move(client);
+            ++kept;
+        }
+        _clients.resize(kept);
+    }
+}
+
+void ControlServer::accept()
+{
+    while (true) {
+        int fd = ::accept(_socket, nullptr, nullptr);
+        if (fd < 0)
+            return;
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        Client client;
+        client.fd = fd;
+        client.buffer.resize(BUFFER_COMMANDS);
+        client.size = 0;
+        client.closed = false;
+        _clients.push_back(std::move(client));
+    }
+}
+
+bool ControlServer::read (Client& client)
+{
+    PROFILE_ZONE("ControlServer::read");
+
+    /* Commands already received are queued first, to keep their order */
+    if (!queue(client))
+        return false;
+
+    char* buffer = reinterpret_cast<char*>(client.buffer.data());
+    std::size_t capacity = client.buffer.size() * sizeof(ControlCommand);
+
+    while (!client.closed && client.size < capacity) {
+        ssize_t received = recv(client.fd, buffer + client.size, capacity - client.size, 0);
+        if (received > 0) {
+            client.size += received;
+        } else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            client.closed = true;
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+
+    return queue(client);
+}
+
+bool ControlServer::queue (Client& client)
+{
+    std::size_t count = client.size / sizeof(ControlCommand);
+    if (count == 0)
+        return true;
+
+    /* The commands before an invalid one are still queued */
+    std::size_t validCount = 0;
+    while (validCount < count && static_cast<std::uint32_t>(client.buffer[validCount].type) <= static_cast<std::uint32_t>(ControlCommandType::Parameters))
+        ++validCount;
+
+    std::size_t queued = _queue.push(client.buffer.data(), validCount);
+    _receivedCount += queued;
+
+    /* Once they all are, the client is closed */
+    if (queued == validCount && validCount < count) {
+        ++_rejectedCount;
+        return false;
+    }
+
+    /* The rest, including a partial command, moves to the front */
+    char* buffer = reinterpret_cast<char*>(client.buffer.data());
+    std::size_t queuedSize = queued * sizeof(ControlCommand);
+    std::memmove(buffer, buffer + queuedSize, client.size - queuedSize);
+    client.size -= queuedSize;
+    return true;
+}
+
+bool ControlServer::isBacklogged (Client const& client)
+{
+    return client.size >= sizeof(ControlCommand);
+}
@@ -0,0 +1,242 @@
+#include "CpuLightsRenderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+
+CpuLightsRenderer::CpuLightsRenderer (unsigned int quality,
+                                      float amplitude,
+                                      float waterLevel,
+                                      float eta,
+                                      glm::vec3 const& lightDir,
+                                      unsigned int threadsCount):
+            Renderer::Renderer(amplitude, waterLevel, eta, glm::vec4(1), 2.f, lightDir),
+            _quality(std::max(2u, quality)),
+            _partPerPixel(2),
+            _intensity(0.2f / static_cast<float>(_partPerPixel*_partPerPixel)),
+            _exposureShift(1.5f),
+            _exposureStretch(0.4f),
+            _threadPool(threadsCount),
+            _accumulations(_threadPool.getThreadsCount())
+{
+    createBuffers();
+}
+
+void CpuLightsRenderer::createBuffers ()
+{
+    std::size_t texelsCount = static_cast<std::size_t>(_quality) * _quality;
+    for (std::vector<float>& accumulation : _accumulations)
+        accumulation.assign(texelsCount, 0.f);
+    _rawLights.assign(texelsCount, 0.f);
+    _bandSums.assign((_quality + BAND_HEIGHT - 1) / BAND_HEIGHT, 0.0);
+    _pixels.assign(4 * texelsCount, 0);
+}
+
+std::vector<std::uint8_t> const& CpuLightsRenderer::getPixels() const
+{
+    return _pixels;
+}
+
+std::vector<float> const& CpuLightsRenderer::getRawLights() const
+{
+    return _rawLights;
+}
+
+void CpuLightsRenderer::setQuality (unsigned int quality)
+{
+    quality = std::max(2u, quality);
+    if (quality == _quality)
+        return;
+
+    _quality = quality;
+    createBuffers();
+}
+unsigned int CpuLightsRenderer::getQuality() const
+{
+    return _quality;
+}
+
+void CpuLightsRenderer::setParticlesPerPixel (unsigned int particles)
+{
+    _partPerPixel = std::max(1u, particles);
+    _intensity = 0.2f / static_cast<float>(_partPerPixel*_partPerPixel);
+}
+unsigned int CpuLightsRenderer::getParticlesPerPixel() const
+{
+    return _partPerPixel;
+}
+
+void CpuLightsRenderer::update (const std::uint8_t* heightmap, sf::Vector2u heightmapSize)
+{
+    CpuTexture heightmapTexture;
+    heightmapTexture.reference(heightmap, heightmapSize, false);
+
+    /* Each thread splats into its own buffer */
+    unsigned int gridSize = _partPerPixel * _quality;
+    unsigned int bandsCount = (gridSize + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    _threadPool.run(bandsCount, [&] (unsigned int band, unsigned int thread) {
+        unsigned int firstRow = band * BAND_HEIGHT;
+        splatParticles(heightmapTexture, firstRow, std::min(firstRow + BAND_HEIGHT, gridSize),
+                       _accumulations[thread].data());
+    });
+
+    computeRawLights();
+    computeProcessedLights();
+}
+
+void CpuLightsRenderer::splatParticles (CpuTexture const& heightmap,
+                                        unsigned int firstRow,
+                                        unsigned int lastRow,
+                                        float* accumulation) const
+{
+    const unsigned int gridSize = _partPerPixel * _quality;
+    const float step = 1.f / static_cast<float>(gridSize);
+    const glm::vec3 lightDir = getLightDirection();
+
+#ifdef __SSE2__
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 byteScale = _mm_set1_ps(1.f / 255.f);
+    const __m128 amplitude = _mm_set1_ps(getAmplitude());
+    const __m128 level = _mm_set1_ps(getWaterLevel());
+    const __m128 eta = _mm_set1_ps(getEta());
+    const __m128 etaSquared = _mm_set1_ps(getEta() * getEta());
+    const __m128 lightX = _mm_set1_ps(lightDir.x);
+    const __m128 lightY = _mm_set1_ps(lightDir.y);
+    const __m128 lightZ = _mm_set1_ps(lightDir.z);
+    const __m128 quality = _mm_set1_ps(static_cast<float>(_quality));
+    const __m128 lastTexel = _mm_set1_ps(static_cast<float>(_quality - 1));
+    const __m128 particleOffsets = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+#endif // __SSE2__
+
+    for (unsigned int iY = firstRow ; iY < lastRow ; ++iY) {
+        const float v = static_cast<float>(iY) * step;
+        unsigned int iX = 0;
+
+#ifdef __SSE2__
+        /* 4 particles per iteration */
+        for ( ; iX + 4 <= gridSize ; iX += 4) {
+            __m128 u = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(iX)), particleOffsets), _mm_set1_ps(step));
+            alignas(16) float coordsU[4];
+            _mm_store_ps(coordsU, u);
+
+            /* One texel per register, then one channel per register */
+            __m128 r = heightmap.sample4(coordsU[0], v);
+            __m128 g = heightmap.sample4(coordsU[1], v);
+            __m128 b = heightmap.sample4(coordsU[2], v);
+            __m128 a = heightmap.sample4(coordsU[3], v);
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+
+            __m128 height = _mm_add_ps(level, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(a, byteScale), half), amplitude));
+
+            __m128 normalX = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(r, byteScale), half), amplitude);
+            __m128 normalY = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(g, byteScale), half), amplitude);
+            __m128 normalZ = _mm_sub_ps(_mm_mul_ps(b, byteScale), half);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX),
+                                                              _mm_mul_ps(normalY, normalY)),
+                                                   _mm_mul_ps(normalZ, normalZ)));
+            __m128 invLength = _mm_div_ps(one, length);
+            normalX = _mm_mul_ps(normalX, invLength);
+            normalY = _mm_mul_ps(normalY, invLength);
+            normalZ = _mm_mul_ps(normalZ, invLength);
+
+            /* Refraction of the light: no refracted ray when k < 0 */
+            __m128 dotLight = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, lightX), _mm_mul_ps(normalY, lightY)),
+                                         _mm_mul_ps(normalZ, lightZ));
+            __m128 k = _mm_sub_ps(one, _mm_mul_ps(etaSquared, _mm_sub_ps(one, _mm_mul_ps(dotLight, dotLight))));
+            __m128 t = _mm_add_ps(_mm_mul_ps(eta, dotLight), _mm_sqrt_ps(_mm_max_ps(k, zero)));
+            __m128 refractedX = _mm_sub_ps(_mm_mul_ps(eta, lightX), _mm_mul_ps(t, normalX));
+            __m128 refractedY = _mm_sub_ps(_mm_mul_ps(eta, lightY), _mm_mul_ps(t, normalY));
+            __m128 refractedZ = _mm_sub_ps(_mm_mul_ps(eta, lightZ), _mm_mul_ps(t, normalZ));
+            int valid = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(k, zero), _mm_cmpneq_ps(refractedZ, zero)));
+
+            /* Extended to the ground, then wrapped into the box */
+            __m128 factor = _mm_div_ps(_mm_sub_ps(zero, height), refractedZ);
+            __m128 x = _mm_add_ps(u, _mm_mul_ps(refractedX, factor));
+            __m128 y = _mm_add_ps(_mm_set1_ps(v), _mm_mul_ps(refractedY, factor));
+            __m128 floorX = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+            __m128 floorY = _mm_cvtepi32_ps(_mm_cvttps_epi32(y));
+            floorX = _mm_sub_ps(floorX, _mm_and_ps(_mm_cmpgt_ps(floorX, x), one));
+            floorY = _mm_sub_ps(floorY, _mm_and_ps(_mm_cmpgt_ps(floorY, y), one));
+            x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(x, floorX), quality), zero), lastTexel);
+            y = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(y, floorY), quality), zero), lastTexel);
+
+            alignas(16) std::int32_t texelX[4], texelY[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(texelX), _mm_cvttps_epi32(x));
+            _mm_store_si128(reinterpret_cast<__m128i*>(texelY), _mm_cvttps_epi32(y));
+
+            for (unsigned int i = 0 ; i < 4 ; ++i) {
+                if (valid & (1 << i))
+                    accumulation[texelY[i] * _quality + texelX[i]] += _intensity;
+            }
+        }
+#endif // __SSE2__
+
+        for ( ; iX < gridSize ; ++iX) {
+            glm::vec2 pos(static_cast<float>(iX) * step, v);
+            glm::vec4 heightColor = heightmap.sample(pos.x, pos.y) / 255.f;
+
+            float height = getWaterLevel() + (heightColor.a - 0.5f) * getAmplitude();
+            glm::vec3 normal = glm::vec3(heightColor) - 0.5f;
+            normal.x *= getAmplitude();
+            normal.y *= getAmplitude();
+            normal = glm::normalize(normal);
+
+            glm::vec3 refracted = glm::refract(lightDir, normal, getEta());
+            if (refracted.z == 0.f)
+                continue;
+            refracted *= -height / refracted.z;
+
+            glm::vec2 coordsOnTiles = glm::fract(pos + glm::vec2(refracted));
+            unsigned int texelX = std::min(static_cast<unsigned int>(std::max(coordsOnTiles.x * _quality, 0.f)), _quality - 1);
+            unsigned int texelY = std::min(static_cast<unsigned int>(std::max(coordsOnTiles.y * _quality, 0.f)), _quality - 1);
+            accumulation[texelY * _quality + texelX] += _intensity;
+        }
+    }
+}
+
+void CpuLightsRenderer::computeRawLights ()
+{
+    unsigned int bandsCount = _bandSums.size();
+    _threadPool.run(bandsCount, [&] (unsigned int band, unsigned int) {
+        std::size_t first = static_cast<std::size_t>(band) * BAND_HEIGHT * _quality;
+        std::size_t last = std::min(first + BAND_HEIGHT * _quality, _rawLights.size());
+
+        /* Buffer after buffer, texel after texel: the loops vectorize */
+        float* rawLights = _rawLights.data();
+        std::fill(rawLights + first, rawLights + last, 0.f);
+        for (std::vector<float>& accumulation : _accumulations) {
+            float* splats = accumulation.data();
+            for (std::size_t i = first ; i < last ; ++i)
+                rawLights[i] += splats[i];
+            std::fill(splats + first, splats + last, 0.f);
+        }
+
+        _bandSums[band] = std::accumulate(rawLights + first, rawLights + last, 0.0);
+    });
+}
+
+void CpuLightsRenderer::computeProcessedLights ()
+{
+    double sum = std::accumulate(_bandSums.begin(), _bandSums.end(), 0.0);
+    float average = std::max(static_cast<float>(sum / _rawLights.size()), 0.0001f);
+    float shift = _exposureShift * average;
+    float stretch = _exposureStretch / average;
+
+    unsigned int bandsCount = _bandSums.size();
+    _threadPool.run(bandsCount, [&] (unsigned int band, unsigned int) {
+        std::size_t first = static_cast<std::size_t>(band) * BAND_HEIGHT * _quality;
+        std::size_t last = std::min(first + BAND_HEIGHT * _quality, _rawLights.size());
+
+        for (std::size_t i = first ; i < last ; ++i) {
+            float lights = std::max(0.f, _rawLights[i] - shift) * stretch;
+            std::uint8_t value = static_cast<std::uint8_t>(255.f * (1.f - std::exp(-lights)) + 0.5f);
+            _pixels[4*i+0] = value;
+            _pixels[4*i+1] = value;
+            _pixels[4*i+2] = value;
+            _pixels[4*i+3] = value;
+        }
+    });
+}
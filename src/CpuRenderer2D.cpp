@@ -0,0 +1,203 @@
+#include "CpuRenderer2D.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+CpuRenderer2D::CpuRenderer2D(float amplitude,
+                             float waterLevel,
+                             float eta,
+                             glm::vec4 const& waterColor,
+                             float viewDistance,
+                             glm::vec3 const& lightDir,
+                             unsigned int threadsCount):
+            Renderer(amplitude, waterLevel, eta, waterColor, viewDistance, lightDir),
+            _threadPool(threadsCount)
+{
+}
+
+void CpuRenderer2D::setGroundTexture (sf::Image const& image)
+{
+    _groundTexture = CpuTexture(image.getPixelsPtr(), image.getSize(), true);
+}
+
+void CpuRenderer2D::draw (const std::uint8_t* heightmap,
+                          sf::Vector2u heightmapSize,
+                          sf::Vector2u size,
+                          std::vector<std::uint8_t>& pixels)
+{
+    if (_groundTexture.getSize().x == 0 || _groundTexture.getSize().y == 0)
+        throw std::runtime_error("CpuRenderer2D: no ground texture.");
+
+    pixels.resize(4 * static_cast<std::size_t>(size.x) * size.y);
+    if (pixels.empty())
+        return;
+
+    CpuTexture heightmapTexture;
+    heightmapTexture.reference(heightmap, heightmapSize, false);
+
+    unsigned int bandsCount = (size.y + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    _threadPool.run(bandsCount, [&] (unsigned int band, unsigned int) {
+        unsigned int firstRow = band * BAND_HEIGHT;
+        drawRows(heightmapTexture, size, firstRow, std::min(firstRow + BAND_HEIGHT, size.y), pixels.data());
+    });
+}
+
+void CpuRenderer2D::drawRows (CpuTexture const& heightmap,
+                              sf::Vector2u size,
+                              unsigned int firstRow,
+                              unsigned int lastRow,
+                              std::uint8_t* pixels) const
+{
+    const glm::vec2 pixelSize(1.f / static_cast<float>(size.x), 1.f / static_cast<float>(size.y));
+
+    /* Then the pixels fall on the texels centers: no need to interpolate */
+    const bool sameSize = (heightmap.getSize() == size);
+
+#ifdef __SSE2__
+    const glm::vec4 waterColor = 255.f * getWaterColor();
+    const glm::vec3 lightDir = getLightDirection();
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 byteScale = _mm_set1_ps(1.f / 255.f);
+    const __m128 amplitude = _mm_set1_ps(getAmplitude());
+    const __m128 eta = _mm_set1_ps(getEta());
+    const __m128 etaSquared = _mm_set1_ps(getEta() * getEta());
+    const __m128 level = _mm_set1_ps(getWaterLevel());
+    const __m128 levelSquared = _mm_set1_ps(getWaterLevel() * getWaterLevel());
+    const __m128 invViewDistance = _mm_set1_ps(1.f / getViewDistance());
+    const __m128 lightX = _mm_set1_ps(lightDir.x);
+    const __m128 lightY = _mm_set1_ps(lightDir.y);
+    const __m128 lightZ = _mm_set1_ps(lightDir.z);
+    const __m128 sparkleMin = _mm_set1_ps(0.98f);
+    const __m128 sparkleScale = _mm_set1_ps(1.f / 0.02f);
+    const __m128 water = _mm_setr_ps(waterColor.r, waterColor.g, waterColor.b, waterColor.a);
+    const __m128 maxColor = _mm_set1_ps(255.f);
+    const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+#endif // __SSE2__
+
+    for (unsigned int iY = firstRow ; iY < lastRow ; ++iY) {
+        std::uint8_t* row = pixels + 4 * static_cast<std::size_t>(size.x) * iY;
+        const float v = (static_cast<float>(iY) + 0.5f) * pixelSize.y;
+        unsigned int iX = 0;
+
+#ifdef __SSE2__
+        /* 4 pixels per iteration */
+        for ( ; iX + 4 <= size.x ; iX += 4) {
+            __m128 u = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(iX)), pixelOffsets), _mm_set1_ps(pixelSize.x));
+            alignas(16) float coordsU[4];
+            _mm_store_ps(coordsU, u);
+
+            /* One texel per register, then one channel per register */
+            __m128 r, g, b, a;
+            if (sameSize) {
+                r = heightmap.fetch4(iX+0, iY);
+                g = heightmap.fetch4(iX+1, iY);
+                b = heightmap.fetch4(iX+2, iY);
+                a = heightmap.fetch4(iX+3, iY);
+            } else {
+                r = heightmap.sample4(coordsU[0], v);
+                g = heightmap.sample4(coordsU[1], v);
+                b = heightmap.sample4(coordsU[2], v);
+                a = heightmap.sample4(coordsU[3], v);
+            }
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+
+            /* Normal */
+            __m128 normalX = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(r, byteScale), half), amplitude);
+            __m128 normalY = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(g, byteScale), half), amplitude);
+            __m128 normalZ = _mm_sub_ps(_mm_mul_ps(b, byteScale), half);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX),
+                                                              _mm_mul_ps(normalY, normalY)),
+                                                   _mm_mul_ps(normalZ, normalZ)));
+            __m128 invLength = _mm_div_ps(one, length);
+            normalX = _mm_mul_ps(normalX, invLength);
+            normalY = _mm_mul_ps(normalY, invLength);
+            normalZ = _mm_mul_ps(normalZ, invLength);
+
+            /* Refraction of (0,0,-1): no refracted ray when k < 0 */
+            __m128 k = _mm_sub_ps(one, _mm_mul_ps(etaSquared, _mm_sub_ps(one, _mm_mul_ps(normalZ, normalZ))));
+            __m128 t = _mm_sub_ps(_mm_sqrt_ps(_mm_max_ps(k, zero)), _mm_mul_ps(eta, normalZ));
+            __m128 refractedX = _mm_sub_ps(zero, _mm_mul_ps(t, normalX));
+            __m128 refractedY = _mm_sub_ps(zero, _mm_mul_ps(t, normalY));
+            __m128 refractedZ = _mm_sub_ps(_mm_sub_ps(zero, eta), _mm_mul_ps(t, normalZ));
+            __m128 reachesGround = _mm_and_ps(_mm_cmpge_ps(k, zero), _mm_cmplt_ps(refractedZ, zero));
+
+            /* Extended to the ground, waterLevel below */
+            __m128 factor = _mm_div_ps(level, _mm_sub_ps(zero, refractedZ));
+            refractedX = _mm_and_ps(reachesGround, _mm_mul_ps(refractedX, factor));
+            refractedY = _mm_and_ps(reachesGround, _mm_mul_ps(refractedY, factor));
+            __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(refractedX, refractedX),
+                                                                _mm_mul_ps(refractedY, refractedY)),
+                                                     levelSquared));
+            __m128 opacity = _mm_min_ps(_mm_mul_ps(distance, invViewDistance), one);
+            opacity = _mm_or_ps(_mm_and_ps(reachesGround, opacity), _mm_andnot_ps(reachesGround, one));
+
+            /* Specularity: z of the reflected light */
+            __m128 dotLight = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, lightX), _mm_mul_ps(normalY, lightY)),
+                                         _mm_mul_ps(normalZ, lightZ));
+            __m128 sparkle = _mm_sub_ps(lightZ, _mm_mul_ps(_mm_add_ps(dotLight, dotLight), normalZ));
+            sparkle = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(sparkle, sparkleMin), sparkleScale), zero), one);
+            sparkle = _mm_mul_ps(_mm_mul_ps(sparkle, sparkle), _mm_sub_ps(_mm_set1_ps(3.f), _mm_add_ps(sparkle, sparkle)));
+            sparkle = _mm_mul_ps(sparkle, maxColor);
+
+            alignas(16) float groundU[4], groundV[4], opacities[4], sparkles[4];
+            _mm_store_ps(groundU, _mm_add_ps(u, refractedX));
+            _mm_store_ps(groundV, _mm_add_ps(_mm_set1_ps(v), refractedY));
+            _mm_store_ps(opacities, opacity);
+            _mm_store_ps(sparkles, sparkle);
+
+            /* Ground sampling and blending, one pixel per register */
+            for (unsigned int i = 0 ; i < 4 ; ++i) {
+                __m128 color = water;
+                if (opacities[i] < 1.f) {
+                    __m128 tiles = _groundTexture.sample4(groundU[i], groundV[i]);
+                    color = _mm_add_ps(tiles, _mm_mul_ps(_mm_sub_ps(water, tiles), _mm_set1_ps(opacities[i])));
+                }
+                color = _mm_min_ps(_mm_max_ps(_mm_add_ps(color, _mm_set1_ps(sparkles[i])), zero), maxColor);
+
+                __m128i words = _mm_packs_epi32(_mm_cvtps_epi32(color), _mm_setzero_si128());
+                std::int32_t rgba = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+                std::memcpy(row + 4 * (iX + i), &rgba, 4);
+            }
+        }
+#endif // __SSE2__
+
+        for ( ; iX < size.x ; ++iX) {
+            glm::vec2 coords((static_cast<float>(iX) + 0.5f) * pixelSize.x, v);
+            glm::vec4 heightColor = sameSize ? heightmap.fetch(iX, iY) : heightmap.sample(coords.x, coords.y);
+            glm::vec4 color = glm::clamp(shadePixel(heightColor, coords), 0.f, 255.f);
+            for (unsigned int i = 0 ; i < 4 ; ++i)
+                row[4*iX + i] = static_cast<std::uint8_t>(color[i] + 0.5f);
+        }
+    }
+}
+
+glm::vec4 CpuRenderer2D::shadePixel (glm::vec4 const& heightColor, glm::vec2 const& coords) const
+{
+    glm::vec3 normal = glm::vec3(heightColor) / 255.f - 0.5f;
+    normal.x *= getAmplitude();
+    normal.y *= getAmplitude();
+    normal = glm::normalize(normal);
+
+    const glm::vec3 fromEye(0, 0, -1);
+
+    /* Refracted ground, seen through the water */
+    glm::vec4 color = 255.f * getWaterColor();
+    glm::vec3 refracted = glm::refract(fromEye, normal, getEta());
+    if (refracted.z < 0.f) {
+        refracted *= -getWaterLevel() / refracted.z;
+        glm::vec4 tilesColor = _groundTexture.sample(coords.x + refracted.x, coords.y + refracted.y);
+
+        float opacity = glm::clamp(glm::length(refracted) / getViewDistance(), 0.f, 1.f);
+        color = glm::mix(tilesColor, color, opacity);
+    }
+
+    /* Specularity */
+    glm::vec3 reflected = glm::normalize(glm::reflect(getLightDirection(), normal));
+    float sparkle = glm::dot(reflected, -fromEye);
+    return color + 255.f * glm::smoothstep(0.98f, 1.f, sparkle);
+}
@@ -0,0 +1,354 @@
+#include "CpuRenderer3D.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+CpuRenderer3D::CpuRenderer3D(float amplitude,
+                             float waterLevel,
+                             float eta,
+                             glm::vec4 const& waterColor,
+                             float viewDistance,
+                             glm::vec3 const& lightDir,
+                             unsigned int threadsCount):
+            Renderer(amplitude, waterLevel, eta, waterColor, viewDistance, lightDir),
+            _camera(glm::vec3(0.5,0.5,0.25)),
+            _threadPool(threadsCount)
+{
+}
+
+void CpuRenderer3D::setGroundTexture (sf::Image const& image)
+{
+    _groundTexture = CpuTexture(image.getPixelsPtr(), image.getSize(), true);
+}
+
+Camera& CpuRenderer3D::getCamera ()
+{
+    return _camera;
+}
+
+void CpuRenderer3D::draw (const std::uint8_t* heightmap,
+                          sf::Vector2u heightmapSize,
+                          const std::uint8_t* lights,
+                          sf::Vector2u lightsSize,
+                          sf::Vector2u size,
+                          std::vector<std::uint8_t>& pixels)
+{
+    if (_groundTexture.getSize().x == 0 || _groundTexture.getSize().y == 0)
+        throw std::runtime_error("CpuRenderer3D: no ground texture.");
+
+    pixels.resize(4 * static_cast<std::size_t>(size.x) * size.y);
+    if (pixels.empty() || heightmapSize.x == 0 || heightmapSize.y == 0)
+        return;
+
+    _heightmap.reference(heightmap, heightmapSize, false);
+    _lights.reference(lights, lightsSize, true);
+    computePyramid();
+
+    /* Each pixel casts the ray between its points on the clipping planes */
+    const glm::mat4 inverseMatrix = glm::inverse(_camera.getMatrix());
+    const glm::vec3 eyePos = _camera.getPosition();
+
+    unsigned int tilesX = (size.x + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned int tilesY = (size.y + TILE_SIZE - 1) / TILE_SIZE;
+    _threadPool.run(tilesX * tilesY, [&] (unsigned int tile, unsigned int) {
+        unsigned int firstX = (tile % tilesX) * TILE_SIZE, firstY = (tile / tilesX) * TILE_SIZE;
+        unsigned int lastX = std::min(firstX + TILE_SIZE, size.x), lastY = std::min(firstY + TILE_SIZE, size.y);
+
+        for (unsigned int iY = firstY ; iY < lastY ; ++iY) {
+            for (unsigned int iX = firstX ; iX < lastX ; ++iX) {
+                glm::vec2 ndc(2.f * (static_cast<float>(iX) + 0.5f) / static_cast<float>(size.x) - 1.f,
+                              2.f * (static_cast<float>(iY) + 0.5f) / static_cast<float>(size.y) - 1.f);
+                glm::vec4 near = inverseMatrix * glm::vec4(ndc, -1, 1);
+                glm::vec4 far = inverseMatrix * glm::vec4(ndc, 1, 1);
+                glm::vec3 origin = glm::vec3(near) / near.w;
+                glm::vec3 direction = glm::vec3(far) / far.w - origin;
+
+                glm::vec4 color = glm::clamp(castRay(origin, direction, eyePos), 0.f, 255.f);
+                std::uint8_t* pixel = pixels.data() + 4 * (static_cast<std::size_t>(iY) * size.x + iX);
+                for (unsigned int i = 0 ; i < 4 ; ++i)
+                    pixel[i] = static_cast<std::uint8_t>(color[i] + 0.5f);
+            }
+        }
+    });
+}
+
+void CpuRenderer3D::computePyramid ()
+{
+    const sf::Vector2u size = _heightmap.getSize();
+
+    _pyramidSizes.assign(1, size);
+    _pyramid.resize(1);
+    _pyramid[0].resize(static_cast<std::size_t>(size.x) * size.y);
+
+    /* Over a texel, the interpolated surface stays between the heights
+     * of the texel and its 8 neighbours: first along the rows, then
+     * along the columns. */
+    std::vector<Bounds> rowBounds(_pyramid[0].size());
+    _threadPool.run(size.y, [&] (unsigned int iY, unsigned int) {
+        for (unsigned int iX = 0 ; iX < size.x ; ++iX) {
+            Bounds& bounds = rowBounds[iY * size.x + iX];
+            bounds.min = bounds.max = _heightmap.getTexel(iX, iY)[3];
+            for (unsigned int neighbour : {std::max(iX, 1u) - 1, std::min(iX + 1, size.x - 1)}) {
+                float value = _heightmap.getTexel(neighbour, iY)[3];
+                bounds.min = std::min(bounds.min, value);
+                bounds.max = std::max(bounds.max, value);
+            }
+        }
+    });
+    const float scale = getAmplitude() / 255.f;
+    const float offset = getWaterLevel() - 0.5f * getAmplitude();
+    _threadPool.run(size.y, [&] (unsigned int iY, unsigned int) {
+        for (unsigned int iX = 0 ; iX < size.x ; ++iX) {
+            Bounds bounds = rowBounds[iY * size.x + iX];
+            for (unsigned int neighbour : {std::max(iY, 1u) - 1, std::min(iY + 1, size.y - 1)}) {
+                bounds.min = std::min(bounds.min, rowBounds[neighbour * size.x + iX].min);
+                bounds.max = std::max(bounds.max, rowBounds[neighbour * size.x + iX].max);
+            }
+            _pyramid[0][iY * size.x + iX] = {offset + scale * bounds.min, offset + scale * bounds.max};
+        }
+    });
+
+    /* Each cell bounds its 4 children (fewer on the borders of odd sizes) */
+    while (_pyramidSizes.back().x > 1 || _pyramidSizes.back().y > 1) {
+        const sf::Vector2u childSize = _pyramidSizes.back();
+        const sf::Vector2u levelSize((childSize.x + 1) / 2, (childSize.y + 1) / 2);
+        std::vector<Bounds> const& children = _pyramid.back();
+        std::vector<Bounds> level(static_cast<std::size_t>(levelSize.x) * levelSize.y);
+
+        for (unsigned int iY = 0 ; iY < levelSize.y ; ++iY) {
+            for (unsigned int iX = 0 ; iX < levelSize.x ; ++iX) {
+                Bounds bounds = children[2*iY * childSize.x + 2*iX];
+                for (unsigned int childY = 2*iY ; childY < std::min(2*iY + 2, childSize.y) ; ++childY) {
+                    for (unsigned int childX = 2*iX ; childX < std::min(2*iX + 2, childSize.x) ; ++childX) {
+                        bounds.min = std::min(bounds.min, children[childY * childSize.x + childX].min);
+                        bounds.max = std::max(bounds.max, children[childY * childSize.x + childX].max);
+                    }
+                }
+                level[iY * levelSize.x + iX] = bounds;
+            }
+        }
+
+        _pyramidSizes.push_back(levelSize);
+        _pyramid.push_back(std::move(level));
+    }
+}
+
+float CpuRenderer3D::getHeight (glm::vec2 const& coords) const
+{
+    float alpha = _heightmap.sample(coords.x, coords.y).a / 255.f;
+    return getWaterLevel() + (alpha - 0.5f) * getAmplitude();
+}
+
+glm::vec4 CpuRenderer3D::castRay (glm::vec3 const& origin,
+                                  glm::vec3 const& direction,
+                                  glm::vec3 const& eyePos) const
+{
+    const glm::vec4 background(0, 0, 0, 255);
+
+    /* Part of the ray above the tank: [tEntry, tExit] */
+    float tEntry = 0.f, tExit = 1.f;
+    int entryAxis = -1;
+    for (int axis = 0 ; axis < 2 ; ++axis) {
+        if (direction[axis] == 0.f) {
+            if (origin[axis] < 0.f || origin[axis] > 1.f)
+                return background;
+            continue;
+        }
+
+        float t0 = -origin[axis] / direction[axis];
+        float t1 = (1.f - origin[axis]) / direction[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        if (t0 > tEntry) {
+            tEntry = t0;
+            entryAxis = axis;
+        }
+        tExit = std::min(tExit, t1);
+    }
+    if (tEntry >= tExit)
+        return background;
+
+    /* Entering through a side: the cube is only drawn below the water.
+     * Under the tank, the faces seen are all culled. */
+    if (entryAxis >= 0) {
+        glm::vec3 position = origin + tEntry * direction;
+        if (position.z < 0.f)
+            return background;
+
+        if (position.z <= 1.f && position.z <= getHeight(glm::vec2(position))) {
+            glm::vec3 normal(0);
+            normal[entryAxis] = (direction[entryAxis] > 0.f) ? -1.f : 1.f;
+            glm::vec3 fromEye = glm::normalize(position - eyePos);
+            return computeSurfaceColor(position, normal, fromEye) + computeSpecularity(normal, fromEye);
+        }
+    }
+
+    /* The surface can only be hit below its highest point */
+    float top = _pyramid.back()[0].max;
+    if (direction.z < 0.f)
+        tEntry = std::max(tEntry, (top - origin.z) / direction.z);
+    else if (direction.z > 0.f)
+        tExit = std::min(tExit, (top - origin.z) / direction.z);
+    else if (origin.z > top)
+        return background;
+
+    float t;
+    if (tEntry >= tExit || !marchSurface(origin, direction, tEntry, tExit, t))
+        return background;
+
+    glm::vec3 position = origin + t * direction;
+    glm::vec3 normal = glm::vec3(_heightmap.sample(position.x, position.y)) / 255.f - 0.5f;
+    normal.x *= getAmplitude();
+    normal.y *= getAmplitude();
+    normal = glm::normalize(normal);
+    glm::vec3 fromEye = glm::normalize(position - eyePos);
+
+    return computeSurfaceColor(position, normal, fromEye) + computeSpecularity(normal, fromEye);
+}
+
+bool CpuRenderer3D::marchSurface (glm::vec3 const& origin,
+                                  glm::vec3 const& direction,
+                                  float tMin,
+                                  float tMax,
+                                  float& t) const
+{
+    /* Horizontally, in texels */
+    const glm::vec2 scale(_pyramidSizes[0].x, _pyramidSizes[0].y);
+    const glm::vec2 start = glm::vec2(origin) * scale;
+    const glm::vec2 step = glm::vec2(direction) * scale;
+
+    /* Cells are left a thousandth of a texel past their side */
+    const float epsilon = 0.001f / std::max(std::max(std::fabs(step.x), std::fabs(step.y)), 0.001f);
+
+    const unsigned int topLevel = _pyramid.size() - 1;
+    unsigned int level = topLevel;
+    t = tMin;
+    while (t < tMax) {
+        const unsigned int cellSize = 1u << level;
+        const sf::Vector2u levelSize = _pyramidSizes[level];
+        const glm::vec2 position = start + t * step;
+
+        int cellX = std::min(std::max(static_cast<int>(std::floor(position.x / cellSize)), 0), static_cast<int>(levelSize.x) - 1);
+        int cellY = std::min(std::max(static_cast<int>(std::floor(position.y / cellSize)), 0), static_cast<int>(levelSize.y) - 1);
+
+        float tCellExit = tMax;
+        if (step.x > 0.f)
+            tCellExit = std::min(tCellExit, (static_cast<float>((cellX + 1) * cellSize) - start.x) / step.x);
+        else if (step.x < 0.f)
+            tCellExit = std::min(tCellExit, (static_cast<float>(cellX * cellSize) - start.x) / step.x);
+        if (step.y > 0.f)
+            tCellExit = std::min(tCellExit, (static_cast<float>((cellY + 1) * cellSize) - start.y) / step.y);
+        else if (step.y < 0.f)
+            tCellExit = std::min(tCellExit, (static_cast<float>(cellY * cellSize) - start.y) / step.y);
+
+        /* Never backwards, when the position is clamped into the last cell */
+        tCellExit = std::max(tCellExit, t);
+
+        float zEntry = origin.z + t * direction.z;
+        float zExit = origin.z + tCellExit * direction.z;
+        Bounds const& bounds = _pyramid[level][cellY * levelSize.x + cellX];
+
+        if (std::min(zEntry, zExit) > bounds.max) {
+            /* Above the whole cell: skipped, then back to a coarser level */
+            t = tCellExit + epsilon;
+            level = std::min(level + 1, topLevel);
+        } else if (level > 0) {
+            --level;
+        } else {
+            if (refineIntersection(origin, direction, t, tCellExit, zExit < bounds.min, t))
+                return true;
+            t = tCellExit + epsilon;
+        }
+    }
+    return false;
+}
+
+bool CpuRenderer3D::refineIntersection (glm::vec3 const& origin,
+                                        glm::vec3 const& direction,
+                                        float tEntry,
+                                        float tExit,
+                                        bool certain,
+                                        float& t) const
+{
+    /* Height of the ray above the surface */
+    auto gap = [&] (float tRay) {
+        glm::vec3 position = origin + tRay * direction;
+        return position.z - getHeight(glm::vec2(position));
+    };
+
+    float tAbove = tEntry, gapAbove = gap(tEntry);
+    if (gapAbove <= 0.f) {
+        t = tEntry;
+        return true;
+    }
+
+    /* Linear search of a point below the surface, unless known */
+    const unsigned int steps = certain ? 1 : 4;
+    for (unsigned int i = 1 ; i <= steps ; ++i) {
+        float tBelow = tEntry + (tExit - tEntry) * static_cast<float>(i) / static_cast<float>(steps);
+        float gapBelow = gap(tBelow);
+        if (gapBelow > 0.f) {
+            tAbove = tBelow;
+            gapAbove = gapBelow;
+            continue;
+        }
+
+        /* Then a few secant steps */
+        t = tBelow;
+        for (unsigned int j = 0 ; j < 3 ; ++j) {
+            t = tAbove + (tBelow - tAbove) * gapAbove / (gapAbove - gapBelow);
+            float gapMiddle = gap(t);
+            if (gapMiddle > 0.f) {
+                tAbove = t;
+                gapAbove = gapMiddle;
+            } else {
+                tBelow = t;
+                gapBelow = gapMiddle;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+glm::vec4 CpuRenderer3D::computeGroundColor (glm::vec2 const& pos) const
+{
+    if (pos.x > 1.f || pos.x < 0.f || pos.y > 1.f || pos.y < 0.f)
+        return glm::vec4(0);
+    return _groundTexture.sample(pos.x, pos.y) + _lights.sample(pos.x, pos.y);
+}
+
+glm::vec4 CpuRenderer3D::computeSurfaceColor (glm::vec3 const& position,
+                                              glm::vec3 const& normalizedNormal,
+                                              glm::vec3 const& normalizedFromEye) const
+{
+    glm::vec4 waterColor = 255.f * getWaterColor();
+
+    /* Refracted ray going from the position to the ground */
+    glm::vec3 refracted = glm::refract(normalizedFromEye, normalizedNormal, getEta());
+    if (refracted.z >= 0.f)
+        return waterColor;
+
+    refracted *= -position.z / refracted.z;
+    glm::vec4 groundColor = computeGroundColor(glm::vec2(position) + glm::vec2(refracted));
+
+    float opacityFactor = glm::clamp(glm::length(refracted) / getViewDistance(), 0.f, 1.f);
+    glm::vec4 surfaceColor = glm::mix(groundColor, waterColor, opacityFactor);
+
+    /* Fresnel coefficient, with F0 = 0.5 */
+    float grazing = 1.f - glm::dot(normalizedNormal, -normalizedFromEye);
+    float fresnel = glm::mix(grazing * grazing * grazing * grazing * grazing, 1.f, 0.5f);
+
+    return glm::mix(surfaceColor, waterColor, fresnel);
+}
+
+glm::vec4 CpuRenderer3D::computeSpecularity (glm::vec3 const& normalizedNormal,
+                                             glm::vec3 const& normalizedFromEye) const
+{
+    glm::vec3 normalizedReflected = glm::normalize(glm::reflect(getLightDirection(), normalizedNormal));
+    float sparkleFactor = glm::dot(normalizedReflected, -normalizedFromEye);
+
+    return glm::vec4(255.f * glm::smoothstep(0.98f, 1.f, sparkleFactor));
+}
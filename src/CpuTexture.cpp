@@ -0,0 +1,35 @@
+#include "CpuTexture.hpp"
+
+
+CpuTexture::CpuTexture ():
+            _pixels (nullptr),
+            _size (0, 0),
+            _repeated (false)
+{
+}
+
+CpuTexture::CpuTexture (const std::uint8_t* pixels, sf::Vector2u size, bool repeated):
+            _ownPixels (pixels, pixels + 4 * static_cast<std::size_t>(size.x) * size.y),
+            _pixels (_ownPixels.data()),
+            _size (size),
+            _repeated (repeated)
+{
+}
+
+sf::Vector2u CpuTexture::getSize() const
+{
+    return _size;
+}
+
+bool CpuTexture::isRepeated() const
+{
+    return _repeated;
+}
+
+void CpuTexture::reference (const std::uint8_t* pixels, sf::Vector2u size, bool repeated)
+{
+    _ownPixels.clear();
+    _pixels = pixels;
+    _size = size;
+    _repeated = repeated;
+}
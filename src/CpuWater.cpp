@@ -0,0 +1,163 @@
+#include "CpuWater.hpp"
+
+#include "Decoding.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+CpuWater::CpuWater (sf::Vector2u gridSize,
+                    float propagation,
+                    float friction,
+                    float elasticity):
+            _gridSize (gridSize),
+            _friction (friction),
+            _propagation (propagation),
+            _elasticity (elasticity),
+            _currentIndex (0),
+            _step (0)
+{
+    for (std::vector<float>& buffer : _buffers)
+        buffer.resize(2 * static_cast<std::size_t>(_gridSize.x) * _gridSize.y);
+
+    init();
+}
+
+sf::Vector2u CpuWater::getGridSize() const
+{
+    return _gridSize;
+}
+
+float CpuWater::getPropagation() const
+{
+    return _propagation;
+}
+
+float CpuWater::getFriction() const
+{
+    return _friction;
+}
+
+float CpuWater::getElasticity() const
+{
+    return _elasticity;
+}
+
+const float* CpuWater::getState() const
+{
+    return _buffers[_currentIndex].data();
+}
+
+unsigned long CpuWater::getStep () const
+{
+    return _step;
+}
+
+void CpuWater::update (float time)
+{
+    unsigned int nextIndex = (_currentIndex + 1) % 2;
+
+    float dt = time * 10.f;
+
+    const std::size_t rowSize = 2 * static_cast<std::size_t>(_gridSize.x);
+    const float* current = _buffers[_currentIndex].data();
+    float* next = _buffers[nextIndex].data();
+    for (unsigned int y = 0 ; y < _gridSize.y ; ++y) {
+        const float* row = current + y * rowSize;
+        const float* below = (y > 0) ? row - rowSize : row;
+        const float* above = (y + 1 < _gridSize.y) ? row + rowSize : row;
+        updateRow(below, row, above, next + y * rowSize, _gridSize.x,
+                  dt, _propagation, _friction, _elasticity);
+    }
+
+    _currentIndex = nextIndex;
+    ++_step;
+}
+
+void CpuWater::init ()
+{
+    for (std::vector<float>& buffer : _buffers)
+        std::fill(buffer.begin(), buffer.end(), 0.f);
+}
+
+void CpuWater::touch (sf::Vector2f pos, float radius, float extremum)
+{
+    const std::size_t rowSize = 2 * static_cast<std::size_t>(_gridSize.x);
+    unsigned int first, last;
+    getTouchedRows(_gridSize, pos, radius, first, last);
+    for (unsigned int y = first ; y < last ; ++y)
+        touchRow(_buffers[_currentIndex].data() + y * rowSize, y, _gridSize, pos, radius, extremum);
+}
+
+void CpuWater::updateRow (const float* below,
+                          const float* row,
+                          const float* above,
+                          float* result,
+                          unsigned int width,
+                          float dt,
+                          float propagation,
+                          float friction,
+                          float elasticity)
+{
+    for (unsigned int x = 0 ; x < width ; ++x) {
+        unsigned int left = (x > 0) ? x - 1 : x;
+        unsigned int right = (x + 1 < width) ? x + 1 : x;
+
+        float pos = row[2*x];
+        float vel = row[2*x + 1];
+
+        /* Update velocity */
+        vel += -dt * elasticity * pos; //vertical spring
+
+        float sidesPos = row[2*right] + row[2*left] + above[2*x] + below[2*x];
+        float neighboursPos = 0.25f * sidesPos;
+
+        vel += dt * propagation * (neighboursPos - pos); //surface tension
+        vel *= friction; //attenuation
+
+        /* Update position */
+        pos += dt * vel;
+
+        result[2*x] = pos;
+        result[2*x + 1] = vel;
+    }
+}
+
+void CpuWater::touchRow (float* row,
+                         unsigned int y,
+                         sf::Vector2u gridSize,
+                         sf::Vector2f pos,
+                         float radius,
+                         float extremum)
+{
+    /* Same cosine bump as shaders/touch.frag, around the cells centers */
+    float width = static_cast<float>(gridSize.x);
+    float firstX = std::max(0.f, std::floor((pos.x - radius) * width - 0.5f));
+    float lastX = std::max(0.f, std::ceil((pos.x + radius) * width + 0.5f));
+    unsigned int first = static_cast<unsigned int>(std::min(firstX, width));
+    unsigned int last = static_cast<unsigned int>(std::min(lastX, width));
+
+    float cellY = (static_cast<float>(y) + 0.5f) / static_cast<float>(gridSize.y);
+    for (unsigned int x = first ; x < last ; ++x) {
+        float cellX = (static_cast<float>(x) + 0.5f) / static_cast<float>(gridSize.x);
+        float param = std::hypot(pos.x - cellX, pos.y - cellY) / radius;
+        if (param <= 1.f) {
+            float bump = (std::cos(param * 3.141592654f) + 1.f) / 2.f;
+            row[2*x] += 0.5f * POS_RANGE * extremum * bump;
+        }
+    }
+}
+
+void CpuWater::getTouchedRows (sf::Vector2u gridSize,
+                               sf::Vector2f pos,
+                               float radius,
+                               unsigned int& first,
+                               unsigned int& last)
+{
+    float height = static_cast<float>(gridSize.y);
+    float lowest = std::floor((pos.y - radius) * height - 0.5f);
+    float highest = std::ceil((pos.y + radius) * height + 0.5f);
+
+    first = static_cast<unsigned int>(std::max(0.f, std::min(lowest, height)));
+    last = static_cast<unsigned int>(std::max(0.f, std::min(highest, height)));
+}
@@ -0,0 +1,112 @@
+#include "Decoding.hpp"
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif // __SSE2__
+
+
+namespace
+{
+    /* Value stored in two channels, strong digit first */
+    inline float decodeValue (std::uint8_t strong, std::uint8_t weak, float range)
+    {
+        float value = static_cast<float>(256 * strong + weak) / 65535.f;
+        return (value - 0.5f) * range;
+    }
+
+    inline float decodeChannel (std::uint8_t channel)
+    {
+        return static_cast<float>(channel) / 255.f;
+    }
+}
+
+void decodeState (const std::uint8_t* pixels,
+                  std::size_t cellsCount,
+                  float* positions,
+                  float* velocities)
+{
+    std::size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i lowMask = _mm_set1_epi32(0x0000FFFF);
+    const __m128 posScale = _mm_set1_ps(POS_RANGE / 65535.f);
+    const __m128 velScale = _mm_set1_ps(VEL_RANGE / 65535.f);
+    const __m128 posOffset = _mm_set1_ps(-0.5f * POS_RANGE);
+    const __m128 velOffset = _mm_set1_ps(-0.5f * VEL_RANGE);
+
+    /* 4 cells per iteration */
+    for ( ; i + 4 <= cellsCount ; i += 4) {
+        __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 4*i));
+
+        /* Swap the bytes of the 16-bit words: R,G -> 256*R+G and B,A -> 256*B+A */
+        __m128i words = _mm_or_si128(_mm_slli_epi16(rgba, 8), _mm_srli_epi16(rgba, 8));
+
+        __m128i pos = _mm_and_si128(words, lowMask);
+        __m128i vel = _mm_srli_epi32(words, 16);
+
+        _mm_storeu_ps(positions + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(pos), posScale), posOffset));
+        _mm_storeu_ps(velocities + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(vel), velScale), velOffset));
+    }
+#endif // __SSE2__
+
+    for ( ; i < cellsCount ; ++i) {
+        const std::uint8_t* pixel = pixels + 4*i;
+        positions[i] = decodeValue(pixel[0], pixel[1], POS_RANGE);
+        velocities[i] = decodeValue(pixel[2], pixel[3], VEL_RANGE);
+    }
+}
+
+void decodeHeightmap (const std::uint8_t* pixels,
+                      std::size_t cellsCount,
+                      float* heights,
+                      float* normals)
+{
+    std::size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i byteMask = _mm_set1_epi32(0x000000FF);
+    const __m128 scale = _mm_set1_ps(1.f / 255.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 two = _mm_set1_ps(2.f);
+    const __m128 one = _mm_set1_ps(1.f);
+
+    /* 4 cells per iteration */
+    for ( ; i + 4 <= cellsCount ; i += 4) {
+        __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 4*i));
+
+        __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(rgba, 24)), scale);
+        _mm_storeu_ps(heights + i, _mm_sub_ps(a, half));
+
+        if (normals != nullptr) {
+            __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(rgba, byteMask)), scale);
+            __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(rgba, 8), byteMask)), scale);
+            __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(rgba, 16), byteMask)), scale);
+            r = _mm_sub_ps(_mm_mul_ps(r, two), one);
+            g = _mm_sub_ps(_mm_mul_ps(g, two), one);
+            b = _mm_sub_ps(_mm_mul_ps(b, two), one);
+
+            /* Interleave to xyz */
+            alignas(16) float x[4], y[4], z[4];
+            _mm_store_ps(x, r);
+            _mm_store_ps(y, g);
+            _mm_store_ps(z, b);
+            for (unsigned int k = 0 ; k < 4 ; ++k) {
+                normals[3*(i+k)+0] = x[k];
+                normals[3*(i+k)+1] = y[k];
+                normals[3*(i+k)+2] = z[k];
+            }
+        }
+    }
+#endif // __SSE2__
+
+    for ( ; i < cellsCount ; ++i) {
+        const std::uint8_t* pixel = pixels + 4*i;
+        heights[i] = decodeChannel(pixel[3]) - 0.5f;
+
+        if (normals != nullptr) {
+            normals[3*i+0] = 2.f * decodeChannel(pixel[0]) - 1.f;
+            normals[3*i+1] = 2.f * decodeChannel(pixel[1]) - 1.f;
+            normals[3*i+2] = 2.f * decodeChannel(pixel[2]) - 1.f;
+        }
+    }
+}
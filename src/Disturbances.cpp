@@ -0,0 +1,165 @@
+#include "Disturbances.hpp"
+
+#include "GLHelper.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+
+Disturbances::Disturbances ():
+            _shaderHandle (0),
+            _rainClamped (false)
+{
+    _rain.rate = 0.f;
+    _rain.minRadius = 0.005f;
+    _rain.maxRadius = 0.01f;
+    _rain.extremum = -0.2f;
+}
+
+void Disturbances::setRain (Rain const& rain)
+{
+    _rain = rain;
+    _rain.minRadius = std::max(0.0001f, std::min(rain.minRadius, rain.maxRadius));
+    _rain.maxRadius = std::max(_rain.minRadius, std::min(rain.maxRadius, 0.5f));
+}
+Disturbances::Rain const& Disturbances::getRain() const
+{
+    return _rain;
+}
+
+void Disturbances::addPointSource (PointSource const& source)
+{
+    if (_pointSources.size() >= MAX_POINT_SOURCES)
+        throw std::runtime_error("Disturbances: too many point sources");
+    if (source.path.empty())
+        throw std::runtime_error("Disturbances: empty point source path");
+
+    _pointSources.push_back(source);
+}
+std::vector<Disturbances::PointSource> const& Disturbances::getPointSources() const
+{
+    return _pointSources;
+}
+
+void Disturbances::addWaveMaker (WaveMaker const& waveMaker)
+{
+    if (_waveMakers.size() >= MAX_WAVE_MAKERS)
+        throw std::runtime_error("Disturbances: too many wave makers");
+
+    _waveMakers.push_back(waveMaker);
+}
+std::vector<Disturbances::WaveMaker> const& Disturbances::getWaveMakers() const
+{
+    return _waveMakers;
+}
+
+void Disturbances::clear ()
+{
+    _rain.rate = 0.f;
+    _pointSources.clear();
+    _waveMakers.clear();
+}
+
+bool Disturbances::isEmpty () const
+{
+    return _rain.rate <= 0.f && _pointSources.empty() && _waveMakers.empty();
+}
+
+void Disturbances::setUniforms (sf::Shader const& shader,
+                                unsigned long step,
+                                float elapsed,
+                                float time) const
+{
+    const float twoPi = 6.283185307f;
+
+    GLuint shaderHandle = getShaderHandle(shader, false);
+    if (shaderHandle != _shaderHandle) {
+        _uniformLocs.rain = getShaderUniformLoc(shaderHandle, "rain", false);
+        _uniformLocs.rainCells = getShaderUniformLoc(shaderHandle, "rainCells", false);
+        _uniformLocs.rainSeed = getShaderUniformLoc(shaderHandle, "rainSeed", false);
+        _uniformLocs.pointSourcesCount = getShaderUniformLoc(shaderHandle, "pointSourcesCount", false);
+        _uniformLocs.pointSources = getShaderUniformLoc(shaderHandle, "pointSources", false);
+        _uniformLocs.waveMakersCount = getShaderUniformLoc(shaderHandle, "waveMakersCount", false);
+        _uniformLocs.waveMakersSegments = getShaderUniformLoc(shaderHandle, "waveMakersSegments", false);
+        _uniformLocs.waveMakers = getShaderUniformLoc(shaderHandle, "waveMakers", false);
+        _shaderHandle = shaderHandle;
+    }
+
+    /* Rain cells as small as possible, while holding the biggest drops */
+    float rainCells = std::max(1.f, std::floor(0.5f / _rain.maxRadius));
+    float drops = std::max(0.f, _rain.rate) * time / (rainCells * rainCells); //per rain cell
+    if (drops > MAX_RAIN_DROPS) {
+        if (!_rainClamped) {
+            std::cerr << "Disturbances: rain clamped to " << MAX_RAIN_DROPS * rainCells * rainCells / time
+                      << " drops per second" << std::endl;
+            _rainClamped = true;
+        }
+        drops = MAX_RAIN_DROPS;
+    }
+    GLCHECK(glUniform4f(_uniformLocs.rain, drops, _rain.minRadius, _rain.maxRadius, _rain.extremum));
+    GLCHECK(glUniform2f(_uniformLocs.rainCells, rainCells, rainCells));
+    GLCHECK(glUniform1f(_uniformLocs.rainSeed, static_cast<float>(step % 16777216))); //exact as a float
+
+    /* Point sources: x, y, radius, extremum of this step */
+    std::array<float, 4*MAX_POINT_SOURCES> pointSources;
+    for (std::size_t i = 0 ; i < _pointSources.size() ; ++i) {
+        PointSource const& source = _pointSources[i];
+        sf::Vector2f position = getPathPosition(source.path, source.speed * elapsed);
+        pointSources[4*i + 0] = position.x;
+        pointSources[4*i + 1] = position.y;
+        pointSources[4*i + 2] = source.radius;
+        pointSources[4*i + 3] = source.amplitude * std::sin(twoPi * source.frequency * elapsed) * time;
+    }
+    GLCHECK(glUniform1i(_uniformLocs.pointSourcesCount, _pointSources.size()));
+    if (!_pointSources.empty()) {
+        GLCHECK(glUniform4fv(_uniformLocs.pointSources, _pointSources.size(), pointSources.data()));
+    }
+
+    /* Wave makers: the segment, then its width and the extremum of this step */
+    std::array<float, 4*MAX_WAVE_MAKERS> segments;
+    std::array<float, 2*MAX_WAVE_MAKERS> waveMakers;
+    for (std::size_t i = 0 ; i < _waveMakers.size() ; ++i) {
+        WaveMaker const& waveMaker = _waveMakers[i];
+        segments[4*i + 0] = waveMaker.from.x;
+        segments[4*i + 1] = waveMaker.from.y;
+        segments[4*i + 2] = waveMaker.to.x;
+        segments[4*i + 3] = waveMaker.to.y;
+        waveMakers[2*i + 0] = waveMaker.width;
+        waveMakers[2*i + 1] = waveMaker.amplitude * std::sin(twoPi * waveMaker.frequency * elapsed) * time;
+    }
+    GLCHECK(glUniform1i(_uniformLocs.waveMakersCount, _waveMakers.size()));
+    if (!_waveMakers.empty()) {
+        GLCHECK(glUniform4fv(_uniformLocs.waveMakersSegments, _waveMakers.size(), segments.data()));
+        GLCHECK(glUniform2fv(_uniformLocs.waveMakers, _waveMakers.size(), waveMakers.data()));
+    }
+}
+
+sf::Vector2f Disturbances::getPathPosition (std::vector<sf::Vector2f> const& path, float distance)
+{
+    if (path.size() == 1)
+        return path.front();
+
+    float length = 0.f;
+    for (std::size_t i = 0 ; i < path.size() ; ++i) {
+        sf::Vector2f segment = path[(i + 1) % path.size()] - path[i];
+        length += std::hypot(segment.x, segment.y);
+    }
+    if (length <= 0.f)
+        return path.front();
+
+    distance = std::fmod(distance, length);
+    if (distance < 0.f)
+        distance += length;
+
+    for (std::size_t i = 0 ; i < path.size() ; ++i) {
+        sf::Vector2f segment = path[(i + 1) % path.size()] - path[i];
+        float segmentLength = std::hypot(segment.x, segment.y);
+        if (distance <= segmentLength && segmentLength > 0.f)
+            return path[i] + segment * (distance / segmentLength);
+        distance -= segmentLength;
+    }
+    return path.front();
+}
@@ -0,0 +1,335 @@
+#include "FixedPointWater.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __AVX2__
+    #include <immintrin.h>
+#endif // __AVX2__
+
+
+namespace
+{
+    /* Weights of the 9-point stencil: (4*sides + corners + pos) / 6,
+     * with the sides and the corners averaged */
+    const std::int32_t SIDES_WEIGHT = 21845; //2/3
+    const std::int32_t OTHERS_WEIGHT = 5461; //1/6
+
+    inline std::int32_t saturate (std::int32_t x)
+    {
+        return std::min(std::max(x, -32768), 32767);
+    }
+
+    inline std::uint16_t average (std::uint16_t a, std::uint16_t b)
+    {
+        return static_cast<std::uint16_t>((a + b + 1) >> 1);
+    }
+
+    /* Product rounded to the nearest, as _mm256_mulhrs_epi16 */
+    inline std::int32_t multiply (std::int32_t x, std::int32_t mantissa)
+    {
+        return (x * mantissa + 16384) >> 15;
+    }
+
+    /* Exact if x can be shifted first, otherwise shifted after the product */
+    inline std::int32_t scale (std::int32_t x, FixedPointWater::Coefficient const& coefficient)
+    {
+        std::int32_t shifted = x * (1 << coefficient.shift);
+        if (shifted == saturate(shifted))
+            return multiply(shifted, coefficient.mantissa);
+        return saturate(multiply(x, coefficient.mantissa) * (1 << coefficient.shift));
+    }
+
+    inline std::int32_t toSigned (std::uint16_t value)
+    {
+        return static_cast<std::int32_t>(value) - 32768;
+    }
+
+    inline std::uint16_t toUnsigned (std::int32_t value)
+    {
+        return static_cast<std::uint16_t>(value + 32768);
+    }
+
+    /* Updates one cell from the averages of its neighbours, as shaders/update.frag */
+    inline void updateCell (std::uint16_t& position,
+                            std::uint16_t& velocity,
+                            std::uint16_t sides,
+                            std::uint16_t corners,
+                            bool ninePoint,
+                            FixedPointWater::Coefficients const& coefficients)
+    {
+        std::int32_t pos = toSigned(position);
+        std::int32_t vel = toSigned(velocity);
+
+        std::int32_t neighboursPos = toSigned(sides);
+        if (ninePoint) {
+            neighboursPos = saturate(multiply(neighboursPos, SIDES_WEIGHT) + multiply(toSigned(corners), OTHERS_WEIGHT));
+            neighboursPos = saturate(neighboursPos + multiply(pos, OTHERS_WEIGHT));
+        }
+
+        vel = saturate(vel - scale(pos, coefficients.elasticity)); //vertical spring
+        vel = saturate(vel + scale(saturate(neighboursPos - pos), coefficients.propagation)); //surface tension
+        vel = scale(vel, coefficients.friction); //attenuation
+
+        pos = saturate(pos + scale(vel, coefficients.dt));
+
+        position = toUnsigned(pos);
+        velocity = toUnsigned(vel);
+    }
+
+#ifdef __AVX2__
+    inline __m256i scale (__m256i x, FixedPointWater::Coefficient const& coefficient)
+    {
+        const __m256i mantissa = _mm256_set1_epi16(static_cast<std::int16_t>(coefficient.mantissa));
+        if (coefficient.shift == 0)
+            return _mm256_mulhrs_epi16(x, mantissa);
+
+        /* Both ways, then the exact one where the shift didn't overflow */
+        __m256i shifted = _mm256_slli_epi16(x, coefficient.shift);
+        __m256i fits = _mm256_cmpeq_epi16(_mm256_srai_epi16(shifted, coefficient.shift), x);
+        __m256i exact = _mm256_mulhrs_epi16(shifted, mantissa);
+
+        __m256i approximate = _mm256_mulhrs_epi16(x, mantissa);
+        for (std::int32_t i = 0 ; i < coefficient.shift ; ++i)
+            approximate = _mm256_adds_epi16(approximate, approximate);
+
+        return _mm256_blendv_epi8(approximate, exact, fits);
+    }
+
+    inline __m256i load (const std::uint16_t* values)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+    }
+#endif // __AVX2__
+}
+
+FixedPointWater::FixedPointWater (sf::Vector2u gridSize,
+                                  float propagation,
+                                  float friction,
+                                  float elasticity):
+            _gridSize (gridSize),
+            _friction (friction),
+            _propagation (propagation),
+            _elasticity (elasticity),
+            _stencil (Water::Stencil::FivePoint),
+            _boundary (Water::Boundary::Clamp),
+            _currentIndex (0),
+            _step (0),
+            _restRow (gridSize.x, REST)
+{
+    std::size_t cellsCount = static_cast<std::size_t>(_gridSize.x) * _gridSize.y;
+    for (unsigned int i = 0 ; i < 2 ; ++i) {
+        _positions[i].resize(cellsCount);
+        _velocities[i].resize(cellsCount);
+    }
+
+    init();
+}
+
+sf::Vector2u FixedPointWater::getGridSize() const
+{
+    return _gridSize;
+}
+
+float FixedPointWater::getPropagation() const
+{
+    return _propagation;
+}
+
+float FixedPointWater::getFriction() const
+{
+    return _friction;
+}
+
+float FixedPointWater::getElasticity() const
+{
+    return _elasticity;
+}
+
+void FixedPointWater::setStencil (Water::Stencil stencil)
+{
+    _stencil = stencil;
+}
+Water::Stencil FixedPointWater::getStencil() const
+{
+    return _stencil;
+}
+
+void FixedPointWater::setBoundary (Water::Boundary boundary)
+{
+    _boundary = boundary;
+}
+Water::Boundary FixedPointWater::getBoundary() const
+{
+    return _boundary;
+}
+
+void FixedPointWater::getState (std::vector<std::uint8_t>& pixels) const
+{
+    const std::vector<std::uint16_t>& positions = _positions[_currentIndex];
+    const std::vector<std::uint16_t>& velocities = _velocities[_currentIndex];
+
+    pixels.resize(4 * positions.size());
+    for (std::size_t i = 0 ; i < positions.size() ; ++i) {
+        pixels[4*i + 0] = static_cast<std::uint8_t>(positions[i] >> 8);
+        pixels[4*i + 1] = static_cast<std::uint8_t>(positions[i] & 255);
+        pixels[4*i + 2] = static_cast<std::uint8_t>(velocities[i] >> 8);
+        pixels[4*i + 3] = static_cast<std::uint8_t>(velocities[i] & 255);
+    }
+}
+
+void FixedPointWater::setState (const std::uint8_t* pixels)
+{
+    std::vector<std::uint16_t>& positions = _positions[_currentIndex];
+    std::vector<std::uint16_t>& velocities = _velocities[_currentIndex];
+
+    for (std::size_t i = 0 ; i < positions.size() ; ++i) {
+        positions[i] = static_cast<std::uint16_t>(256 * pixels[4*i + 0] + pixels[4*i + 1]);
+        velocities[i] = static_cast<std::uint16_t>(256 * pixels[4*i + 2] + pixels[4*i + 3]);
+    }
+}
+
+unsigned long FixedPointWater::getStep () const
+{
+    return _step;
+}
+
+void FixedPointWater::update (float time)
+{
+    float dt = time * 10.f;
+    Coefficients coefficients = computeCoefficients(dt, _propagation, _friction, _elasticity);
+
+    for (unsigned int y = 0 ; y < _gridSize.y ; ++y)
+        updateRow(y, coefficients);
+
+    _currentIndex = (_currentIndex + 1) % 2;
+    ++_step;
+}
+
+void FixedPointWater::init ()
+{
+    for (unsigned int i = 0 ; i < 2 ; ++i) {
+        std::fill(_positions[i].begin(), _positions[i].end(), REST);
+        std::fill(_velocities[i].begin(), _velocities[i].end(), REST);
+    }
+}
+
+FixedPointWater::Coefficients FixedPointWater::computeCoefficients (float dt,
+                                                                    float propagation,
+                                                                    float friction,
+                                                                    float elasticity)
+{
+    Coefficients coefficients;
+    coefficients.elasticity = toCoefficient(dt * elasticity);
+    coefficients.propagation = toCoefficient(dt * propagation);
+    coefficients.friction = toCoefficient(friction);
+    coefficients.dt = toCoefficient(dt);
+    return coefficients;
+}
+
+FixedPointWater::Coefficient FixedPointWater::toCoefficient (float value)
+{
+    /* The mantissa keeps as many bits as possible: the value is only
+     * shifted if it is greater than 1 (which is rounded to 32767/32768) */
+    Coefficient coefficient;
+    coefficient.shift = 0;
+    value = std::max(value, 0.f);
+    while (value > 1.f && coefficient.shift < 7) {
+        value /= 2.f;
+        ++coefficient.shift;
+    }
+    coefficient.mantissa = std::min(32767l, std::lround(value * 32768.f));
+    return coefficient;
+}
+
+const std::uint16_t* FixedPointWater::getPositionsRow (int y) const
+{
+    int height = static_cast<int>(_gridSize.y);
+    if (_boundary == Water::Boundary::Periodic)
+        y = (y + height) % height;
+    else if (_boundary == Water::Boundary::Fixed && (y < 0 || y >= height))
+        return _restRow.data();
+    else
+        y = std::min(std::max(y, 0), height - 1);
+
+    return _positions[_currentIndex].data() + static_cast<std::size_t>(_gridSize.x) * y;
+}
+
+std::uint16_t FixedPointWater::getPosition (const std::uint16_t* row, int x) const
+{
+    int width = static_cast<int>(_gridSize.x);
+    if (_boundary == Water::Boundary::Periodic)
+        x = (x + width) % width;
+    else if (_boundary == Water::Boundary::Fixed && (x < 0 || x >= width))
+        return REST;
+    else
+        x = std::min(std::max(x, 0), width - 1);
+
+    return row[x];
+}
+
+void FixedPointWater::updateRow (unsigned int y, Coefficients const& coefficients)
+{
+    const unsigned int nextIndex = (_currentIndex + 1) % 2;
+    const std::size_t offset = static_cast<std::size_t>(_gridSize.x) * y;
+    const bool ninePoint = (_stencil == Water::Stencil::NinePoint);
+
+    const std::uint16_t* row = getPositionsRow(y);
+    const std::uint16_t* below = getPositionsRow(static_cast<int>(y) - 1);
+    const std::uint16_t* above = getPositionsRow(static_cast<int>(y) + 1);
+    const std::uint16_t* velocities = _velocities[_currentIndex].data() + offset;
+    std::uint16_t* nextPositions = _positions[nextIndex].data() + offset;
+    std::uint16_t* nextVelocities = _velocities[nextIndex].data() + offset;
+
+    auto updateScalar = [&] (int x) {
+        nextPositions[x] = row[x];
+        nextVelocities[x] = velocities[x];
+        updateCell(nextPositions[x], nextVelocities[x],
+                   average(average(getPosition(row, x + 1), getPosition(row, x - 1)),
+                           average(above[x], below[x])),
+                   average(average(getPosition(above, x + 1), getPosition(below, x - 1)),
+                           average(getPosition(below, x + 1), getPosition(above, x - 1))),
+                   ninePoint, coefficients);
+    };
+
+    /* The cells of the borders take the scalar path */
+    int x = 0;
+    if (_gridSize.x > 0)
+        updateScalar(x++);
+
+#ifdef __AVX2__
+    const __m256i signBit = _mm256_set1_epi16(-32768);
+    const __m256i sidesWeight = _mm256_set1_epi16(static_cast<std::int16_t>(SIDES_WEIGHT));
+    const __m256i othersWeight = _mm256_set1_epi16(static_cast<std::int16_t>(OTHERS_WEIGHT));
+
+    /* 16 cells per iteration, the unsigned values made signed by flipping their sign bit */
+    for ( ; x + 17 <= static_cast<int>(_gridSize.x) ; x += 16) {
+        __m256i sides = _mm256_avg_epu16(_mm256_avg_epu16(load(row + x + 1), load(row + x - 1)),
+                                         _mm256_avg_epu16(load(above + x), load(below + x)));
+        __m256i pos = _mm256_xor_si256(load(row + x), signBit);
+        __m256i vel = _mm256_xor_si256(load(velocities + x), signBit);
+
+        __m256i neighboursPos = _mm256_xor_si256(sides, signBit);
+        if (ninePoint) {
+            __m256i corners = _mm256_avg_epu16(_mm256_avg_epu16(load(above + x + 1), load(below + x - 1)),
+                                               _mm256_avg_epu16(load(below + x + 1), load(above + x - 1)));
+            corners = _mm256_xor_si256(corners, signBit);
+            neighboursPos = _mm256_adds_epi16(_mm256_mulhrs_epi16(neighboursPos, sidesWeight),
+                                              _mm256_mulhrs_epi16(corners, othersWeight));
+            neighboursPos = _mm256_adds_epi16(neighboursPos, _mm256_mulhrs_epi16(pos, othersWeight));
+        }
+
+        vel = _mm256_subs_epi16(vel, scale(pos, coefficients.elasticity));
+        vel = _mm256_adds_epi16(vel, scale(_mm256_subs_epi16(neighboursPos, pos), coefficients.propagation));
+        vel = scale(vel, coefficients.friction);
+
+        pos = _mm256_adds_epi16(pos, scale(vel, coefficients.dt));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(nextPositions + x), _mm256_xor_si256(pos, signBit));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(nextVelocities + x), _mm256_xor_si256(vel, signBit));
+    }
+#endif // __AVX2__
+
+    for ( ; x < static_cast<int>(_gridSize.x) ; ++x)
+        updateScalar(x);
+}
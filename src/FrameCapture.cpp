@@ -0,0 +1,244 @@
+#include "FrameCapture.hpp"
+
+#include <SFML/Graphics/Image.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+
+FrameCapture::FrameCapture (std::string const& path,
+                            Format format,
+                            unsigned int threadsCount,
+                            unsigned int framerate):
+            _path (path),
+            _format (format),
+            _framerate (std::max(1u, framerate)),
+            _maxQueuedFrames (2 * std::max(1u, threadsCount)),
+            _framesCount (0),
+            _queuedCount (0),
+            _stop (false),
+            _capturedCount (0),
+            _droppedCount (0),
+            _streamSize (0, 0),
+            _nextWrite (0)
+{
+    if (_format == Format::Y4M) {
+        _file.open(_path + ".y4m", std::ios::binary | std::ios::trunc);
+        if (!_file.is_open())
+            throw std::runtime_error("FrameCapture: unable to create " + _path + ".y4m.");
+    }
+
+    for (unsigned int i = 0 ; i < std::max(1u, threadsCount) ; ++i)
+        _threads.emplace_back(&FrameCapture::run, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    for (std::thread& thread : _threads)
+        thread.join();
+
+    if (_readback)
+        _droppedCount += _readback->getPendingCount();
+}
+
+void FrameCapture::capture (sf::Vector2u const& size)
+{
+    if (size.x == 0 || size.y == 0)
+        return;
+
+    /* Created lazily: it needs an OpenGL context.
+     * On resize, the copies in flight are discarded. */
+    if (!_readback || _readback->getSize() != size) {
+        if (_readback)
+            _droppedCount += _readback->getPendingCount();
+        _readback.reset(new AsyncReadback(size, RING_SIZE));
+    }
+
+    ++_framesCount;
+    if (!_readback->requestFramebuffer(_framesCount))
+        ++_droppedCount;
+
+    unsigned long frameIndex = 0;
+    while (_readback->retrieve(_readbackPixels, frameIndex)) {
+        queue(std::move(_readbackPixels), size);
+        _readbackPixels.clear();
+    }
+}
+
+unsigned long FrameCapture::getCapturedCount() const
+{
+    return _capturedCount;
+}
+
+unsigned long FrameCapture::getDroppedCount() const
+{
+    return _droppedCount;
+}
+
+void FrameCapture::queue (std::vector<std::uint8_t>&& pixels, sf::Vector2u const& size)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_queue.size() >= _maxQueuedFrames) {
+            ++_droppedCount;
+            return;
+        }
+
+        /* The Y4M stream keeps the size of its first frame */
+        if (_format == Format::Y4M) {
+            std::lock_guard<std::mutex> writeLock(_writeMutex);
+            if (_streamSize == sf::Vector2u(0, 0)) {
+                _streamSize = size;
+
+                char header[128];
+                int headerSize = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n",
+                                               _streamSize.x, _streamSize.y, _framerate);
+                _file.write(header, headerSize);
+            }
+
+            if (size != _streamSize) {
+                ++_droppedCount;
+                return;
+            }
+        }
+
+        Frame frame;
+        frame.pixels = std::move(pixels);
+        frame.size = size;
+        frame.index = _queuedCount++;
+        _queue.push_back(std::move(frame));
+    }
+    _condition.notify_one();
+}
+
+void FrameCapture::run()
+{
+    Frame frame;
+    std::vector<std::uint8_t> yuv;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]{ return _stop || !_queue.empty(); });
+
+            /* Queued frames are still written when stopping */
+            if (_queue.empty())
+                return;
+
+            frame = std::move(_queue.front());
+            _queue.pop_front();
+        }
+
+        if (_format == Format::PNG) {
+            writePNG(frame);
+        } else {
+            convertToYUV(frame, yuv);
+
+            std::lock_guard<std::mutex> writeLock(_writeMutex);
+            writeY4M(frame.index, std::move(yuv));
+            yuv.clear();
+        }
+    }
+}
+
+void FrameCapture::writePNG (Frame const& frame)
+{
+    /* The back buffer is bottom row first and its alpha is meaningless */
+    const unsigned int rowSize = 4 * frame.size.x;
+    std::vector<std::uint8_t> flipped(frame.pixels.size());
+    for (unsigned int iY = 0 ; iY < frame.size.y ; ++iY) {
+        const std::uint8_t* source = frame.pixels.data() + (frame.size.y - 1 - iY) * rowSize;
+        std::uint8_t* destination = flipped.data() + iY * rowSize;
+        for (unsigned int i = 0 ; i < rowSize ; i += 4) {
+            destination[i+0] = source[i+0];
+            destination[i+1] = source[i+1];
+            destination[i+2] = source[i+2];
+            destination[i+3] = 255;
+        }
+    }
+
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%06lu.png", frame.index);
+
+    sf::Image image;
+    image.create(frame.size.x, frame.size.y, flipped.data());
+    if (image.saveToFile(_path + suffix))
+        ++_capturedCount;
+    else
+        ++_droppedCount;
+}
+
+void FrameCapture::convertToYUV (Frame const& frame, std::vector<std::uint8_t>& yuv)
+{
+    const unsigned int width = frame.size.x;
+    const unsigned int height = frame.size.y;
+    const unsigned int chromaWidth = (width + 1) / 2;
+    const unsigned int chromaHeight = (height + 1) / 2;
+
+    yuv.resize(width * height + 2 * chromaWidth * chromaHeight);
+    std::uint8_t* planeY = yuv.data();
+    std::uint8_t* planeU = planeY + width * height;
+    std::uint8_t* planeV = planeU + chromaWidth * chromaHeight;
+
+    /* The back buffer is bottom row first */
+    auto row = [&](unsigned int iY) -> const std::uint8_t* {
+        return frame.pixels.data() + 4 * width * (height - 1 - std::min(iY, height - 1));
+    };
+
+    /* Fixed point coefficients, scaled by 2^16 */
+    for (unsigned int iY = 0 ; iY < height ; ++iY) {
+        const std::uint8_t* source = row(iY);
+        std::uint8_t* destination = planeY + iY * width;
+        for (unsigned int iX = 0 ; iX < width ; ++iX) {
+            int r = source[4*iX+0], g = source[4*iX+1], b = source[4*iX+2];
+            destination[iX] = (19595*r + 38470*g + 7471*b + 32768) >> 16;
+        }
+    }
+
+    /* Chroma from the average of each 2x2 block, clamped at odd borders */
+    for (unsigned int iY = 0 ; iY < chromaHeight ; ++iY) {
+        const std::uint8_t* top = row(2*iY);
+        const std::uint8_t* bottom = row(2*iY + 1);
+        for (unsigned int iX = 0 ; iX < chromaWidth ; ++iX) {
+            unsigned int left = 4 * (2*iX);
+            unsigned int right = 4 * std::min(2*iX + 1, width - 1);
+
+            int r = top[left+0] + top[right+0] + bottom[left+0] + bottom[right+0];
+            int g = top[left+1] + top[right+1] + bottom[left+1] + bottom[right+1];
+            int b = top[left+2] + top[right+2] + bottom[left+2] + bottom[right+2];
+
+            /* Sums of 4 samples: shift by 2 more bits */
+            int u = (-11059*r - 21709*g + 32768*b + (128 << 18) + (1 << 17)) >> 18;
+            int v = (32768*r - 27439*g - 5329*b + (128 << 18) + (1 << 17)) >> 18;
+            planeU[iY * chromaWidth + iX] = std::min(255, std::max(0, u));
+            planeV[iY * chromaWidth + iX] = std::min(255, std::max(0, v));
+        }
+    }
+}
+
+void FrameCapture::writeY4M (unsigned long index, std::vector<std::uint8_t>&& yuv)
+{
+    _pendingWrites[index] = std::move(yuv);
+
+    /* Frames encoded out of order wait for their predecessors */
+    auto next = _pendingWrites.find(_nextWrite);
+    while (next != _pendingWrites.end()) {
+        static const char FRAME_HEADER[] = "FRAME\n";
+        _file.write(FRAME_HEADER, sizeof(FRAME_HEADER) - 1);
+        _file.write(reinterpret_cast<const char*>(next->second.data()), next->second.size());
+
+        if (_file)
+            ++_capturedCount;
+        else
+            ++_droppedCount;
+
+        _pendingWrites.erase(next);
+        ++_nextWrite;
+        next = _pendingWrites.find(_nextWrite);
+    }
+}
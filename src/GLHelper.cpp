@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <string>
 #include <iostream>
+#include <algorithm>
 
 #include <SFML/OpenGL.hpp>
 
@@ -106,6 +107,56 @@ GLuint getShaderAttributeLoc (GLuint shaderHandle, std::string const& name, bool
     return attributeID;
 }
 
+void setFloatStorage (sf::Texture const& texture, GLint internalFormat, GLenum format, bool mipmaps)
+{
+    GLint previousTexture = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, texture.getNativeHandle()));
+    GLCHECK(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, texture.getSize().x, texture.getSize().y, 0, format, GL_FLOAT, nullptr));
+    if (mipmaps) {
+        GLCHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST));
+        GLCHECK(glGenerateMipmap(GL_TEXTURE_2D));
+    }
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+}
+
+void generateMipmaps (sf::Texture const& texture)
+{
+    GLint previousTexture = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, texture.getNativeHandle()));
+    GLCHECK(glGenerateMipmap(GL_TEXTURE_2D));
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+}
+
+unsigned int getTopMipmapLevel (sf::Vector2u const& size)
+{
+    unsigned int level = 0;
+    unsigned int maxSize = std::max(size.x, size.y);
+    while (maxSize > 1) {
+        maxSize /= 2;
+        ++level;
+    }
+    return level;
+}
+
+bool getGpuMemoryUsage (GLuint64& usedBytes)
+{
+    if (!GLEW_NVX_gpu_memory_info)
+        return false;
+
+    /* In KB */
+    GLint total = 0, available = 0;
+    GLCHECK(glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total));
+    GLCHECK(glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available));
+    usedBytes = 1024 * static_cast<GLuint64>(std::max(0, total - available));
+    return true;
+}
+
 void computeCube (std::vector<glm::vec3>& vertices,
                   std::vector<glm::vec3>& normals)
 {
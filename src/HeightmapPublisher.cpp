@@ -0,0 +1,141 @@
+#include "HeightmapPublisher.hpp"
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+HeightmapPublisher::HeightmapPublisher (sf::Vector2u size,
+                                        std::string const& name,
+                                        unsigned int slotsCount,
+                                        unsigned int period):
+            _size (size),
+            _name (name),
+            _period (std::max(1u, period)),
+            _hasRequested (false),
+            _lastRequestedStep (0),
+            _mapping (nullptr),
+            _mappingSize (0),
+            _header (nullptr),
+            _frame (0),
+            _droppedCount (0)
+{
+    slotsCount = std::max(2u, slotsCount);
+    std::uint64_t slotSize = getSharedHeightmapSlotSize(_size.x, _size.y);
+    _mappingSize = SHARED_HEIGHTMAP_SLOTS_OFFSET + slotsCount * slotSize;
+
+    /* Subscribers still mapping a previous object keep it until they reopen */
+    shm_unlink(_name.c_str());
+    int fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        throw std::runtime_error("HeightmapPublisher: unable to create " + _name + ".");
+
+    if (ftruncate(fd, _mappingSize) != 0) {
+        close(fd);
+        shm_unlink(_name.c_str());
+        throw std::runtime_error("HeightmapPublisher: unable to resize " + _name + ".");
+    }
+
+    _mapping = mmap(nullptr, _mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (_mapping == MAP_FAILED) {
+        shm_unlink(_name.c_str());
+        throw std::runtime_error("HeightmapPublisher: unable to map " + _name + ".");
+    }
+
+    /* The object is zero-filled: every sequence is even, and no frame is published */
+    _header = static_cast<SharedHeightmapHeader*>(_mapping);
+    _header->version = SHARED_HEIGHTMAP_VERSION;
+    _header->slotsCount = slotsCount;
+    _header->slotSize = slotSize;
+    _header->latest.store(0, std::memory_order_relaxed);
+    for (unsigned int i = 0 ; i < slotsCount ; ++i) {
+        SharedHeightmapSlot* slot = getSlot(i);
+        slot->width = _size.x;
+        slot->height = _size.y;
+        slot->format = SharedHeightmapFormat::RGBA8;
+    }
+
+    /* Written last: subscribers check it before anything else */
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(_header->magic, SHARED_HEIGHTMAP_MAGIC, sizeof(_header->magic));
+}
+
+HeightmapPublisher::~HeightmapPublisher()
+{
+    munmap(_mapping, _mappingSize);
+    shm_unlink(_name.c_str());
+}
+
+std::string const& HeightmapPublisher::getName() const
+{
+    return _name;
+}
+
+void HeightmapPublisher::update (Water const& water)
+{
+    update(water.getHeightmap(), water.getStep());
+}
+
+void HeightmapPublisher::update (sf::Texture const& texture, unsigned long step)
+{
+    /* Created lazily: it needs an OpenGL context */
+    if (!_readback)
+        _readback.reset(new AsyncReadback(_size));
+
+    /* Same rule as Recorder: several steps may pass between two calls */
+    bool isDue = !_hasRequested || step >= _lastRequestedStep + _period || step < _lastRequestedStep;
+    if (isDue) {
+        _hasRequested = true;
+        _lastRequestedStep = step;
+        if (!_readback->request(texture, step))
+            ++_droppedCount;
+    }
+
+    unsigned long readStep = 0;
+    while (_readback->retrieve(_readbackPixels, readStep)) {
+        publish(_readbackPixels.data(), readStep);
+    }
+}
+
+void HeightmapPublisher::publish (const std::uint8_t* pixels, unsigned long step)
+{
+    PROFILE_ZONE("HeightmapPublisher::publish");
+    ++_frame;
+    SharedHeightmapSlot* slot = getSlot((_frame - 1) % _header->slotsCount);
+
+    /* Seqlock: odd while writing, the release fence keeps the writes after it */
+    std::uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frame = _frame;
+    slot->step = step;
+    std::memcpy(reinterpret_cast<std::uint8_t*>(slot + 1), pixels, 4u * _size.x * _size.y);
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    _header->latest.store(_frame, std::memory_order_release);
+}
+
+unsigned long HeightmapPublisher::getPublishedCount() const
+{
+    return _frame;
+}
+
+unsigned long HeightmapPublisher::getDroppedCount() const
+{
+    return _droppedCount;
+}
+
+SharedHeightmapSlot* HeightmapPublisher::getSlot (unsigned int index)
+{
+    std::uint8_t* slots = static_cast<std::uint8_t*>(_mapping) + SHARED_HEIGHTMAP_SLOTS_OFFSET;
+    return reinterpret_cast<SharedHeightmapSlot*>(slots + index * _header->slotSize);
+}
@@ -0,0 +1,119 @@
+#include "HeightmapSubscriber.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+HeightmapSubscriber::HeightmapSubscriber (std::string const& name):
+            _name (name),
+            _mapping (nullptr),
+            _mappingSize (0),
+            _header (nullptr),
+            _slotsCount (0),
+            _slotSize (0)
+{
+    int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::runtime_error("HeightmapSubscriber: unable to open " + _name + ".");
+
+    struct stat objectStat;
+    if (fstat(fd, &objectStat) != 0 || objectStat.st_size < static_cast<off_t>(SHARED_HEIGHTMAP_SLOTS_OFFSET)) {
+        close(fd);
+        throw std::runtime_error("HeightmapSubscriber: invalid object " + _name + ".");
+    }
+    _mappingSize = objectStat.st_size;
+
+    void* mapping = mmap(nullptr, _mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("HeightmapSubscriber: unable to map " + _name + ".");
+    _mapping = mapping;
+    _header = static_cast<const SharedHeightmapHeader*>(_mapping);
+
+    /* The magic is written last by the publisher */
+    bool isValid = std::memcmp(_header->magic, SHARED_HEIGHTMAP_MAGIC, sizeof(_header->magic)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    _slotsCount = _header->slotsCount;
+    _slotSize = _header->slotSize;
+    isValid = isValid && _header->version == SHARED_HEIGHTMAP_VERSION && _slotsCount > 0 &&
+              _slotSize >= sizeof(SharedHeightmapSlot) &&
+              _slotSize <= (_mappingSize - SHARED_HEIGHTMAP_SLOTS_OFFSET) / _slotsCount; //no overflow
+    if (!isValid) {
+        munmap(mapping, _mappingSize);
+        throw std::runtime_error("HeightmapSubscriber: " + _name + " is not a heightmap ring of this version.");
+    }
+}
+
+HeightmapSubscriber::~HeightmapSubscriber()
+{
+    munmap(const_cast<void*>(_mapping), _mappingSize);
+}
+
+std::uint64_t HeightmapSubscriber::getLatestFrame() const
+{
+    return _header->latest.load(std::memory_order_acquire);
+}
+
+bool HeightmapSubscriber::acquire (Frame& frame) const
+{
+    std::uint64_t latest = getLatestFrame();
+    if (latest == 0)
+        return false;
+
+    const SharedHeightmapSlot* slot = getSlot((latest - 1) % _slotsCount);
+    frame.slot = slot;
+    frame.sequence = slot->sequence.load(std::memory_order_acquire);
+    if (frame.sequence % 2 != 0)
+        return false;
+
+    frame.frame = slot->frame;
+    frame.step = slot->step;
+    frame.width = slot->width;
+    frame.height = slot->height;
+    frame.format = slot->format;
+    frame.pixels = reinterpret_cast<const std::uint8_t*>(slot + 1);
+
+    /* The pixels must not go past the slot, whatever the publisher wrote */
+    std::uint64_t pixelsCapacity = (_slotSize - sizeof(SharedHeightmapSlot)) / 4;
+    if (frame.height != 0 && frame.width > pixelsCapacity / frame.height)
+        return false;
+
+    /* The metadata must be consistent from the start */
+    return isValid(frame);
+}
+
+bool HeightmapSubscriber::isValid (Frame const& frame) const
+{
+    /* Keeps the reads of the pixels before the reload of the sequence */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return frame.slot->sequence.load(std::memory_order_relaxed) == frame.sequence;
+}
+
+bool HeightmapSubscriber::copy (std::vector<std::uint8_t>& pixels, Frame& frame, unsigned int triesCount) const
+{
+    for (unsigned int i = 0 ; i < triesCount ; ++i) {
+        if (!acquire(frame)) {
+            if (getLatestFrame() == 0)
+                return false;
+            continue;
+        }
+
+        pixels.resize(4u * frame.width * frame.height);
+        std::memcpy(pixels.data(), frame.pixels, pixels.size());
+        if (isValid(frame))
+            return true;
+    }
+    return false;
+}
+
+const SharedHeightmapSlot* HeightmapSubscriber::getSlot (unsigned int index) const
+{
+    const std::uint8_t* slots = static_cast<const std::uint8_t*>(_mapping) + SHARED_HEIGHTMAP_SLOTS_OFFSET;
+    return reinterpret_cast<const SharedHeightmapSlot*>(slots + index * _slotSize);
+}
@@ -0,0 +1,225 @@
+#include "InputJournal.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace
+{
+    /* Hexadecimal notation: exact round trip */
+    std::string floatToString (float value)
+    {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%a", static_cast<double>(value));
+        return buffer;
+    }
+
+    float readFloat (std::istringstream& line)
+    {
+        std::string token;
+        if (!(line >> token))
+            throw std::runtime_error("InputJournal: missing value");
+
+        char* end = nullptr;
+        float value = std::strtof(token.c_str(), &end);
+        if (end == token.c_str() || *end != '\0')
+            throw std::runtime_error("InputJournal: invalid value " + token);
+        return value;
+    }
+}
+
+InputJournal::InputJournal():
+            _version (INPUT_JOURNAL_VERSION),
+            _stepsCount (0)
+{
+    _settings.gridSize = sf::Vector2u(512, 512);
+    _settings.propagation = 20.f;
+    _settings.friction = 0.99f;
+    _settings.elasticity = 0.4f;
+    _settings.timestep = 1.f / 60.f;
+}
+
+void InputJournal::setSettings (Settings const& settings)
+{
+    _settings = settings;
+}
+InputJournal::Settings const& InputJournal::getSettings() const
+{
+    return _settings;
+}
+
+unsigned int InputJournal::getVersion() const
+{
+    return _version;
+}
+
+void InputJournal::setStepsCount (unsigned long stepsCount)
+{
+    _stepsCount = stepsCount;
+}
+unsigned long InputJournal::getStepsCount() const
+{
+    return _stepsCount;
+}
+
+void InputJournal::recordTouch (unsigned long step, sf::Vector2f pos, float radius, float extremum)
+{
+    Event event;
+    event.type = Event::Type::Touch;
+    event.step = step;
+    event.values[0] = pos.x;
+    event.values[1] = pos.y;
+    event.values[2] = radius;
+    event.values[3] = extremum;
+    _events.push_back(event);
+}
+
+void InputJournal::recordInit (unsigned long step)
+{
+    Event event;
+    event.type = Event::Type::Init;
+    event.step = step;
+    event.values[0] = event.values[1] = event.values[2] = event.values[3] = 0.f;
+    _events.push_back(event);
+}
+
+void InputJournal::recordCamera (unsigned long step, float distance, float latitude, float longitude)
+{
+    Event event;
+    event.type = Event::Type::Camera;
+    event.step = step;
+    event.values[0] = distance;
+    event.values[1] = latitude;
+    event.values[2] = longitude;
+    event.values[3] = 0.f;
+    _events.push_back(event);
+}
+
+void InputJournal::recordScroll (unsigned long step, sf::Vector2i offset)
+{
+    Event event;
+    event.type = Event::Type::Scroll;
+    event.step = step;
+    event.values[0] = static_cast<float>(offset.x);
+    event.values[1] = static_cast<float>(offset.y);
+    event.values[2] = event.values[3] = 0.f;
+    _events.push_back(event);
+}
+
+std::vector<InputJournal::Event> const& InputJournal::getEvents() const
+{
+    return _events;
+}
+
+void InputJournal::save (std::string const& filePath) const
+{
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("InputJournal: unable to open " + filePath + ".");
+
+    file << "journal " << _version << "\n";
+    file << "grid " << _settings.gridSize.x << " " << _settings.gridSize.y << "\n";
+    file << "parameters " << floatToString(_settings.propagation) << " "
+                          << floatToString(_settings.friction) << " "
+                          << floatToString(_settings.elasticity) << "\n";
+    file << "timestep " << floatToString(_settings.timestep) << "\n";
+    file << "steps " << _stepsCount << "\n";
+
+    for (Event const& event : _events) {
+        switch (event.type) {
+            case Event::Type::Touch:
+                file << event.step << " touch";
+                for (unsigned int i = 0 ; i < 4 ; ++i)
+                    file << " " << floatToString(event.values[i]);
+                break;
+            case Event::Type::Init:
+                file << event.step << " init";
+                break;
+            case Event::Type::Camera:
+                file << event.step << " camera";
+                for (unsigned int i = 0 ; i < 3 ; ++i)
+                    file << " " << floatToString(event.values[i]);
+                break;
+            case Event::Type::Scroll:
+                file << event.step << " scroll " << static_cast<int>(event.values[0])
+                     << " " << static_cast<int>(event.values[1]);
+                break;
+        }
+        file << "\n";
+    }
+
+    if (!file)
+        throw std::runtime_error("InputJournal: unable to write " + filePath + ".");
+}
+
+void InputJournal::load (std::string const& filePath)
+{
+    std::ifstream file(filePath);
+    if (!file.is_open())
+        throw std::runtime_error("InputJournal: unable to open " + filePath + ".");
+
+    std::string header;
+    unsigned int version = 0;
+    if (!(file >> header >> version) || header != "journal")
+        throw std::runtime_error("InputJournal: " + filePath + " is not a journal.");
+    if (version < 1 || version > INPUT_JOURNAL_VERSION)
+        throw std::runtime_error("InputJournal: unsupported version of " + filePath + ".");
+    _version = version;
+
+    _events.clear();
+
+    std::string lineString;
+    while (std::getline(file, lineString)) {
+        std::istringstream line(lineString);
+        std::string first;
+        if (!(line >> first))
+            continue;
+
+        if (first == "grid") {
+            if (!(line >> _settings.gridSize.x >> _settings.gridSize.y))
+                throw std::runtime_error("InputJournal: invalid grid size");
+        } else if (first == "parameters") {
+            _settings.propagation = readFloat(line);
+            _settings.friction = readFloat(line);
+            _settings.elasticity = readFloat(line);
+        } else if (first == "timestep") {
+            _settings.timestep = readFloat(line);
+        } else if (first == "steps") {
+            if (!(line >> _stepsCount))
+                throw std::runtime_error("InputJournal: invalid steps count");
+        } else {
+            unsigned long step = std::strtoul(first.c_str(), nullptr, 10);
+            std::string type;
+            line >> type;
+
+            if (type == "touch") {
+                sf::Vector2f pos;
+                pos.x = readFloat(line);
+                pos.y = readFloat(line);
+                float radius = readFloat(line);
+                float extremum = readFloat(line);
+                recordTouch(step, pos, radius, extremum);
+            } else if (type == "init") {
+                recordInit(step);
+            } else if (type == "camera") {
+                float distance = readFloat(line);
+                float latitude = readFloat(line);
+                float longitude = readFloat(line);
+                recordCamera(step, distance, latitude, longitude);
+            } else if (type == "scroll") {
+                sf::Vector2i offset;
+                if (!(line >> offset.x >> offset.y))
+                    throw std::runtime_error("InputJournal: invalid scroll offset");
+                recordScroll(step, offset);
+            } else {
+                throw std::runtime_error("InputJournal: unknown entry " + lineString);
+            }
+
+            if (_events.size() > 1 && _events.back().step < _events[_events.size()-2].step)
+                throw std::runtime_error("InputJournal: entries are not sorted by step");
+        }
+    }
+}
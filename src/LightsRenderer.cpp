@@ -1,7 +1,9 @@
 #include "LightsRenderer.hpp"
 
 #include "GLHelper.hpp"
-#include "Utilities.hpp"
+#include "ProgramLoader.hpp"
+#include "Profiler.hpp"
+#include "ShaderSources.hpp"
 
 #include <iostream>
 #include <stdexcept>
@@ -16,17 +18,66 @@ LightsRenderer::LightsRenderer (unsigned int quality,
                                 float eta,
                                 glm::vec3 const& lightDir):
             Renderer::Renderer(amplitude, waterLevel, eta, glm::vec4(1), 2.f, lightDir),
+            _mode(Mode::Points),
+            _subsets(1),
+            _currentSubset(0),
+            _updatePeriod(1),
+            _updateCounter(0),
             _partPerPixel(2),
             _intensity(0.2f / static_cast<float>(_partPerPixel*_partPerPixel)),
             _particlesGridBufferID(-1),
             _particlesGridSize(_partPerPixel*quality, _partPerPixel*quality),
-            _particleSize(1.f)
+            _particleSize(1.f),
+            _meshPosBufferID(-1),
+            _meshIndexBufferID(-1),
+            _meshSize(std::max(2u,quality), std::max(2u,quality)),
+            _exposureShift(1.5f),
+            _exposureStretch(0.4f)
 {
     /* Texture allocation */
+    createBuffers(quality);
+
+    /* Shaders loading */
+    ProgramLoader loader;
+    loader.add(_computeLightsShader, getShaderSource("computeLights.vert"), getShaderSource("computeLights.frag"),
+               "LightsRenderer: unable to load compute lights shader");
+    loader.add(_computeLightsAreaShader, getShaderSource("computeLightsArea.vert"), getShaderSource("computeLightsArea.frag"),
+               "LightsRenderer: unable to load compute lights area shader");
+    loader.add(_accumulateLightsShader, "", getShaderSource("accumulateLights.frag"),
+               "LightsRenderer: unable to load accumulate lights shader");
+    loader.add(_processLightsShader, "", getShaderSource("processLights.frag"),
+               "LightsRenderer: unable to load adjust light ground shader");
+    loader.load();
+
+
+    /* Allocation of the buffers storing the particles and the surface mesh */
+    GLCHECK(glGenBuffers(1, &_particlesGridBufferID));
+    GLCHECK(glGenBuffers(1, &_meshPosBufferID));
+    GLCHECK(glGenBuffers(1, &_meshIndexBufferID));
+
+    computeGeometry();
+}
+
+LightsRenderer::~LightsRenderer()
+{
+    if (_particlesGridBufferID != (GLuint)(-1)) {
+        GLCHECK(glDeleteBuffers(1, &_particlesGridBufferID));
+    }
+    if (_meshPosBufferID != (GLuint)(-1)) {
+        GLCHECK(glDeleteBuffers(1, &_meshPosBufferID));
+    }
+    if (_meshIndexBufferID != (GLuint)(-1)) {
+        GLCHECK(glDeleteBuffers(1, &_meshIndexBufferID));
+    }
+}
+
+void LightsRenderer::createBuffers (unsigned int quality)
+{
     if (!_rawLights.create(quality, quality)) {
             throw std::runtime_error("LightsRenderer: unable to create buffer");
     }
     _rawLights.setSmooth(true);
+    setFloatStorage(_rawLights.getTexture());
 
     if (!_processedLights.create(_rawLights.getSize().x, _rawLights.getSize().y)) {
             throw std::runtime_error("LightsRenderer: unable to create buffer");
@@ -34,55 +85,83 @@ LightsRenderer::LightsRenderer (unsigned int quality,
     _processedLights.setSmooth(true);
     _processedLights.setRepeated(true);
 
-    /* Shaders loading */
-    std::string fragment, vertex, utils;
-    loadFile("shaders/utils.glsl", utils);
-
-    loadFile("shaders/computeLights.frag", fragment);
-    loadFile("shaders/computeLights.vert", vertex);
-    searchAndReplace("__UTILS__", utils, fragment);
-    searchAndReplace("__UTILS__", utils, vertex);
-    if (!_computeLightsShader.loadFromMemory(vertex, fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("LightsRenderer: unable to load compute lights shader");
+    for (sf::RenderTexture& subsetLights : _subsetsLights) {
+        if (!subsetLights.create(_rawLights.getSize().x, _rawLights.getSize().y)) {
+            throw std::runtime_error("LightsRenderer: unable to create buffer");
+        }
+        setFloatStorage(subsetLights.getTexture(), GL_R16F, GL_RED, false);
+        subsetLights.clear(sf::Color::Black);
     }
+}
 
-    loadFile("shaders/processLights.frag", fragment);
-    if (!_processLightsShader.loadFromMemory(fragment, sf::Shader::Fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("LightsRenderer: unable to load adjust light ground shader");
+void LightsRenderer::computeGeometry()
+{
+    /* Particles and triangles are sorted by subset, so that each subset
+     * can be drawn in one call. Subsets are interleaved along diagonals. */
+    _particlesSubsetsOffsets.assign(_subsets+1, 0);
+    _meshSubsetsOffsets.assign(_subsets+1, 0);
+
+    /* Particles initial position */
+    std::vector<glm::vec2> lightParticles;
+    lightParticles.reserve(_particlesGridSize.x*_particlesGridSize.y);
+    for (unsigned int subset = 0 ; subset < _subsets ; ++subset) {
+        _particlesSubsetsOffsets[subset] = lightParticles.size();
+        for (unsigned int iX = 0 ; iX < _particlesGridSize.x ; ++iX) {
+            for (unsigned int iY = 0 ; iY < _particlesGridSize.y ; ++iY)  {
+                if ((iX + iY) % _subsets == subset) {
+                    lightParticles.push_back(glm::vec2(static_cast<float>(iX) / static_cast<float>(_particlesGridSize.x),
+                                                       static_cast<float>(iY) / static_cast<float>(_particlesGridSize.y)));
+                }
+            }
+        }
     }
-
-
-    /* Allocation of the buffer storing the particles initial position */
-    std::vector<glm::vec2> lightParticles(_particlesGridSize.x*_particlesGridSize.y);
-    for (unsigned int iX = 0 ; iX < _particlesGridSize.x ; ++iX) {
-        for (unsigned int iY = 0 ; iY < _particlesGridSize.y ; ++iY)  {
-            unsigned int index = iX*_particlesGridSize.y + iY;
-            lightParticles[index] = glm::vec2(static_cast<float>(iX) / static_cast<float>(_particlesGridSize.x),
-                                              static_cast<float>(iY) / static_cast<float>(_particlesGridSize.y));
+    _particlesSubsetsOffsets[_subsets] = lightParticles.size();
+
+    /* Surface mesh: one vertex per texel */
+    int nbPtX = _meshSize.x, nbPtY = _meshSize.y;
+    float stepX = 1.f / static_cast<float>(nbPtX-1), stepY = 1.f / static_cast<float>(nbPtY-1);
+    std::vector<glm::vec2> meshPositions(nbPtX * nbPtY);
+    for (int iX = 0 ; iX < nbPtX ; ++iX) {
+        for (int iY = 0 ; iY < nbPtY ; ++iY) {
+            int index = iX*nbPtY + iY;
+            meshPositions[index].x = static_cast<float>(iX) * stepX;
+            meshPositions[index].y = static_cast<float>(iY) * stepY;
         }
     }
 
-    GLCHECK(glGenBuffers(1, &_particlesGridBufferID));
+    std::vector<glm::ivec3> meshIndexes;
+    meshIndexes.reserve(2 * (nbPtX-1) * (nbPtY-1));
+    for (unsigned int subset = 0 ; subset < _subsets ; ++subset) {
+        _meshSubsetsOffsets[subset] = meshIndexes.size();
+        for (int iX = 0 ; iX < nbPtX-1 ; ++iX) {
+            for (int iY = 0 ; iY < nbPtY-1 ; ++iY) {
+                if ((iX + iY) % _subsets == subset) {
+                    meshIndexes.push_back(glm::ivec3(iX,iX,iX+1)*nbPtY + glm::ivec3(iY+1, iY, iY));
+                    meshIndexes.push_back(glm::ivec3(iX,iX+1,iX+1)*nbPtY + glm::ivec3(iY+1, iY, iY+1));
+                }
+            }
+        }
+    }
+    _meshSubsetsOffsets[_subsets] = meshIndexes.size();
 
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _particlesGridBufferID));
     GLCHECK(glBufferData(GL_ARRAY_BUFFER, lightParticles.size()*sizeof(glm::vec2), lightParticles.data(), GL_STATIC_DRAW));
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _meshPosBufferID));
+    GLCHECK(glBufferData(GL_ARRAY_BUFFER, meshPositions.size()*sizeof(glm::vec2), meshPositions.data(), GL_STATIC_DRAW));
+    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _meshIndexBufferID));
+    GLCHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshIndexes.size()*sizeof(glm::ivec3), meshIndexes.data(), GL_STATIC_DRAW));
 
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
-}
-
-LightsRenderer::~LightsRenderer()
-{
-    if (_particlesGridBufferID != (GLuint)(-1)) {
-        GLCHECK(glDeleteBuffers(1, &_particlesGridBufferID));
-    }
+    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 }
 
 void LightsRenderer::reset()
 {
     _rawLights.clear(sf::Color::Black);
     _processedLights.clear(sf::Color::Black);
+    for (sf::RenderTexture& subsetLights : _subsetsLights) {
+        subsetLights.clear(sf::Color::Black);
+    }
 }
 
 sf::Texture const& LightsRenderer::getTexture() const
@@ -90,54 +169,144 @@ sf::Texture const& LightsRenderer::getTexture() const
     return _processedLights.getTexture();
 }
 
+void LightsRenderer::setMode (Mode mode)
+{
+    _mode = mode;
+}
+LightsRenderer::Mode LightsRenderer::getMode() const
+{
+    return _mode;
+}
+
+void LightsRenderer::setAmortization (unsigned int subsets)
+{
+    /* The accumulation sums 2 or 4 buffers: unused ones stay black */
+    subsets = (subsets <= 1) ? 1 : (subsets == 2) ? 2 : MAX_SUBSETS;
+    if (subsets == _subsets)
+        return;
+
+    _subsets = subsets;
+    _currentSubset = 0;
+    computeGeometry();
+    reset();
+}
+unsigned int LightsRenderer::getAmortization() const
+{
+    return _subsets;
+}
+
+void LightsRenderer::setQuality (unsigned int quality)
+{
+    quality = std::max(2u, quality);
+    if (quality == getQuality())
+        return;
+
+    createBuffers(quality);
+    _particlesGridSize = sf::Vector2u(_partPerPixel*quality, _partPerPixel*quality);
+    _meshSize = sf::Vector2u(quality, quality);
+    _currentSubset = 0;
+    computeGeometry();
+    reset();
+}
+unsigned int LightsRenderer::getQuality() const
+{
+    return _rawLights.getSize().x;
+}
+
+void LightsRenderer::setParticlesPerPixel (unsigned int particles)
+{
+    particles = std::max(1u, particles);
+    if (particles == _partPerPixel)
+        return;
+
+    _partPerPixel = particles;
+    _intensity = 0.2f / static_cast<float>(_partPerPixel*_partPerPixel);
+    _particlesGridSize = sf::Vector2u(_partPerPixel*getQuality(), _partPerPixel*getQuality());
+    _currentSubset = 0;
+    computeGeometry();
+    reset();
+}
+unsigned int LightsRenderer::getParticlesPerPixel() const
+{
+    return _partPerPixel;
+}
+
+void LightsRenderer::setUpdatePeriod (unsigned int period)
+{
+    _updatePeriod = std::max(1u, period);
+}
+unsigned int LightsRenderer::getUpdatePeriod() const
+{
+    return _updatePeriod;
+}
+
 void LightsRenderer::update (sf::Texture const& heightmap)
 {
-    computeRawLights(heightmap);
+    PROFILE_ZONE("LightsRenderer::update");
+    _updateCounter = (_updateCounter + 1) % _updatePeriod;
+    if (_updateCounter != 0)
+        return;
+
+    if (_subsets > 1) {
+        computeRawLights(heightmap, _subsetsLights[_currentSubset]);
+        accumulateLights();
+        _currentSubset = (_currentSubset + 1) % _subsets;
+    } else {
+        computeRawLights(heightmap, _rawLights);
+    }
     computeProcessedLights();
 }
 
-void LightsRenderer::computeRawLights(sf::Texture const& heightmap)
+void LightsRenderer::computeRawLights(sf::Texture const& heightmap, sf::RenderTexture& target)
 {
-    _rawLights.setActive(true);
+    target.setActive(true);
     GLCHECK(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
-    GLCHECK(glViewport(0, 0, _rawLights.getSize().x, _rawLights.getSize().y));
+    GLCHECK(glViewport(0, 0, target.getSize().x, target.getSize().y));
 
-    sf::Vector2f cellSizeOnBuffer(1.f / static_cast<float>(heightmap.getSize().x),
-                                  1.f / static_cast<float>(heightmap.getSize().x));
+    if (_mode == Mode::AreaRatio)
+        computeRawLightsArea(heightmap);
+    else
+        computeRawLightsPoints(heightmap);
 
-    _computeLightsShader.setParameter("heightmap", heightmap);
-    sf::Shader::bind(&_computeLightsShader);
+    target.display();
+}
 
+void LightsRenderer::setRawLightsUniforms (sf::Shader const& shader,
+                                           sf::Texture const& heightmap) const
+{
     /* First retrieve locations */
     GLuint shaderHandle = -1;
-    GLuint posALoc = -1;
-    GLuint cellSizeULoc = -1, intensityULoc = -1, amplitudeULoc = -1, waterLevelULoc = -1, etaULoc = -1, lightDirULoc = -1;
-//    try {
-        shaderHandle = getShaderHandle(_computeLightsShader, false);
-
-        cellSizeULoc = getShaderUniformLoc(shaderHandle, "cellSize", false);
-        intensityULoc = getShaderUniformLoc(shaderHandle, "intensity", false);
-        amplitudeULoc = getShaderUniformLoc(shaderHandle, "amplitude", false);
-        waterLevelULoc = getShaderUniformLoc(shaderHandle, "waterLevel", false);
-        etaULoc = getShaderUniformLoc(shaderHandle, "eta", false);
-        lightDirULoc = getShaderUniformLoc(shaderHandle, "normalizedLightDir", false);
-
-        posALoc = getShaderAttributeLoc(shaderHandle, "pos", false);
-//    } catch (std::exception const& e) {
-//        std::cerr << "LightsRenderer.udpate: " << e.what() << std::endl;
-//        return;
-//    }
+    GLuint cellSizeULoc = -1, amplitudeULoc = -1, waterLevelULoc = -1, etaULoc = -1, lightDirULoc = -1;
+    shaderHandle = getShaderHandle(shader, false);
+
+    cellSizeULoc = getShaderUniformLoc(shaderHandle, "cellSize", false);
+    amplitudeULoc = getShaderUniformLoc(shaderHandle, "amplitude", false);
+    waterLevelULoc = getShaderUniformLoc(shaderHandle, "waterLevel", false);
+    etaULoc = getShaderUniformLoc(shaderHandle, "eta", false);
+    lightDirULoc = getShaderUniformLoc(shaderHandle, "normalizedLightDir", false);
 
     glm::vec2 cellSize(1.f / static_cast<float>(heightmap.getSize().x),
                        1.f / static_cast<float>(heightmap.getSize().y));
     glm::vec3 lightDir = getLightDirection();
 
     GLCHECK(glUniform2f(cellSizeULoc, cellSize.x, cellSize.y));
-    GLCHECK(glUniform1f(intensityULoc, _intensity));
     GLCHECK(glUniform1f(amplitudeULoc, getAmplitude()));
     GLCHECK(glUniform1f(waterLevelULoc, getWaterLevel()));
     GLCHECK(glUniform1f(etaULoc, getEta()));
     GLCHECK(glUniform3f(lightDirULoc, lightDir.x, lightDir.y, lightDir.z));
+}
+
+void LightsRenderer::computeRawLightsPoints(sf::Texture const& heightmap)
+{
+    _computeLightsShader.setParameter("heightmap", heightmap);
+    sf::Shader::bind(&_computeLightsShader);
+    setRawLightsUniforms(_computeLightsShader, heightmap);
+
+    GLuint shaderHandle = getShaderHandle(_computeLightsShader, false);
+    GLuint intensityULoc = getShaderUniformLoc(shaderHandle, "intensity", false);
+    GLuint posALoc = getShaderAttributeLoc(shaderHandle, "pos", false);
+
+    GLCHECK(glUniform1f(intensityULoc, _intensity));
 
     /* Enabling coordinates buffer */
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _particlesGridBufferID));
@@ -150,25 +319,96 @@ void LightsRenderer::computeRawLights(sf::Texture const& heightmap)
     GLCHECK(glDisable(GL_DEPTH_TEST));
     GLCHECK(glEnable(GL_BLEND));
     GLCHECK(glBlendFunc(GL_ONE, GL_ONE));
-    GLCHECK(glDrawArrays(GL_POINTS, 0, _particlesGridSize.x*_particlesGridSize.y));
+    GLint first = _particlesSubsetsOffsets[_currentSubset];
+    GLsizei count = _particlesSubsetsOffsets[_currentSubset+1] - first;
+    GLCHECK(glDrawArrays(GL_POINTS, first, count));
+
+    /* Don't forget to unbind buffers */
+    GLCHECK(glDisableVertexAttribArray(posALoc));
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    sf::Shader::bind(0);
+}
+
+void LightsRenderer::computeRawLightsArea(sf::Texture const& heightmap)
+{
+    _computeLightsAreaShader.setParameter("heightmap", heightmap);
+    sf::Shader::bind(&_computeLightsAreaShader);
+    setRawLightsUniforms(_computeLightsAreaShader, heightmap);
+
+    GLuint shaderHandle = getShaderHandle(_computeLightsAreaShader, false);
+    GLuint intensityULoc = getShaderUniformLoc(shaderHandle, "intensity", false);
+    GLuint tileOffsetULoc = getShaderUniformLoc(shaderHandle, "tileOffset", false);
+    GLuint posALoc = getShaderAttributeLoc(shaderHandle, "pos", false);
+
+    /* A flat surface gives the same luminosity as with the points method */
+    float intensity = _intensity * static_cast<float>(_partPerPixel*_partPerPixel);
+    GLCHECK(glUniform1f(intensityULoc, intensity));
+
+    /* Enabling coordinates buffer */
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _meshPosBufferID));
+    GLCHECK(glEnableVertexAttribArray(posALoc));
+    GLCHECK(glVertexAttribPointer(posALoc, 2, GL_FLOAT, GL_FALSE, 0, (void*)0));
+
+    /* Actual drawing: overlapping triangles (caustics folds) add up */
+    GLCHECK(glDisable(GL_CULL_FACE));
+    GLCHECK(glDisable(GL_DEPTH_TEST));
+    GLCHECK(glEnable(GL_BLEND));
+    GLCHECK(glBlendFunc(GL_ONE, GL_ONE));
+    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _meshIndexBufferID));
+    unsigned int first = _meshSubsetsOffsets[_currentSubset];
+    unsigned int count = _meshSubsetsOffsets[_currentSubset+1] - first;
+
+    /* The rays leaving the box come back from the opposite side, like the
+     * points: the mesh is also drawn on the 8 neighbouring tiles. Only the
+     * triangles crossing the border survive the clipping there. */
+    for (int offsetY = -1 ; offsetY <= 1 ; ++offsetY) {
+        for (int offsetX = -1 ; offsetX <= 1 ; ++offsetX) {
+            GLCHECK(glUniform2f(tileOffsetULoc, static_cast<float>(offsetX), static_cast<float>(offsetY)));
+            GLCHECK(glDrawElements(GL_TRIANGLES, 3*count, GL_UNSIGNED_INT, (void*)(first*sizeof(glm::ivec3))));
+        }
+    }
 
     /* Don't forget to unbind buffers */
     GLCHECK(glDisableVertexAttribArray(posALoc));
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
     sf::Shader::bind(0);
+}
 
+void LightsRenderer::accumulateLights()
+{
+    sf::Vector2f texSize = sf::Vector2f(_rawLights.getSize().x, _rawLights.getSize().y);
+    sf::RenderStates renderStates (sf::BlendNone);
+    renderStates.shader = &_accumulateLightsShader;
+    _accumulateLightsShader.setParameter("subset0", _subsetsLights[0].getTexture());
+    _accumulateLightsShader.setParameter("subset1", _subsetsLights[1].getTexture());
+    _accumulateLightsShader.setParameter("subset2", _subsetsLights[2].getTexture());
+    _accumulateLightsShader.setParameter("subset3", _subsetsLights[3].getTexture());
+    _accumulateLightsShader.setParameter("subsetsCount", static_cast<float>(_subsets));
+    _accumulateLightsShader.setParameter("textureSize", texSize);
+
+    sf::RectangleShape square(texSize);
+
+    _rawLights.clear();
+    _rawLights.draw(square, renderStates);
     _rawLights.display();
 }
 
 void LightsRenderer::computeProcessedLights()
 {
+    sf::Texture const& lights = _rawLights.getTexture();
+
+    /* The top mipmap level holds the average luminosity, used for exposure */
+    generateMipmaps(lights);
+
     sf::Vector2f texSize = sf::Vector2f(_processedLights.getSize().x, _processedLights.getSize().y);
     sf::RenderStates renderStates (sf::BlendNone);
     renderStates.shader = &_processLightsShader;
-    _processLightsShader.setParameter("rawLightsTexture", _rawLights.getTexture());
+    _processLightsShader.setParameter("rawLightsTexture", lights);
     _processLightsShader.setParameter("textureSize", texSize);
-    _processLightsShader.setParameter("shift", 0.3f);
-    _processLightsShader.setParameter("stretch", 2.f);
+    _processLightsShader.setParameter("averageLevel", static_cast<float>(getTopMipmapLevel(lights.getSize())));
+    _processLightsShader.setParameter("shiftFactor", _exposureShift);
+    _processLightsShader.setParameter("stretchFactor", _exposureStretch);
 
     sf::RectangleShape square(texSize);
 
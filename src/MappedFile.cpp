@@ -0,0 +1,57 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+MappedFile::MappedFile (std::string const& filePath):
+            _data (nullptr),
+            _size (0)
+{
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("unable to open file " + filePath + ".");
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        throw std::runtime_error("unable to stat file " + filePath + ".");
+    }
+    _size = fileStat.st_size;
+
+    if (_size > 0) {
+        void* mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("unable to map file " + filePath + ".");
+        }
+        _data = static_cast<const unsigned char*>(mapping);
+
+        /* The whole file is going to be read: start loading it now */
+        madvise(mapping, _size, MADV_WILLNEED);
+    }
+
+    /* The mapping stays valid after closing */
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data != nullptr) {
+        munmap(const_cast<unsigned char*>(_data), _size);
+    }
+}
+
+const unsigned char* MappedFile::getData() const
+{
+    return _data;
+}
+
+std::size_t MappedFile::getSize() const
+{
+    return _size;
+}
@@ -0,0 +1,262 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace
+{
+    /* Shortest text giving back the same double */
+    std::string formatValue (double value)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.15g", value);
+        if (std::strtod(text, nullptr) != value)
+            std::snprintf(text, sizeof(text), "%.17g", value);
+        return text;
+    }
+
+    /* Index of the most significant bit, value > 0 */
+    unsigned int getMostSignificantBit (std::uint64_t value)
+    {
+        unsigned int bit = 0;
+        while (value >>= 1)
+            ++bit;
+        return bit;
+    }
+}
+
+MetricsCounter::MetricsCounter ():
+            _value (0)
+{
+}
+
+void MetricsCounter::increment (std::uint64_t count)
+{
+    _value.fetch_add(count, std::memory_order_relaxed);
+}
+std::uint64_t MetricsCounter::getValue() const
+{
+    return _value.load(std::memory_order_relaxed);
+}
+
+MetricsGauge::MetricsGauge ():
+            _bits (0) //0.0
+{
+}
+
+void MetricsGauge::setValue (double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    _bits.store(bits, std::memory_order_relaxed);
+}
+double MetricsGauge::getValue() const
+{
+    std::uint64_t bits = _bits.load(std::memory_order_relaxed);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+MetricsHistogram::MetricsHistogram (double unit, unsigned int maxExponent, unsigned int subBucketsCount):
+            _unit (unit),
+            _subBucketsShift (0),
+            _overflowCount (0),
+            _count (0),
+            _sum (0)
+{
+    while ((1u << _subBucketsShift) < subBucketsCount)
+        ++_subBucketsShift;
+    if (maxExponent < _subBucketsShift || maxExponent > 63)
+        throw std::runtime_error("MetricsHistogram: invalid range");
+
+    /* Linear values, then each power of two up to the max exponent */
+    std::vector<std::atomic<std::uint64_t>> buckets((maxExponent - _subBucketsShift + 1) << _subBucketsShift);
+    _buckets.swap(buckets);
+    for (std::atomic<std::uint64_t>& bucket : _buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+void MetricsHistogram::record (std::uint64_t value)
+{
+    std::size_t bucket = getBucket(value);
+    if (bucket < _buckets.size())
+        _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    else
+        _overflowCount.fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+double MetricsHistogram::getUnit() const
+{
+    return _unit;
+}
+
+std::uint64_t MetricsHistogram::getCount() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+std::uint64_t MetricsHistogram::getSum() const
+{
+    return _sum.load(std::memory_order_relaxed);
+}
+
+std::size_t MetricsHistogram::getBucketsCount() const
+{
+    return _buckets.size();
+}
+
+std::uint64_t MetricsHistogram::getBucketCount (std::size_t bucket) const
+{
+    return _buckets[bucket].load(std::memory_order_relaxed);
+}
+
+std::uint64_t MetricsHistogram::getOverflowCount() const
+{
+    return _overflowCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t MetricsHistogram::getBucketLimit (std::size_t bucket) const
+{
+    std::uint64_t subBucketsCount = 1ull << _subBucketsShift;
+    if (bucket < subBucketsCount)
+        return bucket;
+
+    /* Bucket j of the power k starts at (subBucketsCount + j) << (k-1),
+     * and ends right before the next one */
+    std::uint64_t power = bucket >> _subBucketsShift;
+    std::uint64_t subBucket = bucket & (subBucketsCount - 1);
+    return ((subBucketsCount + subBucket + 1) << (power - 1)) - 1;
+}
+
+std::uint64_t MetricsHistogram::getQuantile (double q) const
+{
+    std::uint64_t count = getCount();
+    if (count == 0)
+        return 0;
+
+    /* The buckets may be a little ahead of the count: it is incremented after them */
+    std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+    std::uint64_t cumulated = 0;
+    for (std::size_t i = 0 ; i < _buckets.size() ; ++i) {
+        cumulated += getBucketCount(i);
+        if (cumulated >= rank)
+            return getBucketLimit(i);
+    }
+    return std::numeric_limits<std::uint64_t>::max();
+}
+
+std::size_t MetricsHistogram::getBucket (std::uint64_t value) const
+{
+    std::uint64_t subBucketsCount = 1ull << _subBucketsShift;
+    if (value < subBucketsCount)
+        return value;
+
+    unsigned int msb = getMostSignificantBit(value);
+    std::size_t bucket = ((msb - _subBucketsShift + 1) << _subBucketsShift) +
+                         ((value >> (msb - _subBucketsShift)) - subBucketsCount);
+    return std::min(bucket, _buckets.size());
+}
+
+MetricsCounter& MetricsRegistry::addCounter (std::string const& name, std::string const& help)
+{
+    std::unique_ptr<Metric> metric(new Metric(name, help));
+    metric->counter.reset(new MetricsCounter());
+    MetricsCounter& counter = *metric->counter;
+    addMetric(std::move(metric));
+    return counter;
+}
+
+MetricsGauge& MetricsRegistry::addGauge (std::string const& name, std::string const& help)
+{
+    std::unique_ptr<Metric> metric(new Metric(name, help));
+    metric->gauge.reset(new MetricsGauge());
+    MetricsGauge& gauge = *metric->gauge;
+    addMetric(std::move(metric));
+    return gauge;
+}
+
+MetricsHistogram& MetricsRegistry::addHistogram (std::string const& name, std::string const& help,
+                                                 double unit, unsigned int maxExponent, unsigned int subBucketsCount)
+{
+    std::unique_ptr<Metric> metric(new Metric(name, help));
+    metric->histogram.reset(new MetricsHistogram(unit, maxExponent, subBucketsCount));
+    MetricsHistogram& histogram = *metric->histogram;
+    addMetric(std::move(metric));
+    return histogram;
+}
+
+std::string MetricsRegistry::exportText() const
+{
+    std::ostringstream text;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (std::unique_ptr<Metric> const& metric : _metrics) {
+        text << "# HELP " << metric->name << " " << metric->help << "\n";
+
+        if (metric->counter) {
+            text << "# TYPE " << metric->name << " counter\n"
+                 << metric->name << " " << metric->counter->getValue() << "\n";
+        } else if (metric->gauge) {
+            text << "# TYPE " << metric->name << " gauge\n"
+                 << metric->name << " " << formatValue(metric->gauge->getValue()) << "\n";
+        } else {
+            /* Cumulative buckets, read before the count: they are never behind it */
+            MetricsHistogram const& histogram = *metric->histogram;
+            text << "# TYPE " << metric->name << " histogram\n";
+            std::uint64_t cumulated = 0;
+            for (std::size_t i = 0 ; i < histogram.getBucketsCount() ; ++i) {
+                cumulated += histogram.getBucketCount(i);
+                text << metric->name << "_bucket{le=\"" << formatValue(histogram.getBucketLimit(i) * histogram.getUnit())
+                     << "\"} " << cumulated << "\n";
+            }
+            cumulated += histogram.getOverflowCount();
+            std::uint64_t count = std::max(cumulated, histogram.getCount());
+            text << metric->name << "_bucket{le=\"+Inf\"} " << count << "\n"
+                 << metric->name << "_sum " << formatValue(histogram.getSum() * histogram.getUnit()) << "\n"
+                 << metric->name << "_count " << count << "\n";
+        }
+    }
+
+    return text.str();
+}
+
+void MetricsRegistry::writeSnapshot (std::string const& filePath) const
+{
+    std::string temporaryPath = filePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        file << exportText();
+        if (!file)
+            throw std::runtime_error("MetricsRegistry: unable to write " + temporaryPath + ".");
+    }
+
+    if (std::rename(temporaryPath.c_str(), filePath.c_str()) != 0)
+        throw std::runtime_error("MetricsRegistry: unable to replace " + filePath + ".");
+}
+
+MetricsRegistry::Metric::Metric (std::string const& name, std::string const& help):
+            name (name),
+            help (help)
+{
+}
+
+void MetricsRegistry::addMetric (std::unique_ptr<Metric> metric)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (std::unique_ptr<Metric> const& registered : _metrics) {
+        if (registered->name == metric->name)
+            throw std::runtime_error("MetricsRegistry: " + metric->name + " already registered");
+    }
+
+    _metrics.push_back(std::move(metric));
+}
@@ -0,0 +1,253 @@
+#include "MetricsExporter.hpp"
+
+#include "Profiler.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace
+{
+    bool isPort (std::string const& address)
+    {
+        return !address.empty() && address.find_first_not_of("0123456789") == std::string::npos;
+    }
+}
+
+MetricsExporter::MetricsExporter (MetricsRegistry const& registry,
+                                  std::string const& address,
+                                  std::string const& snapshotPath,
+                                  float snapshotPeriod):
+            _registry (registry),
+            _address (address),
+            _snapshotPath (snapshotPath),
+            _snapshotPeriod (std::max(0.1f, snapshotPeriod)),
+            _socket (-1),
+            _servedCount (0)
+{
+    if (isPort(_address)) {
+        unsigned long port = std::strtoul(_address.c_str(), nullptr, 10);
+        if (port == 0 || port > 65535)
+            throw std::runtime_error("MetricsExporter: invalid port " + _address + ".");
+
+        sockaddr_in inetAddress;
+        std::memset(&inetAddress, 0, sizeof(inetAddress));
+        inetAddress.sin_family = AF_INET;
+        inetAddress.sin_port = htons(static_cast<std::uint16_t>(port));
+        inetAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        _socket = socket(AF_INET, SOCK_STREAM, 0);
+        if (_socket < 0)
+            throw std::runtime_error("MetricsExporter: unable to create socket.");
+
+        int reuse = 1;
+        setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(_socket, reinterpret_cast<sockaddr*>(&inetAddress), sizeof(inetAddress)) != 0 || listen(_socket, 16) != 0) {
+            close(_socket);
+            throw std::runtime_error("MetricsExporter: unable to listen on port " + _address + ".");
+        }
+    } else if (!_address.empty()) {
+        sockaddr_un unixAddress;
+        std::memset(&unixAddress, 0, sizeof(unixAddress));
+        unixAddress.sun_family = AF_UNIX;
+        if (_address.size() >= sizeof(unixAddress.sun_path))
+            throw std::runtime_error("MetricsExporter: socket path too long: " + _address + ".");
+        std::strcpy(unixAddress.sun_path, _address.c_str());
+
+        _socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (_socket < 0)
+            throw std::runtime_error("MetricsExporter: unable to create socket.");
+
+        unlink(_address.c_str());
+        if (bind(_socket, reinterpret_cast<sockaddr*>(&unixAddress), sizeof(unixAddress)) != 0 || listen(_socket, 16) != 0) {
+            close(_socket);
+            throw std::runtime_error("MetricsExporter: unable to listen on " + _address + ".");
+        }
+        _socketPath = _address;
+    }
+    if (_socket >= 0)
+        fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL) | O_NONBLOCK);
+
+    if (pipe(_wakeUpPipe) != 0) {
+        if (_socket >= 0)
+            close(_socket);
+        if (!_socketPath.empty())
+            unlink(_socketPath.c_str());
+        throw std::runtime_error("MetricsExporter: unable to create pipe.");
+    }
+
+    _thread = std::thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    char byte = 0;
+    while (write(_wakeUpPipe[1], &byte, 1) < 0 && errno == EINTR);
+    _thread.join();
+
+    /* Last snapshot, with the final values */
+    writeSnapshot();
+
+    for (Client& client : _clients)
+        close(client.fd);
+    close(_wakeUpPipe[0]);
+    close(_wakeUpPipe[1]);
+    if (_socket >= 0)
+        close(_socket);
+    if (!_socketPath.empty())
+        unlink(_socketPath.c_str());
+}
+
+std::string const& MetricsExporter::getAddress() const
+{
+    return _address;
+}
+
+unsigned long MetricsExporter::getServedCount() const
+{
+    return _servedCount;
+}
+
+void MetricsExporter::run()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Profiler::setThreadName("metrics exporter");
+
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(_snapshotPeriod));
+    Clock::time_point nextSnapshot = Clock::now() + period;
+
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.clear();
+        fds.push_back({_wakeUpPipe[0], POLLIN, 0});
+        fds.push_back({_socket, POLLIN, 0}); //ignored without endpoint
+        for (Client const& client : _clients)
+            fds.push_back({client.fd, POLLIN, 0});
+
+        int timeout = -1;
+        if (!_snapshotPath.empty()) {
+            Clock::duration remaining = std::max(Clock::duration::zero(), nextSnapshot - Clock::now());
+            timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count()) + 1;
+        }
+
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+            return;
+
+        if (fds[0].revents != 0)
+            return;
+
+        if (!_snapshotPath.empty() && Clock::now() >= nextSnapshot) {
+            writeSnapshot();
+            nextSnapshot += period;
+            if (nextSnapshot < Clock::now()) //never catches up with missed snapshots
+                nextSnapshot = Clock::now() + period;
+        }
+
+        if (fds[1].revents & POLLIN)
+            accept();
+
+        /* The clients accepted above are not in fds yet */
+        std::size_t polledCount = fds.size() - 2;
+        std::size_t kept = 0;
+        for (std::size_t i = 0 ; i < _clients.size() ; ++i) {
+            Client& client = _clients[i];
+            bool isReadable = (i < polledCount) && (fds[i + 2].revents != 0);
+            if (isReadable && !read(client)) {
+                close(client.fd);
+                continue;
+            }
+
+            if (kept != i)
+                _clients[kept] = std::move(client);
+            ++kept;
+        }
+        _clients.resize(kept);
+    }
+}
+
+void MetricsExporter::accept()
+{
+    while (true) {
+        int fd = ::accept(_socket, nullptr, nullptr);
+        if (fd < 0)
+            return;
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        _clients.push_back({fd, std::string()});
+    }
+}
+
+bool MetricsExporter::read (Client& client)
+{
+    PROFILE_ZONE("MetricsExporter::read");
+
+    /* Until the end of the headers, or until the client stops sending */
+    bool complete = false;
+    char buffer[1024];
+    while (!complete) {
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            client.request.append(buffer, received);
+            complete = client.request.find("\r\n\r\n") != std::string::npos ||
+                       client.request.find("\n\n") != std::string::npos;
+        } else if (received == 0) {
+            complete = true;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    if (client.request.size() > MAX_REQUEST_SIZE)
+        return false;
+    if (!complete)
+        return true;
+
+    std::string body = _registry.exportText();
+    std::string response = "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n"
+                           "\r\n" + body;
+
+    /* Small enough to go through the socket buffer at once, blocking otherwise */
+    fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) & ~O_NONBLOCK);
+    std::size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t written = send(client.fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        sent += written;
+    }
+
+    ++_servedCount;
+    return false;
+}
+
+void MetricsExporter::writeSnapshot()
+{
+    if (_snapshotPath.empty())
+        return;
+
+    try {
+        _registry.writeSnapshot(_snapshotPath);
+    } catch (std::exception const& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,188 @@
+#include "OutOfCoreWater.hpp"
+
+#include "CpuWater.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+OutOfCoreWater::OutOfCoreWater (std::string const& filePath,
+                                sf::Vector2u gridSize,
+                                float propagation,
+                                float friction,
+                                float elasticity,
+                                unsigned int bandHeight):
+            _filePath (filePath),
+            _gridSize (gridSize),
+            _friction (friction),
+            _propagation (propagation),
+            _elasticity (elasticity),
+            _bandHeight (std::max(1u, bandHeight)),
+            _bandsCount ((gridSize.y + _bandHeight - 1) / _bandHeight),
+            _upwards (true),
+            _step (0),
+            _fileDescriptor (-1),
+            _data (nullptr),
+            _size (2 * sizeof(float) * static_cast<std::size_t>(gridSize.x) * gridSize.y),
+            _halo (2 * gridSize.x),
+            _result (2 * gridSize.x)
+{
+    if (_size == 0)
+        throw std::runtime_error("OutOfCoreWater: empty grid.");
+
+    _fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (_fileDescriptor < 0)
+        throw std::runtime_error("OutOfCoreWater: unable to open file " + filePath + ".");
+
+    try {
+        init();
+    } catch (...) {
+        close(_fileDescriptor);
+        throw;
+    }
+}
+
+OutOfCoreWater::~OutOfCoreWater()
+{
+    unmap();
+    close(_fileDescriptor);
+}
+
+sf::Vector2u OutOfCoreWater::getGridSize() const
+{
+    return _gridSize;
+}
+
+unsigned int OutOfCoreWater::getBandHeight() const
+{
+    return _bandHeight;
+}
+
+const float* OutOfCoreWater::getRow (unsigned int y) const
+{
+    return _data + 2 * static_cast<std::size_t>(_gridSize.x) * y;
+}
+
+float* OutOfCoreWater::getWritableRow (unsigned int y)
+{
+    return _data + 2 * static_cast<std::size_t>(_gridSize.x) * y;
+}
+
+unsigned long OutOfCoreWater::getStep () const
+{
+    return _step;
+}
+
+void OutOfCoreWater::update (float time)
+{
+    float dt = time * 10.f;
+
+    const std::size_t rowBytes = _halo.size() * sizeof(float);
+    const unsigned int lastRow = _gridSize.y - 1;
+
+    for (unsigned int i = 0 ; i < READ_AHEAD_BANDS && i < _bandsCount ; ++i)
+        prefetchBand(_upwards ? i : _bandsCount - 1 - i);
+
+    for (unsigned int i = 0 ; i < _bandsCount ; ++i) {
+        unsigned int band = _upwards ? i : _bandsCount - 1 - i;
+        if (i + READ_AHEAD_BANDS < _bandsCount)
+            prefetchBand(_upwards ? band + READ_AHEAD_BANDS : band - READ_AHEAD_BANDS);
+
+        unsigned int firstRow = band * _bandHeight;
+        unsigned int endRow = std::min(firstRow + _bandHeight, _gridSize.y);
+        for (unsigned int j = firstRow ; j < endRow ; ++j) {
+            /* The row already updated on the sweep side is read from the halo */
+            unsigned int y = _upwards ? j : endRow - 1 - (j - firstRow);
+            float* row = getWritableRow(y);
+            const float* below = (y == 0) ? row : (_upwards ? _halo.data() : getRow(y - 1));
+            const float* above = (y == lastRow) ? row : (_upwards ? getRow(y + 1) : _halo.data());
+
+            CpuWater::updateRow(below, row, above, _result.data(), _gridSize.x,
+                                dt, _propagation, _friction, _elasticity);
+
+            std::memcpy(_halo.data(), row, rowBytes);
+            std::memcpy(row, _result.data(), rowBytes);
+        }
+
+        writeBackBand(band);
+    }
+
+    _upwards = !_upwards;
+    ++_step;
+}
+
+void OutOfCoreWater::init ()
+{
+    /* Truncating gives a sparse file full of zeros: the water at rest */
+    unmap();
+    if (ftruncate(_fileDescriptor, 0) != 0 || ftruncate(_fileDescriptor, _size) != 0)
+        throw std::runtime_error("OutOfCoreWater: unable to resize file " + _filePath + ".");
+    map();
+
+    _upwards = true;
+}
+
+void OutOfCoreWater::touch (sf::Vector2f pos, float radius, float extremum)
+{
+    unsigned int first, last;
+    CpuWater::getTouchedRows(_gridSize, pos, radius, first, last);
+    for (unsigned int y = first ; y < last ; ++y)
+        CpuWater::touchRow(getWritableRow(y), y, _gridSize, pos, radius, extremum);
+}
+
+void OutOfCoreWater::flush ()
+{
+    if (msync(_data, _size, MS_SYNC) != 0)
+        throw std::runtime_error("OutOfCoreWater: unable to write file " + _filePath + ".");
+}
+
+void OutOfCoreWater::map ()
+{
+    void* mapping = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fileDescriptor, 0);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("OutOfCoreWater: unable to map file " + _filePath + ".");
+    _data = static_cast<float*>(mapping);
+}
+
+void OutOfCoreWater::unmap ()
+{
+    if (_data != nullptr) {
+        munmap(_data, _size);
+        _data = nullptr;
+    }
+}
+
+void OutOfCoreWater::getBandRange (unsigned int band, std::size_t& offset, std::size_t& length) const
+{
+    const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    const std::size_t bandBytes = _halo.size() * sizeof(float) * _bandHeight;
+
+    std::size_t begin = band * bandBytes;
+    std::size_t end = std::min(begin + bandBytes, _size);
+    offset = begin - begin % pageSize;
+    length = end - offset;
+}
+
+void OutOfCoreWater::prefetchBand (unsigned int band)
+{
+    std::size_t offset, length;
+    getBandRange(band, offset, length);
+    madvise(reinterpret_cast<char*>(_data) + offset, length, MADV_WILLNEED);
+}
+
+void OutOfCoreWater::writeBackBand (unsigned int band)
+{
+    std::size_t offset, length;
+    getBandRange(band, offset, length);
+#ifdef __linux__
+    /* Starts the writing without waiting for it */
+    sync_file_range(_fileDescriptor, offset, length, SYNC_FILE_RANGE_WRITE);
+#else
+    msync(reinterpret_cast<char*>(_data) + offset, length, MS_ASYNC);
+#endif
+}
@@ -0,0 +1,105 @@
+#include "PassTimer.hpp"
+
+#include "GLHelper.hpp"
+
+#include <algorithm>
+
+
+PassTimer::PassTimer (unsigned int passesCount, unsigned int latency):
+            _passesCount (passesCount),
+            _latency (std::max(1u, latency)),
+            _writeSlot (0),
+            _pendingCount (0),
+            _measuring (false)
+{
+    if (isAvailable()) {
+        _queryIDs.resize(_latency * (_passesCount + 1));
+        GLCHECK(glGenQueries(_queryIDs.size(), _queryIDs.data()));
+    }
+}
+
+PassTimer::~PassTimer()
+{
+    if (!_queryIDs.empty()) {
+        GLCHECK(glDeleteQueries(_queryIDs.size(), _queryIDs.data()));
+    }
+}
+
+bool PassTimer::isAvailable()
+{
+    return GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+}
+
+unsigned int PassTimer::getPassesCount() const
+{
+    return _passesCount;
+}
+
+void PassTimer::beginFrame ()
+{
+    /* All the slots are waiting for their results: this frame is skipped */
+    _measuring = !_queryIDs.empty() && _pendingCount < _latency;
+    if (!_measuring)
+        return;
+
+    GLCHECK(glQueryCounter(_queryIDs[_writeSlot * (_passesCount + 1)], GL_TIMESTAMP));
+}
+
+void PassTimer::endPass (unsigned int pass)
+{
+    if (!_measuring || pass >= _passesCount)
+        return;
+
+    GLCHECK(glQueryCounter(_queryIDs[_writeSlot * (_passesCount + 1) + pass + 1], GL_TIMESTAMP));
+
+    if (pass + 1 == _passesCount) {
+        _writeSlot = (_writeSlot + 1) % _latency;
+        ++_pendingCount;
+        _measuring = false;
+    }
+}
+
+bool PassTimer::retrieve (std::vector<float>& passTimes)
+{
+    std::vector<std::uint64_t> timestamps;
+    return retrieve(passTimes, timestamps);
+}
+
+bool PassTimer::retrieve (std::vector<float>& passTimes, std::vector<std::uint64_t>& timestamps)
+{
+    if (_pendingCount == 0)
+        return false;
+
+    unsigned int readSlot = (_writeSlot + _latency - _pendingCount) % _latency;
+    const GLuint* queries = &_queryIDs[readSlot * (_passesCount + 1)];
+
+    /* The last timestamp is the last one to be written */
+    GLint available = GL_FALSE;
+    GLCHECK(glGetQueryObjectiv(queries[_passesCount], GL_QUERY_RESULT_AVAILABLE, &available));
+    if (available != GL_TRUE)
+        return false;
+
+    timestamps.resize(_passesCount + 1);
+    for (unsigned int i = 0 ; i <= _passesCount ; ++i) {
+        GLuint64 timestamp = 0;
+        GLCHECK(glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &timestamp));
+        timestamps[i] = timestamp;
+    }
+    --_pendingCount;
+
+    passTimes.resize(_passesCount);
+    for (unsigned int i = 0 ; i < _passesCount ; ++i) {
+        GLuint64 duration = (timestamps[i+1] > timestamps[i]) ? timestamps[i+1] - timestamps[i] : 0;
+        passTimes[i] = static_cast<float>(duration) * 1e-9f;
+    }
+    return true;
+}
+
+void PassTimer::reset ()
+{
+    /* The queries are reused as they are: writing a new timestamp
+     * discards the result that was never read */
+    _writeSlot = 0;
+    _pendingCount = 0;
+    _measuring = false;
+}
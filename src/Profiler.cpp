@@ -0,0 +1,233 @@
+#include "Profiler.hpp"
+
+#include "GLHelper.hpp"
+#include "PassTimer.hpp"
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+
+std::atomic<bool> Profiler::_enabled (false);
+
+namespace
+{
+    struct Event
+    {
+        const char* name;
+        std::uint64_t begin;
+        std::uint64_t end;
+    };
+
+    /* Up to a million zones per thread and per trace */
+    const std::size_t CHUNK_EVENTS = 4096;
+    const std::size_t MAX_CHUNKS = 256;
+
+    /* Written by a single thread, read by the export. The chunks are
+     * kept from one trace to the next, and never freed. */
+    struct ThreadBuffer
+    {
+        explicit ThreadBuffer (unsigned int id):
+                    id (id),
+                    name (nullptr),
+                    generation (0),
+                    count (0)
+        {
+            for (std::atomic<Event*>& chunk : chunks)
+                chunk.store(nullptr, std::memory_order_relaxed);
+        }
+
+        unsigned int id;
+        std::atomic<const char*> name;
+        std::atomic<unsigned long> generation; //trace of the events
+        std::atomic<std::size_t> count; //events published
+        std::array<std::atomic<Event*>, MAX_CHUNKS> chunks;
+    };
+
+    std::atomic<unsigned long> generation (0); //incremented by each trace
+    std::atomic<std::uint64_t> traceStart (0);
+    std::atomic<unsigned long> droppedCount (0);
+    std::atomic<std::int64_t> gpuOffset (0); //profiler clock minus GPU clock
+
+    /* Never shrinks: the buffers outlive their threads */
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+
+    ThreadBuffer& registerBuffer ()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.emplace_back(new ThreadBuffer(registry.size()));
+        return *registry.back();
+    }
+
+    /* The GPU track, first in the trace */
+    ThreadBuffer& getGpuBuffer ()
+    {
+        static ThreadBuffer& buffer = registerBuffer();
+        return buffer;
+    }
+
+    ThreadBuffer& getThreadBuffer ()
+    {
+        if (threadBuffer == nullptr) {
+            getGpuBuffer();
+            threadBuffer = &registerBuffer();
+        }
+        return *threadBuffer;
+    }
+
+    void append (ThreadBuffer& buffer, Event const& event)
+    {
+        /* Owner only: the buffer is reset lazily when a new trace begins */
+        unsigned long currentGeneration = generation.load(std::memory_order_acquire);
+        std::size_t count = buffer.count.load(std::memory_order_relaxed);
+        if (buffer.generation.load(std::memory_order_relaxed) != currentGeneration) {
+            count = 0;
+            buffer.count.store(0, std::memory_order_relaxed);
+            buffer.generation.store(currentGeneration, std::memory_order_release);
+        }
+
+        std::size_t chunkIndex = count / CHUNK_EVENTS;
+        if (chunkIndex >= MAX_CHUNKS) {
+            ++droppedCount;
+            return;
+        }
+
+        Event* chunk = buffer.chunks[chunkIndex].load(std::memory_order_relaxed);
+        if (chunk == nullptr) {
+            chunk = new Event[CHUNK_EVENTS];
+            buffer.chunks[chunkIndex].store(chunk, std::memory_order_release);
+        }
+
+        chunk[count % CHUNK_EVENTS] = event;
+        buffer.count.store(count + 1, std::memory_order_release);
+    }
+
+    void writeEscaped (std::ostream& stream, const char* text)
+    {
+        for ( ; *text != '\0' ; ++text) {
+            if (*text == '"' || *text == '\\')
+                stream << '\\' << *text;
+            else if (static_cast<unsigned char>(*text) >= 0x20)
+                stream << *text;
+        }
+    }
+
+    /* Microseconds from the start of the trace, to the nanosecond */
+    void writeTime (std::ostream& stream, std::int64_t nanoseconds)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", static_cast<double>(nanoseconds) * 1e-3);
+        stream << text;
+    }
+}
+
+void Profiler::setEnabled (bool enabled)
+{
+    if (enabled && !isEnabled()) {
+        traceStart.store(now(), std::memory_order_relaxed);
+        droppedCount.store(0, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName (const char* name)
+{
+    getThreadBuffer().name.store(name, std::memory_order_release);
+}
+
+void Profiler::record (const char* name, std::uint64_t begin, std::uint64_t end)
+{
+    Event event;
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    append(getThreadBuffer(), event);
+}
+
+void Profiler::synchronizeGpuClock ()
+{
+    if (!PassTimer::isAvailable())
+        return;
+
+    /* The query is synchronous: the profiler time is taken on both sides */
+    GLint64 gpuTime = 0;
+    std::uint64_t before = now();
+    GLCHECK(glGetInteger64v(GL_TIMESTAMP, &gpuTime));
+    std::uint64_t after = now();
+
+    std::int64_t cpuTime = before + (after - before) / 2;
+    gpuOffset.store(cpuTime - gpuTime, std::memory_order_relaxed);
+}
+
+void Profiler::recordGpu (const char* name, std::uint64_t gpuBegin, std::uint64_t gpuEnd)
+{
+    std::int64_t offset = gpuOffset.load(std::memory_order_relaxed);
+
+    Event event;
+    event.name = name;
+    event.begin = gpuBegin + offset;
+    event.end = gpuEnd + offset;
+    append(getGpuBuffer(), event);
+}
+
+unsigned long Profiler::getDroppedCount()
+{
+    return droppedCount;
+}
+
+void Profiler::exportTrace (std::string const& filePath)
+{
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("Profiler: unable to create " + filePath + ".");
+
+    getGpuBuffer();
+    unsigned long currentGeneration = generation.load(std::memory_order_acquire);
+    std::int64_t start = traceStart.load(std::memory_order_relaxed);
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (std::unique_ptr<ThreadBuffer> const& buffer : registry) {
+        /* Track name, even without events */
+        const char* name = buffer->name.load(std::memory_order_acquire);
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+             << ",\"args\":{\"name\":\"";
+        if (buffer.get() == &getGpuBuffer())
+            file << "GPU";
+        else if (name != nullptr)
+            writeEscaped(file, name);
+        else
+            file << "thread " << buffer->id;
+        file << "\"}}";
+        first = false;
+
+        if (buffer->generation.load(std::memory_order_acquire) != currentGeneration)
+            continue;
+
+        std::size_t count = buffer->count.load(std::memory_order_acquire);
+        for (std::size_t i = 0 ; i < count ; ++i) {
+            Event const& event = buffer->chunks[i / CHUNK_EVENTS].load(std::memory_order_acquire)[i % CHUNK_EVENTS];
+            file << ",\n{\"name\":\"";
+            writeEscaped(file, event.name);
+            file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+            writeTime(file, static_cast<std::int64_t>(event.begin) - start);
+            file << ",\"dur\":";
+            writeTime(file, static_cast<std::int64_t>(event.end - event.begin));
+            file << "}";
+        }
+    }
+
+    file << "\n]}\n";
+    if (!file)
+        throw std::runtime_error("Profiler: unable to write " + filePath + ".");
+}
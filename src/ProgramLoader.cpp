@@ -0,0 +1,325 @@
+#include "ProgramLoader.hpp"
+
+#include "GLHelper.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+
+namespace
+{
+    /* Cache file layout: this header, then the binary */
+    struct ProgramCacheHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t binaryFormat;
+        std::uint64_t key;
+        std::uint32_t length;
+        std::uint32_t reserved;
+    };
+
+    const char PROGRAM_CACHE_MAGIC[8] = {'W','A','T','E','R','P','R','G'};
+    const std::uint32_t PROGRAM_CACHE_VERSION = 1;
+
+    /* Fast to compile, replaced by the binary right away */
+    const char* STUB_FRAGMENT = "#version 130\nvoid main() {}\n";
+
+    bool areBinariesSupported ()
+    {
+        if (!GLEW_ARB_get_program_binary)
+            return false;
+
+        GLint nbFormats = 0;
+        GLCHECK(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats));
+        return nbFormats > 0;
+    }
+
+    /* FNV-1a */
+    std::uint64_t hashString (std::uint64_t hash, std::string const& string)
+    {
+        for (unsigned char byte : string) {
+            hash ^= byte;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    /* A driver update invalidates the binaries */
+    std::string getDriverString ()
+    {
+        std::string driver;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const GLubyte* value = nullptr;
+            GLCHECK(value = glGetString(name));
+            if (value != nullptr)
+                driver += reinterpret_cast<const char*>(value);
+            driver += "\n";
+        }
+        return driver;
+    }
+
+    GLuint compileShader (GLenum type, std::string const& source)
+    {
+        GLuint shaderID = 0;
+        GLCHECK(shaderID = glCreateShader(type));
+        const GLchar* sourcePtr = source.c_str();
+        GLCHECK(glShaderSource(shaderID, 1, &sourcePtr, nullptr));
+        GLCHECK(glCompileShader(shaderID));
+        return shaderID;
+    }
+
+    void printShaderLog (GLuint shaderID)
+    {
+        GLint length = 0;
+        GLCHECK(glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &length));
+        if (length > 1) {
+            std::vector<GLchar> log(length);
+            GLCHECK(glGetShaderInfoLog(shaderID, length, nullptr, log.data()));
+            std::cerr << log.data() << std::endl;
+        }
+    }
+
+    void printProgramLog (GLuint programID)
+    {
+        GLint length = 0;
+        GLCHECK(glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &length));
+        if (length > 1) {
+            std::vector<GLchar> log(length);
+            GLCHECK(glGetProgramInfoLog(programID, length, nullptr, log.data()));
+            std::cerr << log.data() << std::endl;
+        }
+    }
+}
+
+std::string ProgramLoader::_cacheDirectory;
+unsigned int ProgramLoader::_cacheHitsCount = 0;
+unsigned int ProgramLoader::_compiledCount = 0;
+
+void ProgramLoader::setCacheDirectory (std::string const& directory)
+{
+    _cacheDirectory = directory;
+    if (!_cacheDirectory.empty())
+        mkdir(_cacheDirectory.c_str(), 0755); //fails harmlessly if it exists
+}
+std::string const& ProgramLoader::getCacheDirectory()
+{
+    return _cacheDirectory;
+}
+
+unsigned int ProgramLoader::getCacheHitsCount()
+{
+    return _cacheHitsCount;
+}
+
+unsigned int ProgramLoader::getCompiledCount()
+{
+    return _compiledCount;
+}
+
+void ProgramLoader::add (sf::Shader& shader,
+                         std::string const& vertex,
+                         std::string const& fragment,
+                         std::string const& errorMessage)
+{
+    Program program;
+    program.shader = &shader;
+    program.vertex = vertex;
+    program.fragment = fragment;
+    program.errorMessage = errorMessage;
+    program.key = 0;
+    program.vertexID = 0;
+    program.fragmentID = 0;
+    program.programID = 0;
+    _programs.push_back(program);
+}
+
+void ProgramLoader::load ()
+{
+    std::vector<Program> programs;
+    programs.swap(_programs);
+
+    if (!areBinariesSupported()) {
+        for (Program const& program : programs) {
+            bool loaded = program.vertex.empty() ?
+                          program.shader->loadFromMemory(program.fragment, sf::Shader::Fragment) :
+                          program.shader->loadFromMemory(program.vertex, program.fragment);
+            if (!loaded) {
+                std::cerr << program.fragment << std::endl << std::endl;
+                throw std::runtime_error(program.errorMessage);
+            }
+            ++_compiledCount;
+        }
+        return;
+    }
+
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLEW_KHR_parallel_shader_compile) {
+        GLCHECK(glMaxShaderCompilerThreadsKHR(0xFFFFFFFF)); //as many as the driver wants
+    }
+#endif
+
+    std::uint64_t driverHash = hashString(14695981039346656037ull, getDriverString());
+
+    /* Every missing program is submitted before waiting for the first one */
+    std::vector<Program*> compiling;
+    for (Program& program : programs) {
+        program.key = hashString(hashString(driverHash, program.vertex + '\0'), program.fragment);
+        if (!loadFromCache(program)) {
+            startCompilation(program);
+            compiling.push_back(&program);
+        }
+    }
+
+    try {
+        for (Program* program : compiling)
+            finishCompilation(*program);
+    } catch (...) {
+        for (Program* program : compiling)
+            deleteObjects(*program);
+        throw;
+    }
+}
+
+bool ProgramLoader::loadFromCache (Program const& program) const
+{
+    if (_cacheDirectory.empty())
+        return false;
+
+    std::string path = getCachePath(program.key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    ProgramCacheHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PROGRAM_CACHE_VERSION || header.key != program.key)
+        return false;
+
+    std::vector<char> binary(header.length);
+    file.read(binary.data(), binary.size());
+    if (file && loadBinary(*program.shader, header.binaryFormat, binary.data(), header.length)) {
+        ++_cacheHitsCount;
+        return true;
+    }
+
+    /* Truncated, or rejected by the driver: it will be replaced */
+    file.close();
+    std::remove(path.c_str());
+    return false;
+}
+
+void ProgramLoader::startCompilation (Program& program) const
+{
+    GLCHECK(program.programID = glCreateProgram());
+
+    if (!program.vertex.empty()) {
+        program.vertexID = compileShader(GL_VERTEX_SHADER, program.vertex);
+        GLCHECK(glAttachShader(program.programID, program.vertexID));
+    }
+    program.fragmentID = compileShader(GL_FRAGMENT_SHADER, program.fragment);
+    GLCHECK(glAttachShader(program.programID, program.fragmentID));
+
+    GLCHECK(glProgramParameteri(program.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    GLCHECK(glLinkProgram(program.programID));
+}
+
+void ProgramLoader::finishCompilation (Program& program) const
+{
+    /* Blocks until this program is linked */
+    GLint linked = GL_FALSE;
+    GLCHECK(glGetProgramiv(program.programID, GL_LINK_STATUS, &linked));
+    if (linked != GL_TRUE) {
+        if (program.vertexID != 0)
+            printShaderLog(program.vertexID);
+        printShaderLog(program.fragmentID);
+        printProgramLog(program.programID);
+        std::cerr << program.fragment << std::endl << std::endl;
+        throw std::runtime_error(program.errorMessage);
+    }
+
+    GLint length = 0;
+    GLenum format = 0;
+    GLCHECK(glGetProgramiv(program.programID, GL_PROGRAM_BINARY_LENGTH, &length));
+    std::vector<char> binary(std::max(length, 0));
+    if (length > 0) {
+        GLCHECK(glGetProgramBinary(program.programID, length, &length, &format, binary.data()));
+    }
+    deleteObjects(program);
+
+    if (length <= 0 || !loadBinary(*program.shader, format, binary.data(), length)) {
+        /* Should not happen: the driver rejects its own binary */
+        bool loaded = program.vertex.empty() ?
+                      program.shader->loadFromMemory(program.fragment, sf::Shader::Fragment) :
+                      program.shader->loadFromMemory(program.vertex, program.fragment);
+        if (!loaded)
+            throw std::runtime_error(program.errorMessage);
+    } else if (!_cacheDirectory.empty()) {
+        ProgramCacheHeader header;
+        std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+        header.version = PROGRAM_CACHE_VERSION;
+        header.binaryFormat = format;
+        header.key = program.key;
+        header.length = length;
+        header.reserved = 0;
+
+        /* Written aside then renamed: another instance never reads half a file */
+        std::string path = getCachePath(program.key);
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(binary.data(), length);
+        }
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+            std::remove(temporaryPath.c_str());
+    }
+
+    ++_compiledCount;
+}
+
+void ProgramLoader::deleteObjects (Program& program)
+{
+    if (program.vertexID != 0) {
+        GLCHECK(glDeleteShader(program.vertexID));
+        program.vertexID = 0;
+    }
+    if (program.fragmentID != 0) {
+        GLCHECK(glDeleteShader(program.fragmentID));
+        program.fragmentID = 0;
+    }
+    if (program.programID != 0) {
+        GLCHECK(glDeleteProgram(program.programID));
+        program.programID = 0;
+    }
+}
+
+bool ProgramLoader::loadBinary (sf::Shader& shader, GLenum format, const void* binary, GLsizei length)
+{
+    /* sf::Shader can't adopt a program: it links a trivial one,
+     * whose content is then replaced by the binary */
+    if (!shader.loadFromMemory(STUB_FRAGMENT, sf::Shader::Fragment))
+        return false;
+
+    GLuint programID = getShaderHandle(shader);
+    GLCHECK(glProgramBinary(programID, format, binary, length));
+
+    GLint linked = GL_FALSE;
+    GLCHECK(glGetProgramiv(programID, GL_LINK_STATUS, &linked));
+    return linked == GL_TRUE;
+}
+
+std::string ProgramLoader::getCachePath (std::uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return _cacheDirectory + "/" + name;
+}
@@ -0,0 +1,176 @@
+#include "QualityGovernor.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+
+namespace
+{
+    /* Weight of a new frame in the smoothed times */
+    const float SMOOTHING = 0.1f;
+
+    /* Frames ignored after a change, while the timings settle */
+    const unsigned int SETTLE_FRAMES = 20;
+
+    /* Frames over budget before lowering a knob */
+    const unsigned int LOWER_FRAMES = 10;
+
+    /* Frames under budget before raising a knob, initially and at most */
+    const unsigned int RAISE_FRAMES = 120;
+    const unsigned int MAX_RAISE_FRAMES = 16 * RAISE_FRAMES;
+
+    /* A raise is allowed if its predicted cost keeps this share of the budget */
+    const float RAISE_MARGIN = 0.9f;
+
+    /* A knob lowered within these frames after being raised was raised too early */
+    const unsigned long BOUNCE_FRAMES = 600;
+}
+
+QualityGovernor::QualityGovernor (float targetTime, unsigned int passesCount):
+            _targetTime (targetTime),
+            _passTimes (passesCount, 0.f),
+            _averaged (false),
+            _frame (0),
+            _settleFrames (0),
+            _overBudgetFrames (0),
+            _underBudgetFrames (0)
+{
+}
+
+void QualityGovernor::setTargetTime (float targetTime)
+{
+    _targetTime = targetTime;
+    _overBudgetFrames = 0;
+    _underBudgetFrames = 0;
+}
+float QualityGovernor::getTargetTime() const
+{
+    return _targetTime;
+}
+
+unsigned int QualityGovernor::addKnob (unsigned int pass, unsigned int levelsCount, unsigned int level, float costFactor)
+{
+    if (pass >= _passTimes.size() || levelsCount == 0 || !(costFactor >= 1.f))
+        throw std::runtime_error("QualityGovernor: invalid knob");
+
+    Knob knob;
+    knob.pass = pass;
+    knob.levelsCount = levelsCount;
+    knob.level = std::min(level, levelsCount - 1);
+    knob.costFactor = costFactor;
+    knob.raiseDelay = RAISE_FRAMES;
+    knob.raisedAt = 0;
+    _knobs.push_back(knob);
+    return _knobs.size() - 1;
+}
+
+unsigned int QualityGovernor::getLevel (unsigned int knob) const
+{
+    return _knobs.at(knob).level;
+}
+
+std::vector<float> const& QualityGovernor::getPassTimes() const
+{
+    return _passTimes;
+}
+
+bool QualityGovernor::update (std::vector<float> const& passTimes)
+{
+    ++_frame;
+    if (passTimes.size() != _passTimes.size())
+        return false;
+
+    if (_settleFrames > 0) {
+        --_settleFrames;
+        return false;
+    }
+
+    for (unsigned int i = 0 ; i < _passTimes.size() ; ++i)
+        _passTimes[i] = _averaged ? _passTimes[i] + SMOOTHING * (passTimes[i] - _passTimes[i]) : passTimes[i];
+    _averaged = true;
+
+    float total = std::accumulate(_passTimes.begin(), _passTimes.end(), 0.f);
+
+    /* Passes from the most expensive to the cheapest */
+    std::vector<unsigned int> passes(_passTimes.size());
+    std::iota(passes.begin(), passes.end(), 0u);
+    std::sort(passes.begin(), passes.end(), [this](unsigned int a, unsigned int b) {
+        return _passTimes[a] > _passTimes[b];
+    });
+
+    /* Knobs whose raise would still fit, from the cheapest pass */
+    std::vector<int> raisable;
+    for (auto pass = passes.rbegin() ; pass != passes.rend() ; ++pass) {
+        int knob = selectKnob(*pass, true);
+        if (knob >= 0 && total + (_knobs[knob].costFactor - 1.f) * _passTimes[*pass] < RAISE_MARGIN * _targetTime)
+            raisable.push_back(knob);
+    }
+
+    if (total > _targetTime) {
+        ++_overBudgetFrames;
+        _underBudgetFrames = 0;
+    } else if (!raisable.empty()) {
+        ++_underBudgetFrames;
+        _overBudgetFrames = 0;
+    } else {
+        _overBudgetFrames = 0;
+        _underBudgetFrames = 0;
+    }
+
+    if (_overBudgetFrames >= LOWER_FRAMES) {
+        for (unsigned int pass : passes) {
+            int knob = selectKnob(pass, false);
+            if (knob >= 0) {
+                changeLevel(knob, false);
+                return true;
+            }
+        }
+    } else if (_underBudgetFrames > 0) {
+        for (int knob : raisable) {
+            if (_underBudgetFrames >= _knobs[knob].raiseDelay) {
+                changeLevel(knob, true);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+int QualityGovernor::selectKnob (unsigned int pass, bool raise) const
+{
+    int selected = -1;
+    for (unsigned int i = 0 ; i < _knobs.size() ; ++i) {
+        Knob const& knob = _knobs[i];
+        if (knob.pass != pass)
+            continue;
+
+        if (raise && knob.level + 1 < knob.levelsCount &&
+            (selected < 0 || knob.level < _knobs[selected].level)) {
+            selected = i;
+        } else if (!raise && knob.level > 0 &&
+                   (selected < 0 || knob.level > _knobs[selected].level)) {
+            selected = i;
+        }
+    }
+    return selected;
+}
+
+void QualityGovernor::changeLevel (unsigned int index, bool raise)
+{
+    Knob& knob = _knobs[index];
+    if (raise) {
+        ++knob.level;
+        knob.raisedAt = _frame;
+    } else {
+        --knob.level;
+        if (knob.raisedAt > 0 && _frame - knob.raisedAt < BOUNCE_FRAMES)
+            knob.raiseDelay = std::min(2 * knob.raiseDelay, MAX_RAISE_FRAMES);
+    }
+
+    _settleFrames = SETTLE_FRAMES;
+    _averaged = false;
+    _overBudgetFrames = 0;
+    _underBudgetFrames = 0;
+}
@@ -0,0 +1,215 @@
+#include "Recorder.hpp"
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+Recorder::Recorder (std::string const& filePath,
+                    sf::Vector2u size,
+                    RecordingContent content,
+                    unsigned int period,
+                    unsigned int keyframePeriod):
+            _size (size),
+            _content (content),
+            _period (std::max(1u, period)),
+            _keyframePeriod (std::max(1u, keyframePeriod)),
+            _hasRequested (false),
+            _lastRequestedStep (0),
+            _stop (false),
+            _recordedCount (0),
+            _droppedCount (0),
+            _file (filePath, std::ios::binary | std::ios::trunc),
+            _offset (0)
+{
+    if (!_file.is_open())
+        throw std::runtime_error("Recorder: unable to create " + filePath + ".");
+
+    RecordingHeader header;
+    std::memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.width = _size.x;
+    header.height = _size.y;
+    header.content = _content;
+    header.period = _period;
+    header.reserved = 0;
+
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _offset = sizeof(header);
+
+    _thread = std::thread(&Recorder::run, this);
+}
+
+Recorder::~Recorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_one();
+    _thread.join();
+
+    writeIndex();
+}
+
+void Recorder::update (Water const& water)
+{
+    if (_content == RecordingContent::Heightmap) {
+        update(water.getHeightmap(), water.getStep());
+    } else {
+        if (water.getStorage() != Water::Storage::Base256)
+            throw std::runtime_error("Recorder: only base 256 states can be recorded");
+
+        /* Once scrolled, the window starts at the origin modulo the grid size */
+        sf::Vector2i size(_size);
+        sf::Vector2i origin = water.getOrigin();
+        origin.x = ((origin.x % size.x) + size.x) % size.x;
+        origin.y = ((origin.y % size.y) + size.y) % size.y;
+        update(water.getState(), water.getStep(), sf::Vector2u(origin));
+    }
+}
+
+void Recorder::update (sf::Texture const& texture, unsigned long step, sf::Vector2u origin)
+{
+    /* Created lazily: it needs an OpenGL context */
+    if (!_readback)
+        _readback.reset(new AsyncReadback(_size));
+
+    /* Several steps may pass between two calls. A step going back
+     * (a checkpoint loaded) restarts the period. */
+    bool isDue = !_hasRequested || step >= _lastRequestedStep + _period || step < _lastRequestedStep;
+    if (isDue) {
+        _hasRequested = true;
+        _lastRequestedStep = step;
+        if (_readback->request(texture, step))
+            _pendingOrigins.push_back(std::make_pair(step, origin));
+        else
+            ++_droppedCount;
+    }
+
+    /* The copies are retrieved in the order of the requests */
+    unsigned long readStep = 0;
+    while (_readback->retrieve(_readbackPixels, readStep)) {
+        while (!_pendingOrigins.empty() && _pendingOrigins.front().first < readStep)
+            _pendingOrigins.pop_front();
+        sf::Vector2u readOrigin(0, 0);
+        if (!_pendingOrigins.empty() && _pendingOrigins.front().first == readStep) {
+            readOrigin = _pendingOrigins.front().second;
+            _pendingOrigins.pop_front();
+        }
+
+        record(std::move(_readbackPixels), readStep, readOrigin);
+        _readbackPixels.clear();
+    }
+}
+
+void Recorder::record (std::vector<std::uint8_t>&& pixels, unsigned long step, sf::Vector2u origin)
+{
+    if (pixels.size() != 4u * _size.x * _size.y)
+        throw std::runtime_error("Recorder: frame size mismatch");
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_queue.size() >= MAX_QUEUED_FRAMES) {
+            ++_droppedCount;
+            return;
+        }
+
+        Frame frame;
+        frame.pixels = std::move(pixels);
+        frame.step = step;
+        frame.origin = origin;
+        _queue.push_back(std::move(frame));
+    }
+    _condition.notify_one();
+}
+
+unsigned long Recorder::getRecordedCount() const
+{
+    return _recordedCount;
+}
+
+unsigned long Recorder::getDroppedCount() const
+{
+    return _droppedCount;
+}
+
+void Recorder::run()
+{
+    Profiler::setThreadName("recorder");
+
+    Frame frame;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]{ return _stop || !_queue.empty(); });
+
+            /* Pending frames are still written when stopping */
+            if (_queue.empty())
+                return;
+
+            frame = std::move(_queue.front());
+            _queue.pop_front();
+        }
+
+        if (frame.origin != sf::Vector2u(0, 0))
+            rotate(frame.pixels, frame.origin);
+        writeFrame(frame.pixels, frame.step);
+    }
+}
+
+void Recorder::rotate (std::vector<std::uint8_t>& pixels, sf::Vector2u origin)
+{
+    /* Each row of the window is the end of a texture row, then its start */
+    const std::size_t rowSize = 4u * _size.x;
+    const std::size_t headSize = 4u * origin.x;
+    _rotatedPixels.resize(pixels.size());
+    for (unsigned int iY = 0 ; iY < _size.y ; ++iY) {
+        const std::uint8_t* source = pixels.data() + ((iY + origin.y) % _size.y) * rowSize;
+        std::uint8_t* destination = _rotatedPixels.data() + iY * rowSize;
+        std::memcpy(destination, source + headSize, rowSize - headSize);
+        std::memcpy(destination + rowSize - headSize, source, headSize);
+    }
+    pixels.swap(_rotatedPixels);
+}
+
+void Recorder::writeFrame (std::vector<std::uint8_t> const& pixels, unsigned long step)
+{
+    PROFILE_ZONE("Recorder::writeFrame");
+    bool isKeyframe = (_index.size() % _keyframePeriod == 0);
+    encodeFrame(pixels.data(), isKeyframe ? nullptr : _previousPixels.data(),
+                _size.x * _size.y, _encoded);
+
+    RecordingFrameHeader header;
+    header.step = step;
+    header.isKeyframe = isKeyframe ? 1 : 0;
+    header.encodedSize = _encoded.size();
+
+    RecordingIndexEntry entry;
+    entry.step = step;
+    entry.offset = _offset;
+    entry.isKeyframe = header.isKeyframe;
+    entry.reserved = 0;
+    _index.push_back(entry);
+
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _file.write(reinterpret_cast<const char*>(_encoded.data()), _encoded.size());
+    _offset += sizeof(header) + _encoded.size();
+
+    _previousPixels = pixels;
+    ++_recordedCount;
+}
+
+void Recorder::writeIndex ()
+{
+    RecordingTrailer trailer;
+    trailer.indexOffset = _offset;
+    trailer.framesCount = _index.size();
+    std::memcpy(trailer.magic, RECORDING_INDEX_MAGIC, sizeof(trailer.magic));
+
+    _file.write(reinterpret_cast<const char*>(_index.data()), _index.size() * sizeof(RecordingIndexEntry));
+    _file.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    _file.close();
+}
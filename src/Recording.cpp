@@ -0,0 +1,107 @@
+#include "Recording.hpp"
+
+
+const char RECORDING_MAGIC[8] = {'W','A','T','E','R','R','E','C'};
+const char RECORDING_INDEX_MAGIC[8] = {'W','A','T','E','R','I','D','X'};
+
+namespace
+{
+    /* Run-length codec. A control byte c is followed by:
+     * - if c < 128: c+1 literal bytes
+     * - otherwise: one byte repeated c-126 times (2 to 129) */
+    const std::size_t MAX_LITERALS = 128;
+    const std::size_t MAX_RUN = 129;
+
+    /* Runs shorter than this are cheaper as literals */
+    const std::size_t MIN_ENCODED_RUN = 3;
+
+    void flushLiterals (std::vector<std::uint8_t> const& input,
+                        std::size_t begin, std::size_t end,
+                        std::vector<std::uint8_t>& output)
+    {
+        if (end > begin) {
+            output.push_back(static_cast<std::uint8_t>(end - begin - 1));
+            output.insert(output.end(), input.begin() + begin, input.begin() + end);
+        }
+    }
+
+    void encodeRuns (std::vector<std::uint8_t> const& input,
+                     std::vector<std::uint8_t>& output)
+    {
+        std::size_t i = 0;
+        std::size_t literalsStart = 0;
+
+        while (i < input.size()) {
+            std::size_t runLength = 1;
+            while (i + runLength < input.size() && runLength < MAX_RUN && input[i + runLength] == input[i])
+                ++runLength;
+
+            if (runLength >= MIN_ENCODED_RUN) {
+                flushLiterals(input, literalsStart, i, output);
+                output.push_back(static_cast<std::uint8_t>(runLength + 126));
+                output.push_back(input[i]);
+                i += runLength;
+                literalsStart = i;
+            } else {
+                ++i;
+                if (i - literalsStart == MAX_LITERALS) {
+                    flushLiterals(input, literalsStart, i, output);
+                    literalsStart = i;
+                }
+            }
+        }
+
+        flushLiterals(input, literalsStart, input.size(), output);
+    }
+}
+
+void encodeFrame (const std::uint8_t* pixels,
+                  const std::uint8_t* previous,
+                  std::size_t pixelsCount,
+                  std::vector<std::uint8_t>& encoded)
+{
+    /* Planar delta: strong and weak digits are kept apart */
+    std::vector<std::uint8_t> planes(4 * pixelsCount);
+    for (std::size_t plane = 0 ; plane < 4 ; ++plane) {
+        std::uint8_t* destination = planes.data() + plane*pixelsCount;
+        for (std::size_t i = 0 ; i < pixelsCount ; ++i) {
+            std::uint8_t reference = (previous != nullptr) ? previous[4*i + plane] : 0;
+            destination[i] = pixels[4*i + plane] - reference;
+        }
+    }
+
+    encoded.clear();
+    encodeRuns(planes, encoded);
+}
+
+bool decodeFrame (const std::uint8_t* encoded,
+                  std::size_t encodedSize,
+                  const std::uint8_t* previous,
+                  std::size_t pixelsCount,
+                  std::uint8_t* pixels)
+{
+    std::size_t total = 4 * pixelsCount;
+    std::size_t in = 0, out = 0;
+
+    while (in < encodedSize && out < total) {
+        std::size_t control = encoded[in++];
+        bool isRun = control >= 128;
+        std::size_t count = isRun ? control - 126 : control + 1;
+        std::size_t inputCount = isRun ? 1 : count;
+        if (out + count > total || in + inputCount > encodedSize)
+            return false;
+
+        for (std::size_t k = 0 ; k < count ; ++k, ++out) {
+            std::uint8_t delta = isRun ? encoded[in] : encoded[in + k];
+
+            /* Back from planar to interleaved */
+            std::size_t plane = out / pixelsCount;
+            std::size_t index = 4 * (out % pixelsCount) + plane;
+            std::uint8_t reference = (previous != nullptr) ? previous[index] : 0;
+            pixels[index] = reference + delta;
+        }
+        in += inputCount;
+    }
+
+    return out == total && in == encodedSize;
+}
@@ -0,0 +1,105 @@
+#include "RecordingReader.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+
+RecordingReader::RecordingReader (std::string const& filePath):
+            _file (filePath),
+            _decodedFrame (0),
+            _hasDecodedFrame (false)
+{
+    RecordingTrailer trailer;
+    if (_file.getSize() < sizeof(_header) + sizeof(trailer))
+        throw std::runtime_error("RecordingReader: " + filePath + " is truncated.");
+
+    std::memcpy(&_header, _file.getData(), sizeof(_header));
+    std::memcpy(&trailer, _file.getData() + _file.getSize() - sizeof(trailer), sizeof(trailer));
+
+    if (std::memcmp(_header.magic, RECORDING_MAGIC, sizeof(_header.magic)) != 0)
+        throw std::runtime_error("RecordingReader: " + filePath + " is not a recording.");
+    if (_header.version != RECORDING_VERSION)
+        throw std::runtime_error("RecordingReader: " + filePath + " has an unsupported version.");
+    if (std::memcmp(trailer.magic, RECORDING_INDEX_MAGIC, sizeof(trailer.magic)) != 0)
+        throw std::runtime_error("RecordingReader: " + filePath + " has no index (unfinished recording?).");
+
+    std::uint64_t indexSize = trailer.framesCount * sizeof(RecordingIndexEntry);
+    if (trailer.indexOffset + indexSize + sizeof(trailer) != _file.getSize())
+        throw std::runtime_error("RecordingReader: " + filePath + " has a corrupted index.");
+
+    /* Copied: the index may not be aligned in the file */
+    _index.resize(trailer.framesCount);
+    std::memcpy(_index.data(), _file.getData() + trailer.indexOffset, indexSize);
+    _pixels.resize(4 * _header.width * _header.height);
+}
+
+sf::Vector2u RecordingReader::getSize() const
+{
+    return sf::Vector2u(_header.width, _header.height);
+}
+
+RecordingContent RecordingReader::getContent() const
+{
+    return _header.content;
+}
+
+unsigned int RecordingReader::getPeriod() const
+{
+    return _header.period;
+}
+
+std::size_t RecordingReader::getFramesCount() const
+{
+    return _index.size();
+}
+
+unsigned long RecordingReader::getStep (std::size_t frame) const
+{
+    return _index[frame].step;
+}
+
+void RecordingReader::readFrame (std::size_t frame, std::vector<std::uint8_t>& pixels)
+{
+    if (frame >= _index.size())
+        throw std::runtime_error("RecordingReader: no such frame");
+
+    /* Decoding starts from the preceding keyframe,
+     * or from the last decoded frame if it is closer */
+    std::size_t first = frame;
+    while (!_index[first].isKeyframe && first > 0)
+        --first;
+    if (_hasDecodedFrame && _decodedFrame >= first && _decodedFrame <= frame)
+        first = _decodedFrame + 1;
+
+    for (std::size_t current = first ; current <= frame ; ++current)
+        decode(current);
+
+    pixels = _pixels;
+}
+
+void RecordingReader::decode (std::size_t frame)
+{
+    RecordingIndexEntry const& entry = _index[frame];
+    if (entry.offset + sizeof(RecordingFrameHeader) > _file.getSize())
+        throw std::runtime_error("RecordingReader: corrupted frame");
+
+    RecordingFrameHeader header;
+    std::memcpy(&header, _file.getData() + entry.offset, sizeof(header));
+    const std::uint8_t* encoded = _file.getData() + entry.offset + sizeof(header);
+    if (entry.offset + sizeof(header) + header.encodedSize > _file.getSize())
+        throw std::runtime_error("RecordingReader: corrupted frame");
+
+    _previousPixels.swap(_pixels);
+    _pixels.resize(_previousPixels.size());
+
+    bool success = decodeFrame(encoded, header.encodedSize,
+                               header.isKeyframe ? nullptr : _previousPixels.data(),
+                               _header.width * _header.height, _pixels.data());
+    if (!success) {
+        _hasDecodedFrame = false;
+        throw std::runtime_error("RecordingReader: corrupted frame");
+    }
+
+    _decodedFrame = frame;
+    _hasDecodedFrame = true;
+}
@@ -1,7 +1,9 @@
 #include "Renderer2D.hpp"
 
 #include "GLHelper.hpp"
-#include "Utilities.hpp"
+#include "ProgramLoader.hpp"
+#include "Profiler.hpp"
+#include "ShaderSources.hpp"
 
 #include <iostream>
 #include <stdexcept>
@@ -17,16 +19,10 @@ Renderer2D::Renderer2D(float amplitude,
             _cornersBufferID(-1)
 {
     /* Shaders loading */
-    std::string fragment, vertex, utils;
-    loadFile("shaders/utils.glsl", utils);
-
-    loadFile("shaders/display2D.frag", fragment);
-    loadFile("shaders/display2D.vert", vertex);
-    searchAndReplace("__UTILS__", utils, fragment);
-    if (!_displayShader.loadFromMemory(vertex, fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("Renderer2D: unable to load shader");
-    }
+    ProgramLoader loader;
+    loader.add(_displayShader, getShaderSource("display2D.vert"), getShaderSource("display2D.frag"),
+               "Renderer2D: unable to load shader");
+    loader.load();
 
     /* Buffer allocation */
     std::vector<glm::vec2> corners(6);
@@ -54,6 +50,7 @@ Renderer2D::~Renderer2D()
 void Renderer2D::draw (sf::Texture const& heightmap,
                            sf::Texture const& groundTexture) const
 {
+    PROFILE_SECTIONS("Renderer2D::draw parameters");
     GLCHECK(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
     _displayShader.setParameter("heightmap", heightmap);
@@ -94,11 +91,13 @@ void Renderer2D::draw (sf::Texture const& heightmap,
     GLCHECK(glUniform3f(lightDirULoc, getLightDirection().x, getLightDirection().y, getLightDirection().z));
 
     /* Enabling corners coordinates buffer */
+    PROFILE_NEXT_SECTION("Renderer2D::draw buffers");
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _cornersBufferID));
     GLCHECK(glEnableVertexAttribArray(cornerALoc));
     GLCHECK(glVertexAttribPointer(cornerALoc, 2, GL_FLOAT, GL_FALSE, 0, (void*)0));
 
     /*Actual drawing */
+    PROFILE_NEXT_SECTION("Renderer2D::draw call");
     GLCHECK(glDisable(GL_CULL_FACE));
     GLCHECK(glDisable(GL_DEPTH_TEST));
     GLCHECK(glDisable(GL_BLEND));
@@ -1,7 +1,9 @@
 #include "Renderer3D.hpp"
 
 #include "GLHelper.hpp"
-#include "Utilities.hpp"
+#include "ProgramLoader.hpp"
+#include "Profiler.hpp"
+#include "ShaderSources.hpp"
 
 #include <iostream>
 #include <stdexcept>
@@ -23,49 +25,14 @@ Renderer3D::Renderer3D(unsigned int quality,
             _camera(glm::vec3(0.5,0.5,0.25))
 {
     /* Shaders loading */
-    std::string fragment, vertex, utils;
-    loadFile("shaders/utils.glsl", utils);
-
-    loadFile("shaders/display3DSurface.frag", fragment);
-    loadFile("shaders/display3DSurface.vert", vertex);
-    searchAndReplace("__UTILS__", utils, fragment);
-    searchAndReplace("__UTILS__", utils, vertex);
-    if (!_displaySurfaceShader.loadFromMemory(vertex, fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("Renderer3D: unable to load 3D surface display shader");
-    }
-
-    loadFile("shaders/display3DCube.frag", fragment);
-    loadFile("shaders/display3DCube.vert", vertex);
-    searchAndReplace("__UTILS__", utils, fragment);
-    searchAndReplace("__UTILS__", utils, vertex);
-    if (!_displayCubeShader.loadFromMemory(vertex, fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("Renderer3D: unable to load 3D cube display shader");
-    }
+    ProgramLoader loader;
+    loader.add(_displaySurfaceShader, getShaderSource("display3DSurface.vert"), getShaderSource("display3DSurface.frag"),
+               "Renderer3D: unable to load 3D surface display shader");
+    loader.add(_displayCubeShader, getShaderSource("display3DCube.vert"), getShaderSource("display3DCube.frag"),
+               "Renderer3D: unable to load 3D cube display shader");
+    loader.load();
 
 
-    /* Computing grid vertices */
-    int nbPtX = _surfaceGridSize.x, nbPtY = _surfaceGridSize.y;
-    float stepX = 1.f / static_cast<float>(nbPtX-1), stepY = 1.f / static_cast<float>(nbPtY-1);
-    std::vector<glm::vec2> positions(nbPtX * nbPtY);
-    for (int iX = 0 ; iX < nbPtX ; ++iX) {
-        for (int iY = 0 ; iY < nbPtY ; ++iY) {
-            int index = iX*nbPtY + iY;
-            positions[index].x = static_cast<float>(iX) * stepX;
-            positions[index].y = static_cast<float>(iY) * stepY;
-        }
-    }
-
-    std::vector<glm::ivec3> indexes(2 * (nbPtX-1) * (nbPtY-1));
-    for (int iX = 0 ; iX < nbPtX-1 ; ++iX) {
-        for (int iY = 0 ; iY < nbPtY-1 ; ++iY) {
-            int index = iX*(nbPtY-1) + iY;
-            indexes[2*index+0] = glm::ivec3(iX,iX,iX+1)*nbPtY + glm::ivec3(iY+1, iY, iY);
-            indexes[2*index+1] = glm::ivec3(iX,iX+1,iX+1)*nbPtY + glm::ivec3(iY+1, iY, iY+1);
-        }
-    }
-
     /* Computing cube vertices */
     std::vector<glm::vec3> cubeVertices, cubeNormals;
     computeCube(cubeVertices, cubeNormals);
@@ -77,17 +44,13 @@ Renderer3D::Renderer3D(unsigned int quality,
     GLCHECK(glGenBuffers(1, &_cubeVertBufferID));
     GLCHECK(glGenBuffers(1, &_cubeNormBufferID));
 
-    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _surfaceGridPosBufferID));
-    GLCHECK(glBufferData(GL_ARRAY_BUFFER, positions.size()*sizeof(glm::vec2), positions.data(), GL_STATIC_DRAW));
-    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _surfaceGridIndexBufferID));
-    GLCHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexes.size()*sizeof(glm::ivec3), indexes.data(), GL_STATIC_DRAW));
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _cubeVertBufferID));
     GLCHECK(glBufferData(GL_ARRAY_BUFFER, cubeVertices.size()*sizeof(glm::vec3), cubeVertices.data(), GL_STATIC_DRAW));
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _cubeNormBufferID));
     GLCHECK(glBufferData(GL_ARRAY_BUFFER, cubeNormals.size()*sizeof(glm::ivec3), cubeNormals.data(), GL_STATIC_DRAW));
-
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
-    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+
+    computeSurfaceGrid();
 }
 
 Renderer3D::~Renderer3D()
@@ -107,10 +70,57 @@ Renderer3D::~Renderer3D()
     }
 }
 
+void Renderer3D::setQuality (unsigned int quality)
+{
+    quality = std::max(2u, quality);
+    if (quality == _surfaceGridSize.x && quality == _surfaceGridSize.y)
+        return;
+
+    _surfaceGridSize = sf::Vector2u(quality, quality);
+    computeSurfaceGrid();
+}
+unsigned int Renderer3D::getQuality() const
+{
+    return _surfaceGridSize.x;
+}
+
+void Renderer3D::computeSurfaceGrid ()
+{
+    /* Computing grid vertices */
+    int nbPtX = _surfaceGridSize.x, nbPtY = _surfaceGridSize.y;
+    float stepX = 1.f / static_cast<float>(nbPtX-1), stepY = 1.f / static_cast<float>(nbPtY-1);
+    std::vector<glm::vec2> positions(nbPtX * nbPtY);
+    for (int iX = 0 ; iX < nbPtX ; ++iX) {
+        for (int iY = 0 ; iY < nbPtY ; ++iY) {
+            int index = iX*nbPtY + iY;
+            positions[index].x = static_cast<float>(iX) * stepX;
+            positions[index].y = static_cast<float>(iY) * stepY;
+        }
+    }
+
+    std::vector<glm::ivec3> indexes(2 * (nbPtX-1) * (nbPtY-1));
+    for (int iX = 0 ; iX < nbPtX-1 ; ++iX) {
+        for (int iY = 0 ; iY < nbPtY-1 ; ++iY) {
+            int index = iX*(nbPtY-1) + iY;
+            indexes[2*index+0] = glm::ivec3(iX,iX,iX+1)*nbPtY + glm::ivec3(iY+1, iY, iY);
+            indexes[2*index+1] = glm::ivec3(iX,iX+1,iX+1)*nbPtY + glm::ivec3(iY+1, iY, iY+1);
+        }
+    }
+
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _surfaceGridPosBufferID));
+    GLCHECK(glBufferData(GL_ARRAY_BUFFER, positions.size()*sizeof(glm::vec2), positions.data(), GL_STATIC_DRAW));
+    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _surfaceGridIndexBufferID));
+    GLCHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexes.size()*sizeof(glm::ivec3), indexes.data(), GL_STATIC_DRAW));
+
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    GLCHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+}
+
 void Renderer3D::draw (sf::Texture const& heightmap,
                            sf::Texture const& groundTexture,
                            sf::Texture const& lightsTexture) const
 {
+    PROFILE_ZONE("Renderer3D::draw");
     GLCHECK(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
     drawSurface(heightmap, groundTexture, lightsTexture);
@@ -126,6 +136,7 @@ void Renderer3D::drawSurface (sf::Texture const& heightmap,
                                   sf::Texture const& groundTexture,
                                   sf::Texture const& lightsTexture) const
 {
+    PROFILE_SECTIONS("Renderer3D::drawSurface parameters");
     glm::vec3 eyePos = _camera.getPosition();
     glm::mat4 MVP = _camera.getMatrix();
 
@@ -172,11 +183,13 @@ void Renderer3D::drawSurface (sf::Texture const& heightmap,
     GLCHECK(glUniform3f(lightDirULoc, getLightDirection().x, getLightDirection().y, getLightDirection().z));
 
     /* Enabling corners coordinates buffer */
+    PROFILE_NEXT_SECTION("Renderer3D::drawSurface buffers");
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _surfaceGridPosBufferID));
     GLCHECK(glEnableVertexAttribArray(coordsALoc));
     GLCHECK(glVertexAttribPointer(coordsALoc, 2, GL_FLOAT, GL_FALSE, 0, (void*)0));
 
     /*Actual drawing */
+    PROFILE_NEXT_SECTION("Renderer3D::drawSurface call");
     GLCHECK(glEnable(GL_CULL_FACE));
     GLCHECK(glEnable(GL_DEPTH_TEST));
     GLCHECK(glDisable(GL_BLEND));
@@ -194,6 +207,7 @@ void Renderer3D::drawCube (sf::Texture const& heightmap,
                                sf::Texture const& groundTexture,
                                sf::Texture const& lightsTexture) const
 {
+    PROFILE_SECTIONS("Renderer3D::drawCube parameters");
     glm::vec3 eyePos = _camera.getPosition();
     glm::mat4 MVP = _camera.getMatrix();
 
@@ -239,6 +253,7 @@ void Renderer3D::drawCube (sf::Texture const& heightmap,
     GLCHECK(glUniform3f(lightDirULoc, getLightDirection().x, getLightDirection().y, getLightDirection().z));
 
     /* Enabling coordinates buffer */
+    PROFILE_NEXT_SECTION("Renderer3D::drawCube buffers");
     GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _cubeVertBufferID));
     GLCHECK(glEnableVertexAttribArray(vertexALoc));
     GLCHECK(glVertexAttribPointer(vertexALoc, 3, GL_FLOAT, GL_FALSE, 0, (void*)0));
@@ -249,6 +264,7 @@ void Renderer3D::drawCube (sf::Texture const& heightmap,
     GLCHECK(glVertexAttribPointer(normalALoc, 3, GL_FLOAT, GL_FALSE, 0, (void*)0));
 
 //    /*Actual drawing */
+    PROFILE_NEXT_SECTION("Renderer3D::drawCube call");
     GLCHECK(glEnable(GL_CULL_FACE));
     GLCHECK(glEnable(GL_DEPTH_TEST));
     GLCHECK(glDisable(GL_BLEND));
@@ -0,0 +1,70 @@
+#include "ReplayDriver.hpp"
+
+
+ReplayDriver::ReplayDriver (InputJournal const& journal,
+                            Water& water,
+                            Camera* camera):
+            _journal (journal),
+            _water (water),
+            _camera (camera),
+            _nextEvent (0)
+{
+}
+
+void ReplayDriver::step()
+{
+    std::vector<InputJournal::Event> const& events = _journal.getEvents();
+
+    /* Batched like in the recorded session: until the update, or an input
+     * that can't be batched with them */
+    std::vector<Water::Touch> touches;
+    auto flushTouches = [&] () {
+        if (!touches.empty()) {
+            _water.touch(touches);
+            touches.clear();
+        }
+    };
+
+    while (_nextEvent < events.size() && events[_nextEvent].step <= _water.getStep()) {
+        InputJournal::Event const& event = events[_nextEvent];
+
+        switch (event.type) {
+            case InputJournal::Event::Type::Touch:
+                touches.push_back({sf::Vector2f(event.values[0], event.values[1]), event.values[2], event.values[3]});
+                if (_journal.getVersion() < 2)
+                    flushTouches();
+                break;
+            case InputJournal::Event::Type::Init:
+                flushTouches();
+                _water.init();
+                break;
+            case InputJournal::Event::Type::Camera:
+                if (_camera != nullptr) {
+                    _camera->setDistance(event.values[0]);
+                    _camera->setLatitude(event.values[1]);
+                    _camera->setLongitude(event.values[2]);
+                }
+                break;
+            case InputJournal::Event::Type::Scroll:
+                flushTouches();
+                _water.scroll(sf::Vector2i(static_cast<int>(event.values[0]), static_cast<int>(event.values[1])));
+                break;
+        }
+
+        ++_nextEvent;
+    }
+
+    flushTouches();
+    _water.update(_journal.getSettings().timestep);
+}
+
+bool ReplayDriver::isOver() const
+{
+    return _nextEvent >= _journal.getEvents().size();
+}
+
+unsigned long ReplayDriver::getLastStep() const
+{
+    std::vector<InputJournal::Event> const& events = _journal.getEvents();
+    return events.empty() ? 0 : events.back().step;
+}
@@ -0,0 +1,60 @@
+#include "ShaderSources.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+
+std::string getShaderVariantKey (ShaderDefines const& defines)
+{
+    /* std::map is sorted: the key does not depend on the insertion order */
+    std::string key;
+    for (auto const& define : defines) {
+        if (!key.empty())
+            key += ";";
+
+        key += define.first;
+        if (!define.second.empty())
+            key += "=" + define.second;
+    }
+    return key;
+}
+
+std::string getShaderSource (std::string const& name,
+                             ShaderDefines const& defines)
+{
+    const char* embedded = nullptr;
+    for (std::size_t i = 0 ; i < EMBEDDED_SHADERS_COUNT ; ++i) {
+        if (name == EMBEDDED_SHADERS[i].name) {
+            embedded = EMBEDDED_SHADERS[i].source;
+            break;
+        }
+    }
+    if (embedded == nullptr)
+        throw std::runtime_error("unable to find shader " + name + ".");
+
+    std::string source(embedded);
+    if (defines.empty())
+        return source;
+
+    /* The #version directive must come first */
+    std::string::size_type insertPos = 0;
+    if (std::strncmp(embedded, "#version", 8) == 0) {
+        insertPos = source.find('\n');
+        insertPos = (insertPos == std::string::npos) ? source.size() : insertPos + 1;
+    }
+
+    std::ostringstream directives;
+    for (auto const& define : defines) {
+        directives << "#define " << define.first;
+        if (!define.second.empty())
+            directives << " " << define.second;
+        directives << "\n";
+    }
+
+    /* Keeps the line numbers of the compilation errors right */
+    directives << "#line " << ((insertPos == 0) ? 1 : 2) << " 0\n";
+
+    source.insert(insertPos, directives.str());
+    return source;
+}
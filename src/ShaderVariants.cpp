@@ -0,0 +1,37 @@
+#include "ShaderVariants.hpp"
+
+#include "ProgramLoader.hpp"
+
+
+ShaderVariants::ShaderVariants (std::string const& vertexName,
+                                std::string const& fragmentName):
+            _vertexName (vertexName),
+            _fragmentName (fragmentName)
+{
+}
+
+sf::Shader& ShaderVariants::get (ShaderDefines const& defines)
+{
+    std::string key = getShaderVariantKey(defines);
+
+    auto variant = _variants.find(key);
+    if (variant != _variants.end())
+        return *variant->second;
+
+    std::unique_ptr<sf::Shader> shader(new sf::Shader());
+    ProgramLoader loader;
+    loader.add(*shader,
+               _vertexName.empty() ? std::string() : getShaderSource(_vertexName, defines),
+               getShaderSource(_fragmentName, defines),
+               "ShaderVariants: unable to load " + _fragmentName + " (" + key + ")");
+    loader.load();
+
+    sf::Shader& result = *shader;
+    _variants[key] = std::move(shader);
+    return result;
+}
+
+unsigned int ShaderVariants::getCompiledCount() const
+{
+    return _variants.size();
+}
@@ -0,0 +1,12 @@
+#include "SharedHeightmap.hpp"
+
+
+const char SHARED_HEIGHTMAP_MAGIC[8] = {'W','A','T','E','R','S','H','M'};
+const char SHARED_HEIGHTMAP_NAME[] = "/water-heightmap";
+
+std::uint64_t getSharedHeightmapSlotSize (std::uint32_t width, std::uint32_t height)
+{
+    const std::uint64_t alignment = SHARED_HEIGHTMAP_SLOTS_OFFSET;
+    std::uint64_t size = sizeof(SharedHeightmapSlot) + 4ull * width * height;
+    return (size + alignment - 1) / alignment * alignment;
+}
@@ -0,0 +1,84 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+
+ThreadPool::ThreadPool (unsigned int threadsCount):
+            _stop (false),
+            _generation (0),
+            _busyThreads (0),
+            _task (nullptr),
+            _tasksCount (0),
+            _nextTask (0)
+{
+    if (threadsCount == 0)
+        threadsCount = std::max(1u, std::thread::hardware_concurrency());
+
+    /* The thread 0 is the calling one */
+    for (unsigned int i = 1 ; i < threadsCount ; ++i)
+        _threads.emplace_back(&ThreadPool::wait, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _startCondition.notify_all();
+    for (std::thread& thread : _threads)
+        thread.join();
+}
+
+unsigned int ThreadPool::getThreadsCount() const
+{
+    return _threads.size() + 1;
+}
+
+void ThreadPool::run (unsigned int tasksCount, std::function<void(unsigned int, unsigned int)> const& task)
+{
+    if (tasksCount == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _tasksCount = tasksCount;
+        _nextTask = 0;
+        _busyThreads = _threads.size();
+        ++_generation;
+    }
+    _startCondition.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [this]{ return _busyThreads == 0; });
+    _task = nullptr;
+}
+
+void ThreadPool::work (unsigned int thread)
+{
+    for (unsigned int index = _nextTask++ ; index < _tasksCount ; index = _nextTask++)
+        (*_task)(index, thread);
+}
+
+void ThreadPool::wait (unsigned int thread)
+{
+    unsigned long generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _startCondition.wait(lock, [&]{ return _stop || _generation != generation; });
+            if (_stop)
+                return;
+            generation = _generation;
+        }
+
+        work(thread);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_busyThreads == 0)
+            _doneCondition.notify_one();
+    }
+}
@@ -1,29 +1,90 @@
 #include "Water.hpp"
 
-#include "Utilities.hpp"
+#include "FixedPointWater.hpp"
 #include "GLHelper.hpp"
+#include "MappedFile.hpp"
+#include "ProgramLoader.hpp"
+#include "Profiler.hpp"
+#include "ShaderSources.hpp"
 
 #include <stdexcept>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 
 #include <SFML/Graphics/RectangleShape.hpp>
 #include <SFML/Graphics/Sprite.hpp>
 
 
-Water::Water(sf::Vector2u dimensions, float propagation, float friction, float elasticity):
+namespace
+{
+    /* Checkpoint file layout: this header, then the pixels (RGBA,
+     * bottom row first, bytes or floats depending on the storage)
+     * of buffer 0 followed by those of buffer 1.
+     * Values are stored in the machine's native byte order. */
+    struct CheckpointHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t currentIndex;
+        std::uint64_t step;
+        float friction;
+        float propagation;
+        float elasticity;
+        std::uint32_t storage; //0 for Base256, 1 for Float
+        std::int32_t originX; //since version 2
+        std::int32_t originY;
+    };
+    static_assert(sizeof(CheckpointHeader) == 56, "unexpected checkpoint header padding");
+
+    const char CHECKPOINT_MAGIC[8] = {'W','A','T','E','R','C','K','P'};
+    const std::uint32_t CHECKPOINT_VERSION = 2;
+    const std::size_t CHECKPOINT_V1_HEADER_SIZE = 48; //without origin
+
+    /* Modulo with a positive result */
+    int wrap (int value, int size)
+    {
+        int result = value % size;
+        return (result < 0) ? result + size : result;
+    }
+
+    /* Origin of the window in textures of the given size, normalized */
+    sf::Vector2f toTextureOrigin (sf::Vector2i origin, sf::Vector2u size)
+    {
+        sf::Vector2i sizeI(size);
+        return sf::Vector2f(static_cast<float>(wrap(origin.x, sizeI.x)) / static_cast<float>(size.x),
+                            static_cast<float>(wrap(origin.y, sizeI.y)) / static_cast<float>(size.y));
+    }
+}
+
+Water::Water(sf::Vector2u dimensions, float propagation, float friction, float elasticity, Storage storage):
             _friction (friction),
             _propagation (propagation),
             _elasticity (elasticity),
-            _currentIndex (0)
+            _currentIndex (0),
+            _step (0),
+            _origin (0, 0),
+            _storage (storage),
+            _stencil (Stencil::FivePoint),
+            _boundary (Boundary::Clamp),
+            _arithmetic (Arithmetic::Float),
+            _forcing (nullptr),
+            _forcingWeights (0.f, 0.f),
+            _updateShaders ("", "update.frag"),
+            _updateShader (nullptr),
+            _generateHeightmapShaders ("", "generateHeightmap.frag"),
+            _generateHeightmapShader (nullptr),
+            _probesBufferID (-1)
 {
     /* Textures allocation */
-    for (sf::RenderTexture& renderTexture : _buffers) {
-        if (!renderTexture.create(dimensions.x, dimensions.y)) {
-            throw std::runtime_error("Water: unable to create position buffer");
-        }
-        renderTexture.setSmooth(true);
-    }
+    createBuffers(dimensions);
 
     if (!_heightmap.create(256,256)) {
             throw std::runtime_error("Water: unable to create position buffer");
@@ -31,42 +92,29 @@ Water::Water(sf::Vector2u dimensions, float propagation, float friction, float e
     _heightmap.setSmooth(true);
 
     /* Shaders loading */
-    std::string fragment, vertex, utils;
-    loadFile("shaders/utils.glsl", utils);
+    ProgramLoader loader;
+    loader.add(_initShader, "", getShaderSource("init.frag", getStorageDefines()),
+               "Water: unable to load init shader");
+    loader.add(_touchShader, "", getShaderSource("touch.frag", getStorageDefines()),
+               "Water: unable to load touch shader");
+    loader.add(_probeShader, getShaderSource("probe.vert"), getShaderSource("probe.frag", getStorageDefines()),
+               "Water: unable to load probe shader");
+    loader.add(_resampleShader, "", getShaderSource("resample.frag", getStorageDefines()),
+               "Water: unable to load resample shader");
+    loader.load();
 
-    loadFile("shaders/init.frag", fragment);
-    searchAndReplace("__UTILS__", utils, fragment);
-    if (!_initShader.loadFromMemory(fragment, sf::Shader::Fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("Water: unable to load init shader");
-    }
+    selectVariants();
 
-    loadFile("shaders/update.frag", fragment);
-    searchAndReplace("__UTILS__", utils, fragment);
-    if (!_updateShader.loadFromMemory(fragment, sf::Shader::Fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("Water: unable to load update shader");
-    }
-
-    loadFile("shaders/touch.frag", fragment);
-    searchAndReplace("__UTILS__", utils, fragment);
-    if (!_touchShader.loadFromMemory(fragment, sf::Shader::Fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("Water: unable to load touch shader");
-    }
-
-    loadFile("shaders/generateHeightmap.frag", fragment);
-    searchAndReplace("__UTILS__", utils, fragment);
-    if (!_generateHeightmapShader.loadFromMemory(fragment, sf::Shader::Fragment)) {
-        std::cerr << fragment << std::endl << std::endl;
-        throw std::runtime_error("Water: unable to load heightmap generation shader");
-    }
+    GLCHECK(glGenBuffers(1, &_probesBufferID));
 
     init();
 }
 
 Water::~Water ()
 {
+    if (_probesBufferID != (GLuint)(-1)) {
+        GLCHECK(glDeleteBuffers(1, &_probesBufferID));
+    }
 }
 
 sf::Vector2u Water::getGridSize() const
@@ -74,17 +122,193 @@ sf::Vector2u Water::getGridSize() const
     return _buffers[0].getSize();
 }
 
+void Water::setPropagation (float propagation)
+{
+    _propagation = propagation;
+}
+float Water::getPropagation() const
+{
+    return _propagation;
+}
+
+void Water::setFriction (float friction)
+{
+    _friction = friction;
+}
+float Water::getFriction() const
+{
+    return _friction;
+}
+
+void Water::setElasticity (float elasticity)
+{
+    _elasticity = elasticity;
+}
+float Water::getElasticity() const
+{
+    return _elasticity;
+}
+
+Water::Storage Water::getStorage() const
+{
+    return _storage;
+}
+
+void Water::setStencil (Stencil stencil)
+{
+    _stencil = stencil;
+    selectVariants();
+}
+Water::Stencil Water::getStencil() const
+{
+    return _stencil;
+}
+
+void Water::setBoundary (Boundary boundary)
+{
+    _boundary = boundary;
+    selectVariants();
+}
+Water::Boundary Water::getBoundary() const
+{
+    return _boundary;
+}
+
+void Water::setArithmetic (Arithmetic arithmetic)
+{
+    if (arithmetic == Arithmetic::FixedPoint && _storage != Storage::Base256)
+        throw std::runtime_error("Water: the fixed-point arithmetic requires the Base256 storage");
+
+    _arithmetic = arithmetic;
+    selectVariants();
+}
+Water::Arithmetic Water::getArithmetic() const
+{
+    return _arithmetic;
+}
+
+void Water::setDisturbances (Disturbances const& disturbances)
+{
+    _disturbances = disturbances;
+    selectVariants();
+}
+Disturbances const& Water::getDisturbances() const
+{
+    return _disturbances;
+}
+
+void Water::setForcing (sf::Texture const* forcing, float positionWeight, float velocityWeight)
+{
+    bool changed = ((forcing == nullptr) != (_forcing == nullptr));
+
+    _forcing = forcing;
+    _forcingWeights.x = std::min(std::max(positionWeight, 0.f), 1.f);
+    _forcingWeights.y = std::min(std::max(velocityWeight, 0.f), 1.f);
+    if (changed)
+        selectVariants();
+}
+sf::Texture const* Water::getForcing() const
+{
+    return _forcing;
+}
+
+void Water::createBuffers (sf::Vector2u size)
+{
+    for (unsigned int i = 0 ; i < _buffers.size() ; ++i)
+        createBuffer(i, size);
+}
+
+void Water::createBuffer (unsigned int index, sf::Vector2u size)
+{
+    sf::RenderTexture& renderTexture = _buffers[index];
+    if (!renderTexture.create(size.x, size.y)) {
+        throw std::runtime_error("Water: unable to create position buffer");
+    }
+    renderTexture.setSmooth(true);
+    renderTexture.setRepeated(true); //toroidal addressing
+
+    if (_storage == Storage::Float)
+        setFloatStorage(renderTexture.getTexture(), GL_RGBA32F, GL_RGBA, false);
+}
+
+void Water::setGridSize (sf::Vector2u size)
+{
+    sf::Vector2u previousSize = getGridSize();
+    if (size == previousSize)
+        return;
+
+    unsigned int nextIndex = (_currentIndex + 1) % 2;
+    sf::Vector2f previousTextureOrigin = getTextureOrigin();
+
+    /* The window keeps its place on the surface, to the nearest cell */
+    _origin.x = std::lround(static_cast<double>(_origin.x) * size.x / previousSize.x);
+    _origin.y = std::lround(static_cast<double>(_origin.y) * size.y / previousSize.y);
+
+    /* The next buffer receives the resampled state, then becomes the current one */
+    createBuffer(nextIndex, size);
+
+    sf::RenderStates noBlending(sf::BlendNone);
+    sf::RectangleShape square(sf::Vector2f(size.x, size.y));
+
+    noBlending.shader = &_resampleShader;
+    _resampleShader.setParameter("oldGrid", _buffers[_currentIndex].getTexture());
+    _resampleShader.setParameter("origin", previousTextureOrigin);
+    _resampleShader.setParameter("cellSize", sf::Vector2f(1.f / size.x, 1.f / size.y));
+    _resampleShader.setParameter("newOrigin", toTextureOrigin(_origin, size));
+    _buffers[nextIndex].clear();
+    _buffers[nextIndex].draw (square, noBlending);
+    _buffers[nextIndex].display();
+
+    /* Its content is overwritten by the next update */
+    createBuffer(_currentIndex, size);
+    _currentIndex = nextIndex;
+}
+
+void Water::selectVariants ()
+{
+    ShaderDefines defines = getStorageDefines();
+    if (_boundary == Boundary::Periodic)
+        defines["BOUNDARY_PERIODIC"] = "";
+    else if (_boundary == Boundary::Fixed)
+        defines["BOUNDARY_FIXED"] = "";
+
+    /* Only the propagation depends on the stencil */
+    _generateHeightmapShader = &_generateHeightmapShaders.get(defines);
+
+    if (_stencil == Stencil::NinePoint)
+        defines["STENCIL_NINE_POINT"] = "";
+    if (_arithmetic == Arithmetic::FixedPoint)
+        defines["ARITHMETIC_FIXED_POINT"] = "";
+    else {
+        if (!_disturbances.isEmpty())
+            defines["DISTURBANCES"] = "";
+        if (_forcing != nullptr)
+            defines["FORCING"] = "";
+    }
+    _updateShader = &_updateShaders.get(defines);
+}
+
+ShaderDefines Water::getStorageDefines () const
+{
+    ShaderDefines defines;
+    if (_storage == Storage::Float)
+        defines["STORAGE_FLOAT"] = "";
+    return defines;
+}
+
 void Water::generateHeightmap()
 {
+    PROFILE_ZONE("Water::generateHeightmap");
     sf::RenderStates noBlending(sf::BlendNone);
     sf::Vector2f heightmapSize(_heightmap.getSize().x, _heightmap.getSize().y);
     sf::Vector2f cellSize(1.f / heightmapSize.x, 1.f / heightmapSize.y);
 
     sf::RectangleShape square(heightmapSize);
 
-    noBlending.shader = &_generateHeightmapShader;
-    _generateHeightmapShader.setParameter("grid", _buffers[_currentIndex].getTexture());
-    _generateHeightmapShader.setParameter("cellSize", cellSize);
+    noBlending.shader = _generateHeightmapShader;
+    _generateHeightmapShader->setParameter("grid", _buffers[_currentIndex].getTexture());
+    _generateHeightmapShader->setParameter("cellSize", cellSize);
+    _generateHeightmapShader->setParameter("origin", getTextureOrigin());
     _heightmap.clear();
     _heightmap.draw (square, noBlending);
     _heightmap.display();
@@ -95,8 +319,19 @@ sf::Texture const& Water::getHeightmap () const
     return _heightmap.getTexture();
 }
 
+sf::Texture const& Water::getState () const
+{
+    return _buffers[_currentIndex].getTexture();
+}
+
+unsigned long Water::getStep () const
+{
+    return _step;
+}
+
 void Water::update (float time)
 {
+    PROFILE_ZONE("Water::update");
     unsigned int nextIndex = (_currentIndex + 1) % 2;
 
     float dt = time * 10.f;
@@ -107,18 +342,43 @@ void Water::update (float time)
     sf::RectangleShape square(bufferSize);
 
     /* Update velocities */
-    noBlending.shader = &_updateShader;
-    _updateShader.setParameter("oldGrid", _buffers[_currentIndex].getTexture());
-    _updateShader.setParameter("cellSize", cellSize);
-    _updateShader.setParameter("dt", dt);
-    _updateShader.setParameter("c", _propagation);
-    _updateShader.setParameter("k", _elasticity);
-    _updateShader.setParameter("f", _friction);
+    noBlending.shader = _updateShader;
+    _updateShader->setParameter("oldGrid", _buffers[_currentIndex].getTexture());
+    _updateShader->setParameter("origin", getTextureOrigin());
+    if (_arithmetic == Arithmetic::FixedPoint) {
+        /* Computed on the CPU, so that they are the same as FixedPointWater's */
+        FixedPointWater::Coefficients coefficients = FixedPointWater::computeCoefficients(dt, _propagation, _friction, _elasticity);
+        auto toVector = [] (FixedPointWater::Coefficient const& coefficient) {
+            return sf::Vector2f(coefficient.mantissa, coefficient.shift);
+        };
+        _updateShader->setParameter("fixedC", toVector(coefficients.propagation));
+        _updateShader->setParameter("fixedK", toVector(coefficients.elasticity));
+        _updateShader->setParameter("fixedF", toVector(coefficients.friction));
+        _updateShader->setParameter("fixedDt", toVector(coefficients.dt));
+    } else {
+        _updateShader->setParameter("cellSize", cellSize);
+        _updateShader->setParameter("dt", dt);
+        _updateShader->setParameter("c", _propagation);
+        _updateShader->setParameter("k", _elasticity);
+        _updateShader->setParameter("f", _friction);
+
+        if (_forcing != nullptr) {
+            _updateShader->setParameter("forcing", *_forcing);
+            _updateShader->setParameter("forcingWeights", _forcingWeights);
+        }
+
+        if (!_disturbances.isEmpty()) {
+            sf::Shader::bind(_updateShader);
+            _disturbances.setUniforms(*_updateShader, _step, static_cast<float>(_step) * time, time);
+            sf::Shader::bind(nullptr);
+        }
+    }
     _buffers[nextIndex].clear();
     _buffers[nextIndex].draw (square, noBlending);
     _buffers[nextIndex].display();
 
     _currentIndex = nextIndex;
+    ++_step;
 }
 
 void Water::init()
@@ -139,8 +399,16 @@ void Water::init()
 
 void Water::touch(sf::Vector2f mousePos, float radius, float extremum)
 {
-    unsigned int nextIndex = (_currentIndex + 1) % 2;
+    Touch touch;
+    touch.pos = mousePos;
+    touch.radius = radius;
+    touch.extremum = extremum;
+    this->touch(std::vector<Touch>(1, touch));
+}
 
+void Water::touch (std::vector<Touch> const& touches)
+{
+    PROFILE_ZONE("Water::touch");
     /* Blending disabled, all four components replaced */
     sf::RenderStates noBlending(sf::BlendNone);
     sf::Vector2f gridSize(getGridSize().x, getGridSize().y);
@@ -149,14 +417,300 @@ void Water::touch(sf::Vector2f mousePos, float radius, float extremum)
     sf::RectangleShape square(gridSize);
 
     noBlending.shader = &_touchShader;
-    _touchShader.setParameter("oldGrid", _buffers[_currentIndex].getTexture());
     _touchShader.setParameter("cellSize", cellSize);
-    _touchShader.setParameter("extremum", extremum);
-    _touchShader.setParameter("radius", radius);
-    _touchShader.setParameter("coords", mousePos);
-    _buffers[nextIndex].clear();
-    _buffers[nextIndex].draw (square, noBlending);
-    _buffers[nextIndex].display();
+    _touchShader.setParameter("origin", getTextureOrigin());
 
-    _currentIndex = nextIndex;
+    GLuint shaderHandle = getShaderHandle(_touchShader, false);
+    GLuint touchesCountULoc = getShaderUniformLoc(shaderHandle, "touchesCount", false);
+    GLuint touchesULoc = getShaderUniformLoc(shaderHandle, "touches", false);
+
+    /* Each touch: x, y, radius, extremum */
+    std::array<float, 4*MAX_TOUCHES_PER_PASS> uniforms;
+    for (std::size_t first = 0 ; first < touches.size() ; first += MAX_TOUCHES_PER_PASS) {
+        std::size_t count = std::min(touches.size() - first, static_cast<std::size_t>(MAX_TOUCHES_PER_PASS));
+        for (std::size_t i = 0 ; i < count ; ++i) {
+            Touch const& touch = touches[first + i];
+            uniforms[4*i + 0] = touch.pos.x;
+            uniforms[4*i + 1] = touch.pos.y;
+            uniforms[4*i + 2] = touch.radius;
+            uniforms[4*i + 3] = touch.extremum;
+        }
+
+        unsigned int nextIndex = (_currentIndex + 1) % 2;
+        _touchShader.setParameter("oldGrid", _buffers[_currentIndex].getTexture());
+        sf::Shader::bind(&_touchShader);
+        GLCHECK(glUniform1i(touchesCountULoc, count));
+        GLCHECK(glUniform4fv(touchesULoc, count, uniforms.data()));
+        sf::Shader::bind(nullptr);
+
+        _buffers[nextIndex].clear();
+        _buffers[nextIndex].draw (square, noBlending);
+        _buffers[nextIndex].display();
+
+        _currentIndex = nextIndex;
+    }
+}
+
+void Water::scroll (sf::Vector2i offset)
+{
+    sf::Vector2i size(getGridSize());
+    if (offset == sf::Vector2i(0, 0))
+        return;
+
+    sf::Vector2i previous = _origin;
+    _origin += offset;
+
+    /* Nothing left from the previous window */
+    if (std::abs(offset.x) >= size.x || std::abs(offset.y) >= size.y) {
+        resetCells(std::vector<sf::IntRect>(1, sf::IntRect(_origin.x, _origin.y, size.x, size.y)));
+        return;
+    }
+
+    /* Newly exposed columns and rows. The other cells are not moved:
+     * they are stored at the same texels, seen from another origin. */
+    std::vector<sf::IntRect> strips;
+    if (offset.x != 0) {
+        int first = (offset.x > 0) ? previous.x + size.x : _origin.x;
+        strips.push_back(sf::IntRect(first, _origin.y, std::abs(offset.x), size.y));
+    }
+    if (offset.y != 0) {
+        int first = (offset.y > 0) ? previous.y + size.y : _origin.y;
+        strips.push_back(sf::IntRect(_origin.x, first, size.x, std::abs(offset.y)));
+    }
+    resetCells(strips);
+}
+
+void Water::centerOn (sf::Vector2f point)
+{
+    sf::Vector2f size(getGridSize());
+    sf::Vector2i origin(std::lround(size.x * (point.x - 0.5f)),
+                        std::lround(size.y * (point.y - 0.5f)));
+    scroll(origin - _origin);
+}
+
+sf::Vector2i Water::getOrigin () const
+{
+    return _origin;
+}
+
+sf::Vector2f Water::getTextureOrigin () const
+{
+    return toTextureOrigin(_origin, getGridSize());
+}
+
+void Water::resetCells (std::vector<sf::IntRect> const& cells)
+{
+    sf::Vector2i size(getGridSize());
+    sf::RenderTexture& buffer = _buffers[_currentIndex];
+
+    /* The init shader everywhere, restricted by the scissor */
+    sf::RenderStates noBlending(sf::BlendNone);
+    noBlending.shader = &_initShader;
+    sf::RectangleShape square(sf::Vector2f(size.x, size.y));
+
+    buffer.setActive(true);
+    GLCHECK(glEnable(GL_SCISSOR_TEST));
+    for (sf::IntRect const& rect : cells) {
+        /* A rectangle crossing the border of the textures is split in up to 4 */
+        int left = wrap(rect.left, size.x);
+        int bottom = wrap(rect.top, size.y);
+        int widths[2] = {std::min(rect.width, size.x - left), rect.width - std::min(rect.width, size.x - left)};
+        int heights[2] = {std::min(rect.height, size.y - bottom), rect.height - std::min(rect.height, size.y - bottom)};
+        for (unsigned int i = 0 ; i < 2 ; ++i) {
+            for (unsigned int j = 0 ; j < 2 ; ++j) {
+                if (widths[i] > 0 && heights[j] > 0) {
+                    GLCHECK(glScissor((i == 0) ? left : 0, (j == 0) ? bottom : 0, widths[i], heights[j]));
+                    buffer.draw(square, noBlending);
+                }
+            }
+        }
+    }
+    GLCHECK(glDisable(GL_SCISSOR_TEST));
+    buffer.display();
+}
+
+void Water::saveCheckpoint (std::string const& filePath) const
+{
+    CheckpointHeader header;
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.width = getGridSize().x;
+    header.height = getGridSize().y;
+    header.currentIndex = _currentIndex;
+    header.step = _step;
+    header.friction = _friction;
+    header.propagation = _propagation;
+    header.elasticity = _elasticity;
+    header.storage = (_storage == Storage::Float) ? 1 : 0;
+    header.originX = _origin.x;
+    header.originY = _origin.y;
+
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("Water: unable to open checkpoint " + filePath + ".");
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    GLint previousTexture = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+    GLCHECK(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+
+    GLenum type = (_storage == Storage::Float) ? GL_FLOAT : GL_UNSIGNED_BYTE;
+    std::size_t componentSize = (_storage == Storage::Float) ? sizeof(float) : 1;
+    std::vector<char> pixels(4 * componentSize * header.width * header.height);
+    for (sf::RenderTexture const& buffer : _buffers) {
+        GLCHECK(glBindTexture(GL_TEXTURE_2D, buffer.getTexture().getNativeHandle()));
+        GLCHECK(glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, type, pixels.data()));
+        file.write(pixels.data(), pixels.size());
+    }
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+
+    if (!file)
+        throw std::runtime_error("Water: unable to write checkpoint " + filePath + ".");
+}
+
+void Water::loadCheckpoint (std::string const& filePath)
+{
+    MappedFile file(filePath);
+
+    CheckpointHeader header;
+    if (file.getSize() < CHECKPOINT_V1_HEADER_SIZE)
+        throw std::runtime_error("Water: checkpoint " + filePath + " is truncated.");
+    std::memcpy(&header, file.getData(), CHECKPOINT_V1_HEADER_SIZE);
+
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error("Water: " + filePath + " is not a checkpoint.");
+    if (header.version != 1 && header.version != CHECKPOINT_VERSION)
+        throw std::runtime_error("Water: checkpoint " + filePath + " has an unsupported version.");
+
+    /* Version 1 has no origin: the window was never scrolled */
+    std::size_t headerSize = (header.version == 1) ? CHECKPOINT_V1_HEADER_SIZE : sizeof(header);
+    if (file.getSize() < headerSize)
+        throw std::runtime_error("Water: checkpoint " + filePath + " is truncated.");
+    if (header.version == 1) {
+        header.originX = 0;
+        header.originY = 0;
+    } else {
+        std::memcpy(&header, file.getData(), headerSize);
+    }
+
+    if (header.storage != ((_storage == Storage::Float) ? 1u : 0u))
+        throw std::runtime_error("Water: checkpoint " + filePath + " has another storage format.");
+
+    GLenum type = (_storage == Storage::Float) ? GL_FLOAT : GL_UNSIGNED_BYTE;
+    std::size_t componentSize = (_storage == Storage::Float) ? sizeof(float) : 1;
+    std::size_t bufferSize = 4 * componentSize * static_cast<std::size_t>(header.width) * header.height;
+    if (header.currentIndex > 1 || file.getSize() < headerSize + 2*bufferSize)
+        throw std::runtime_error("Water: checkpoint " + filePath + " is corrupted.");
+
+    if (getGridSize() != sf::Vector2u(header.width, header.height))
+        createBuffers(sf::Vector2u(header.width, header.height));
+
+    GLint previousTexture = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+    GLCHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+
+    /* Uploaded straight from the mapping: no intermediate copy */
+    const unsigned char* pixels = file.getData() + headerSize;
+    for (sf::RenderTexture& buffer : _buffers) {
+        GLCHECK(glBindTexture(GL_TEXTURE_2D, buffer.getTexture().getNativeHandle()));
+        GLCHECK(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, header.width, header.height, GL_RGBA, type, pixels));
+        pixels += bufferSize;
+    }
+
+    /* Without an unpack buffer bound, the data has been consumed
+     * when glTexSubImage2D returns: the mapping can be released */
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+
+    _currentIndex = header.currentIndex;
+    _step = header.step;
+    _friction = header.friction;
+    _propagation = header.propagation;
+    _elasticity = header.elasticity;
+    _origin = sf::Vector2i(header.originX, header.originY);
+}
+
+bool Water::probe (std::vector<sf::Vector2f> const& points)
+{
+    if (points.empty())
+        return false;
+
+    /* The probes texture only grows, once the pending requests are retrieved */
+    unsigned int nbRows = (points.size() + PROBES_TEXTURE_WIDTH - 1) / PROBES_TEXTURE_WIDTH;
+    if (!_probesReadback || _probesTexture.getSize().y < nbRows) {
+        if (!_pendingProbesCounts.empty())
+            return false;
+        _probesReadback.reset();
+
+        if (!_probesTexture.create(PROBES_TEXTURE_WIDTH, nbRows)) {
+            throw std::runtime_error("Water: unable to create probes buffer");
+        }
+        setFloatStorage(_probesTexture.getTexture(), GL_RGBA32F, GL_RGBA);
+
+        /* Results are expected one frame later: two requests in flight */
+        _probesReadback.reset(new AsyncReadback(_probesTexture.getSize(), 2, GL_FLOAT));
+    }
+
+    if (_probesReadback->getPendingCount() == 2)
+        return false;
+
+    _probesTexture.setActive(true);
+    GLCHECK(glViewport(0, 0, _probesTexture.getSize().x, _probesTexture.getSize().y));
+
+    _probeShader.setParameter("grid", _buffers[_currentIndex].getTexture());
+    _probeShader.setParameter("origin", getTextureOrigin());
+    sf::Shader::bind(&_probeShader);
+
+    GLuint shaderHandle = getShaderHandle(_probeShader, false);
+    GLuint cellSizeULoc = getShaderUniformLoc(shaderHandle, "cellSize", false);
+    GLuint probesTextureSizeULoc = getShaderUniformLoc(shaderHandle, "probesTextureSize", false);
+    GLuint coordsALoc = getShaderAttributeLoc(shaderHandle, "coords", false);
+
+    GLCHECK(glUniform2f(cellSizeULoc, 1.f / static_cast<float>(getGridSize().x), 1.f / static_cast<float>(getGridSize().y)));
+    GLCHECK(glUniform2f(probesTextureSizeULoc, _probesTexture.getSize().x, _probesTexture.getSize().y));
+
+    /* Enabling coordinates buffer */
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _probesBufferID));
+    GLCHECK(glBufferData(GL_ARRAY_BUFFER, points.size()*sizeof(sf::Vector2f), points.data(), GL_STREAM_DRAW));
+    GLCHECK(glEnableVertexAttribArray(coordsALoc));
+    GLCHECK(glVertexAttribPointer(coordsALoc, 2, GL_FLOAT, GL_FALSE, 0, (void*)0));
+
+    /*Actual drawing */
+    GLCHECK(glPointSize(1.f));
+    GLCHECK(glDisable(GL_DEPTH_TEST));
+    GLCHECK(glDisable(GL_BLEND));
+    GLCHECK(glDrawArrays(GL_POINTS, 0, points.size()));
+
+    /* Don't forget to unbind buffers */
+    GLCHECK(glDisableVertexAttribArray(coordsALoc));
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    sf::Shader::bind(0);
+
+    _probesTexture.display();
+
+    _probesReadback->request(_probesTexture.getTexture(), _step);
+    _pendingProbesCounts.push_back(points.size());
+    return true;
+}
+
+bool Water::retrieveProbes (std::vector<Probe>& results, unsigned long& step)
+{
+    if (!_probesReadback || !_probesReadback->retrieve(_probesPixels, step))
+        return false;
+
+    std::size_t count = _pendingProbesCounts.front();
+    _pendingProbesCounts.pop_front();
+
+    results.resize(count);
+    for (std::size_t i = 0 ; i < count ; ++i) {
+        const float* pixel = &_probesPixels[4*i];
+        results[i].position = pixel[0];
+        results[i].velocity = pixel[1];
+        results[i].normal.x = pixel[2];
+        results[i].normal.y = pixel[3];
+        results[i].normal.z = std::sqrt(std::max(0.f, 1.f - pixel[2]*pixel[2] - pixel[3]*pixel[3]));
+    }
+
+    return true;
 }
@@ -0,0 +1,292 @@
+#include "WaterArray.hpp"
+
+#include "GLHelper.hpp"
+#include "ProgramLoader.hpp"
+#include "ShaderSources.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace
+{
+    /* Per vertex: corner (2), propagation, elasticity, friction, layer */
+    const unsigned int FLOATS_PER_VERTEX = 6;
+    const unsigned int VERTICES_PER_LAYER = 6;
+}
+
+WaterArray::WaterArray (sf::Vector2u gridSize,
+                        std::vector<Parameters> const& parameters):
+            _gridSize (gridSize),
+            _parameters (parameters),
+            _layered (false),
+            _currentIndex (0),
+            _step (0),
+            _layersBufferID (-1)
+{
+    _textureIDs.fill(-1);
+    _framebufferIDs.fill(-1);
+
+    if (_parameters.empty())
+        throw std::runtime_error("WaterArray: at least one layer is needed");
+
+    GLint maxLayers = 0;
+    GLCHECK(glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers));
+    if (_parameters.size() > static_cast<std::size_t>(maxLayers))
+        throw std::runtime_error("WaterArray: too many layers");
+
+    /* Layered rendering: the framebuffer holds every layer and
+     * the vertex shader selects one (GL_FramebufferTexture is 3.2) */
+    ShaderDefines layerDefines;
+    if (GLEW_VERSION_3_2 && GLEW_ARB_shader_viewport_layer_array)
+        layerDefines["LAYER_ARB"] = "";
+    else if (GLEW_VERSION_3_2 && GLEW_AMD_vertex_shader_layer)
+        layerDefines["LAYER_AMD"] = "";
+    _layered = !layerDefines.empty();
+
+    /* Textures allocation */
+    GLint previousTexture = 0, previousFramebuffer = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture));
+    GLCHECK(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer));
+
+    GLCHECK(glGenTextures(2, _textureIDs.data()));
+    GLCHECK(glGenFramebuffers(2, _framebufferIDs.data()));
+    for (unsigned int i = 0 ; i < 2 ; ++i) {
+        GLCHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, _textureIDs[i]));
+        GLCHECK(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, _gridSize.x, _gridSize.y, _parameters.size(),
+                             0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+        GLCHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GLCHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        GLCHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GLCHECK(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+        GLCHECK(glBindFramebuffer(GL_FRAMEBUFFER, _framebufferIDs[i]));
+        if (_layered) {
+            GLCHECK(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _textureIDs[i], 0));
+        } else {
+            GLCHECK(glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _textureIDs[i], 0, 0));
+        }
+
+        GLenum status = GL_FRAMEBUFFER_UNSUPPORTED;
+        GLCHECK(status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+            throw std::runtime_error("WaterArray: unable to create position buffer");
+    }
+
+    GLCHECK(glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer));
+    GLCHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, previousTexture));
+
+    /* Shaders loading */
+    ProgramLoader loader;
+    loader.add(_initShader, getShaderSource("waterArray.vert", layerDefines), getShaderSource("waterArrayInit.frag"),
+               "WaterArray: unable to load init shader");
+    loader.add(_updateShader, getShaderSource("waterArray.vert", layerDefines), getShaderSource("waterArrayUpdate.frag"),
+               "WaterArray: unable to load update shader");
+    loader.load();
+
+    GLCHECK(glGenBuffers(1, &_layersBufferID));
+    uploadLayers();
+
+    init();
+}
+
+WaterArray::~WaterArray()
+{
+    if (_layersBufferID != (GLuint)(-1)) {
+        GLCHECK(glDeleteBuffers(1, &_layersBufferID));
+    }
+    if (_framebufferIDs[0] != (GLuint)(-1)) {
+        GLCHECK(glDeleteFramebuffers(2, _framebufferIDs.data()));
+    }
+    if (_textureIDs[0] != (GLuint)(-1)) {
+        GLCHECK(glDeleteTextures(2, _textureIDs.data()));
+    }
+}
+
+sf::Vector2u WaterArray::getGridSize() const
+{
+    return _gridSize;
+}
+
+unsigned int WaterArray::getLayersCount() const
+{
+    return _parameters.size();
+}
+
+void WaterArray::setParameters (unsigned int layer, Parameters const& parameters)
+{
+    if (layer >= _parameters.size())
+        throw std::runtime_error("WaterArray: no such layer");
+
+    _parameters[layer] = parameters;
+    uploadLayers();
+}
+WaterArray::Parameters const& WaterArray::getParameters (unsigned int layer) const
+{
+    if (layer >= _parameters.size())
+        throw std::runtime_error("WaterArray: no such layer");
+
+    return _parameters[layer];
+}
+
+bool WaterArray::isLayered() const
+{
+    return _layered;
+}
+
+GLuint WaterArray::getStateTexture() const
+{
+    return _textureIDs[_currentIndex];
+}
+
+unsigned long WaterArray::getStep () const
+{
+    return _step;
+}
+
+void WaterArray::update (float time)
+{
+    unsigned int nextIndex = (_currentIndex + 1) % 2;
+
+    float dt = time * 10.f;
+
+    /* The pending touches are applied by this update, up to MAX_TOUCHES */
+    unsigned int nbTouches = std::min(static_cast<std::size_t>(MAX_TOUCHES), _pendingTouches.size());
+    std::array<float, 4*MAX_TOUCHES> touches;
+    std::array<float, MAX_TOUCHES> touchesLayers;
+    for (unsigned int i = 0 ; i < nbTouches ; ++i) {
+        std::copy(_pendingTouches[i].values, _pendingTouches[i].values + 4, &touches[4*i]);
+        touchesLayers[i] = _pendingTouches[i].layer;
+    }
+    _pendingTouches.erase(_pendingTouches.begin(), _pendingTouches.begin() + nbTouches);
+
+    sf::Shader::bind(&_updateShader);
+
+    GLuint shaderHandle = getShaderHandle(_updateShader, false);
+    GLuint oldGridsULoc = getShaderUniformLoc(shaderHandle, "oldGrids", false);
+    GLuint cellSizeULoc = getShaderUniformLoc(shaderHandle, "cellSize", false);
+    GLuint dtULoc = getShaderUniformLoc(shaderHandle, "dt", false);
+    GLuint touchesCountULoc = getShaderUniformLoc(shaderHandle, "touchesCount", false);
+    GLuint touchesULoc = getShaderUniformLoc(shaderHandle, "touches", false);
+    GLuint touchesLayersULoc = getShaderUniformLoc(shaderHandle, "touchesLayers", false);
+
+    /* sf::Shader doesn't handle texture arrays: unit 0 is used directly */
+    GLint previousTexture = 0;
+    GLCHECK(glActiveTexture(GL_TEXTURE0));
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture));
+    GLCHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, _textureIDs[_currentIndex]));
+
+    GLCHECK(glUniform1i(oldGridsULoc, 0));
+    GLCHECK(glUniform2f(cellSizeULoc, 1.f / static_cast<float>(_gridSize.x), 1.f / static_cast<float>(_gridSize.y)));
+    GLCHECK(glUniform1f(dtULoc, dt));
+    GLCHECK(glUniform1i(touchesCountULoc, nbTouches));
+    if (nbTouches > 0) {
+        GLCHECK(glUniform4fv(touchesULoc, nbTouches, touches.data()));
+        GLCHECK(glUniform1fv(touchesLayersULoc, nbTouches, touchesLayers.data()));
+    }
+
+    drawLayers(_updateShader, nextIndex);
+
+    GLCHECK(glBindTexture(GL_TEXTURE_2D_ARRAY, previousTexture));
+    sf::Shader::bind(0);
+
+    _currentIndex = nextIndex;
+    ++_step;
+}
+
+void WaterArray::init ()
+{
+    _pendingTouches.clear();
+
+    sf::Shader::bind(&_initShader);
+    drawLayers(_initShader, 0);
+    drawLayers(_initShader, 1);
+    sf::Shader::bind(0);
+}
+
+void WaterArray::touch (unsigned int layer, sf::Vector2f pos, float radius, float extremum)
+{
+    if (layer >= _parameters.size())
+        throw std::runtime_error("WaterArray: no such layer");
+
+    Touch touch;
+    touch.layer = static_cast<float>(layer);
+    touch.values[0] = pos.x;
+    touch.values[1] = pos.y;
+    touch.values[2] = radius;
+    touch.values[3] = extremum;
+    _pendingTouches.push_back(touch);
+}
+
+void WaterArray::uploadLayers ()
+{
+    const float corners[VERTICES_PER_LAYER][2] = {{-1,-1}, {+1,+1}, {-1,+1},
+                                                  {-1,-1}, {+1,+1}, {+1,-1}};
+
+    std::vector<float> vertices;
+    vertices.reserve(_parameters.size() * VERTICES_PER_LAYER * FLOATS_PER_VERTEX);
+    for (unsigned int iLayer = 0 ; iLayer < _parameters.size() ; ++iLayer) {
+        Parameters const& parameters = _parameters[iLayer];
+        for (unsigned int iVertex = 0 ; iVertex < VERTICES_PER_LAYER ; ++iVertex) {
+            vertices.push_back(corners[iVertex][0]);
+            vertices.push_back(corners[iVertex][1]);
+            vertices.push_back(parameters.propagation);
+            vertices.push_back(parameters.elasticity);
+            vertices.push_back(parameters.friction);
+            vertices.push_back(static_cast<float>(iLayer));
+        }
+    }
+
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _layersBufferID));
+    GLCHECK(glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(float), vertices.data(), GL_STATIC_DRAW));
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+void WaterArray::drawLayers (sf::Shader const& shader, unsigned int targetIndex)
+{
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4];
+    GLCHECK(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer));
+    GLCHECK(glGetIntegerv(GL_VIEWPORT, previousViewport));
+
+    GLCHECK(glBindFramebuffer(GL_FRAMEBUFFER, _framebufferIDs[targetIndex]));
+    GLCHECK(glViewport(0, 0, _gridSize.x, _gridSize.y));
+
+    GLuint shaderHandle = getShaderHandle(shader, false);
+    GLuint cornerALoc = getShaderAttributeLoc(shaderHandle, "corner", false);
+    GLuint parametersALoc = getShaderAttributeLoc(shaderHandle, "parameters", false);
+
+    /* Enabling layers buffer */
+    const GLsizei stride = FLOATS_PER_VERTEX * sizeof(float);
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, _layersBufferID));
+    GLCHECK(glEnableVertexAttribArray(cornerALoc));
+    GLCHECK(glVertexAttribPointer(cornerALoc, 2, GL_FLOAT, GL_FALSE, stride, (void*)0));
+    /* The init program doesn't read the parameters: the attribute is optimized out */
+    bool hasParameters = (parametersALoc != (GLuint)(-1));
+    if (hasParameters) {
+        GLCHECK(glEnableVertexAttribArray(parametersALoc));
+        GLCHECK(glVertexAttribPointer(parametersALoc, 4, GL_FLOAT, GL_FALSE, stride, (void*)(2*sizeof(float))));
+    }
+
+    /*Actual drawing */
+    GLCHECK(glDisable(GL_DEPTH_TEST));
+    GLCHECK(glDisable(GL_BLEND));
+    if (_layered) {
+        GLCHECK(glDrawArrays(GL_TRIANGLES, 0, VERTICES_PER_LAYER * _parameters.size()));
+    } else {
+        for (unsigned int iLayer = 0 ; iLayer < _parameters.size() ; ++iLayer) {
+            GLCHECK(glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _textureIDs[targetIndex], 0, iLayer));
+            GLCHECK(glDrawArrays(GL_TRIANGLES, VERTICES_PER_LAYER * iLayer, VERTICES_PER_LAYER));
+        }
+    }
+
+    /* Don't forget to unbind buffers */
+    if (hasParameters) {
+        GLCHECK(glDisableVertexAttribArray(parametersALoc));
+    }
+    GLCHECK(glDisableVertexAttribArray(cornerALoc));
+    GLCHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+    GLCHECK(glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]));
+    GLCHECK(glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer));
+}
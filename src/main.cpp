@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <SFML/System/Clock.hpp>
 #include <SFML/System/Time.hpp>
@@ -11,9 +18,30 @@
 #include <GL/glew.h>
 
 #include "Water.hpp"
+#include "Disturbances.hpp"
+#include "AsyncUpload.hpp"
+#include "CpuWater.hpp"
+#include "FixedPointWater.hpp"
+#include "OutOfCoreWater.hpp"
 #include "Renderer2D.hpp"
+#include "CpuRenderer2D.hpp"
+#include "CpuLightsRenderer.hpp"
+#include "CpuRenderer3D.hpp"
 #include "Renderer3D.hpp"
 #include "LightsRenderer.hpp"
+#include "Recorder.hpp"
+#include "RecordingReader.hpp"
+#include "HeightmapPublisher.hpp"
+#include "FrameCapture.hpp"
+#include "GLHelper.hpp"
+#include "ProgramLoader.hpp"
+#include "PassTimer.hpp"
+#include "Profiler.hpp"
+#include "QualityGovernor.hpp"
+#include "InputJournal.hpp"
+#include "ReplayDriver.hpp"
+#include "ControlServer.hpp"
+#include "MetricsExporter.hpp"
 #include "Camera.hpp"
 
 #define DISPLAY3D
@@ -29,8 +57,450 @@ sf::Vector2f getRelativeMousePos (sf::Window const& window)
     return pos;
 }
 
-int main()
+/* Reads the current state back (RGBA8, bottom row first), blocking */
+void readState (Water const& water, std::vector<std::uint8_t>& pixels)
 {
+    sf::Vector2u size = water.getGridSize();
+    pixels.resize(4 * size.x * size.y);
+
+    GLint previousTexture = 0;
+    GLCHECK(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture));
+    GLCHECK(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, water.getState().getNativeHandle()));
+    GLCHECK(glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data()));
+    GLCHECK(glBindTexture(GL_TEXTURE_2D, previousTexture));
+}
+
+/* FNV-1a hash of the current state, to compare runs */
+unsigned long long hashState (Water const& water)
+{
+    std::vector<std::uint8_t> pixels;
+    readState(water, pixels);
+
+    unsigned long long hash = 14695981039346656037ull;
+    for (std::uint8_t byte : pixels) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* Replays a journal headlessly, for nbSteps steps (by default, as many as the session).
+ * The whole pipeline runs: simulation, lights and 3D rendering offscreen. */
+int replay (std::string const& journalPath, unsigned long nbSteps)
+{
+    sf::Context context(sf::ContextSettings(1, 0, 0, 3, 0), 1, 1);
+    context.setActive(true);
+    glewInit();
+
+    InputJournal journal;
+    journal.load(journalPath);
+    InputJournal::Settings const& settings = journal.getSettings();
+
+    Water water(settings.gridSize, settings.propagation, settings.friction, settings.elasticity);
+    LightsRenderer lightsRenderer(256);
+    Renderer3D renderer3D (256, 0.4f, 0.5f, 0.9f, glm::vec4(.1, .1, .6, 1), 1.5f);
+
+    sf::RenderTexture target;
+    if (!target.create(800, 600, true))
+        throw std::runtime_error("unable to create replay target");
+    renderer3D.getCamera().setAspectRatio(target.getSize().x, target.getSize().y);
+
+    sf::Texture groundTexture;
+    if (!groundTexture.loadFromFile("rc/tiles.png"))
+        throw std::runtime_error("unable to open rc/tiles.png");
+    groundTexture.setSmooth(true);
+    groundTexture.setRepeated(true);
+
+    ReplayDriver driver(journal, water, &renderer3D.getCamera());
+    if (nbSteps == 0)
+        nbSteps = journal.getStepsCount();
+    nbSteps = std::max(nbSteps, driver.getLastStep() + 1);
+
+    sf::Clock clock;
+    for (unsigned long i = 0 ; i < nbSteps ; ++i) {
+        driver.step();
+        water.generateHeightmap();
+        lightsRenderer.update(water.getHeightmap());
+
+        target.setActive(true);
+        GLCHECK(glViewport(0, 0, target.getSize().x, target.getSize().y));
+        renderer3D.draw(water.getHeightmap(), groundTexture, lightsRenderer.getTexture());
+        target.display();
+    }
+    GLCHECK(glFinish());
+    float duration = clock.getElapsedTime().asSeconds();
+
+    std::cout << "replayed " << nbSteps << " steps in " << duration << " s ("
+              << static_cast<float>(nbSteps) / duration << " steps/s)" << std::endl;
+    std::cout << "state hash: " << std::hex << hashState(water) << std::dec << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+/* Compares the speed of the lights methods, on the same agitated surface,
+ * headlessly. Each update is finished before the next one: the times include
+ * the whole GPU work of the lights. */
+int lightsBenchmark (unsigned int quality, unsigned int nbUpdates)
+{
+    sf::Context context(sf::ContextSettings(0, 0, 0, 3, 0), 1, 1);
+    context.setActive(true);
+    glewInit();
+
+    /* Waves in every direction, from touches spread over the surface */
+    Water water(sf::Vector2u(512, 512), 20.f, 0.99f, 0.4f);
+    std::vector<Water::Touch> touches;
+    for (unsigned int i = 0 ; i < 16 ; ++i) {
+        sf::Vector2f pos(static_cast<float>(i % 4) / 4.f + 0.125f, static_cast<float>(i / 4) / 4.f + 0.125f);
+        touches.push_back({pos, 0.05f, (i % 2 == 0) ? 0.9f : -0.9f});
+    }
+    water.touch(touches);
+    for (unsigned int i = 0 ; i < 120 ; ++i)
+        water.update(1.f / 60.f);
+    water.generateHeightmap();
+
+    LightsRenderer lightsRenderer(quality);
+    const LightsRenderer::Mode modes[] = {LightsRenderer::Mode::Points, LightsRenderer::Mode::AreaRatio};
+    const char* modeNames[] = {"points", "area ratio"};
+    for (unsigned int iMode = 0 ; iMode < 2 ; ++iMode) {
+        lightsRenderer.setMode(modes[iMode]);
+        lightsRenderer.update(water.getHeightmap()); //warm-up
+        GLCHECK(glFinish());
+
+        sf::Clock clock;
+        for (unsigned int i = 0 ; i < nbUpdates ; ++i) {
+            lightsRenderer.update(water.getHeightmap());
+            GLCHECK(glFinish());
+        }
+        float duration = clock.getElapsedTime().asSeconds();
+        std::cout << modeNames[iMode] << ": " << 1000.f * duration / static_cast<float>(nbUpdates)
+                  << " ms per update at " << quality << "x" << quality << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* Runs the CPU solvers for nbSteps steps, out-of-core (in statePath)
+ * then in memory if the grid fits, and prints their speeds. */
+int cpuBenchmark (sf::Vector2u gridSize, unsigned long nbSteps, std::string const& statePath)
+{
+    const float timestep = 1.f / 60.f;
+    const sf::Vector2f touchPos(0.5f, 0.5f);
+    const float cellUpdates = static_cast<float>(gridSize.x) * gridSize.y * nbSteps;
+
+    OutOfCoreWater outOfCore(statePath, gridSize, 20.f, 0.995f, 0.7f);
+    outOfCore.touch(touchPos, 0.03f, -0.8f);
+    sf::Clock clock;
+    for (unsigned long i = 0 ; i < nbSteps ; ++i)
+        outOfCore.update(timestep);
+    outOfCore.flush();
+    float duration = clock.getElapsedTime().asSeconds();
+    std::cout << "out-of-core: " << nbSteps << " steps in " << duration << " s ("
+              << cellUpdates / duration << " cell updates/s)" << std::endl;
+
+    std::unique_ptr<CpuWater> inMemory;
+    try {
+        inMemory.reset(new CpuWater(gridSize, 20.f, 0.995f, 0.7f));
+    } catch (std::bad_alloc const&) {
+        std::cout << "in-memory: the grid doesn't fit in memory" << std::endl;
+        return EXIT_SUCCESS;
+    }
+    inMemory->touch(touchPos, 0.03f, -0.8f);
+    clock.restart();
+    for (unsigned long i = 0 ; i < nbSteps ; ++i)
+        inMemory->update(timestep);
+    duration = clock.getElapsedTime().asSeconds();
+    std::cout << "in-memory: " << nbSteps << " steps in " << duration << " s ("
+              << cellUpdates / duration << " cell updates/s)" << std::endl;
+
+    /* Both solvers are expected to give the same state */
+    unsigned int differingRows = 0;
+    for (unsigned int y = 0 ; y < gridSize.y ; ++y) {
+        const float* row = inMemory->getState() + 2 * static_cast<std::size_t>(gridSize.x) * y;
+        if (std::memcmp(row, outOfCore.getRow(y), 2 * sizeof(float) * gridSize.x) != 0)
+            ++differingRows;
+    }
+    std::cout << "differing rows: " << differingRows << std::endl;
+
+    inMemory.reset();
+    FixedPointWater fixedPoint(gridSize, 20.f, 0.995f, 0.7f);
+    clock.restart();
+    for (unsigned long i = 0 ; i < nbSteps ; ++i)
+        fixedPoint.update(timestep);
+    duration = clock.getElapsedTime().asSeconds();
+    std::cout << "fixed-point: " << nbSteps << " steps in " << duration << " s ("
+              << cellUpdates / duration << " cell updates/s)" << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+/* Runs the fixed-point arithmetic for nbSteps steps on the GPU and on the CPU,
+ * from the same perturbed state, with each stencil and boundary mode,
+ * and prints the number of cells whose state differs. */
+int fixedPointCheck (sf::Vector2u gridSize, unsigned long nbSteps)
+{
+    sf::Context context(sf::ContextSettings(0, 0, 0, 3, 0), 1, 1);
+    context.setActive(true);
+    glewInit();
+
+    const float timestep = 1.f / 60.f;
+    const Water::Stencil stencils[] = {Water::Stencil::FivePoint, Water::Stencil::NinePoint};
+    const Water::Boundary boundaries[] = {Water::Boundary::Clamp, Water::Boundary::Periodic, Water::Boundary::Fixed};
+    const char* stencilNames[] = {"5-point", "9-point"};
+    const char* boundaryNames[] = {"clamp", "periodic", "fixed"};
+
+    Water gpu(gridSize, 20.f, 0.995f, 0.7f);
+    gpu.setArithmetic(Water::Arithmetic::FixedPoint);
+    FixedPointWater cpu(gridSize, 20.f, 0.995f, 0.7f);
+
+    int result = EXIT_SUCCESS;
+    std::vector<std::uint8_t> gpuState, cpuState;
+    for (unsigned int iS = 0 ; iS < 2 ; ++iS) {
+        for (unsigned int iB = 0 ; iB < 3 ; ++iB) {
+            gpu.setStencil(stencils[iS]);
+            gpu.setBoundary(boundaries[iB]);
+            cpu.setStencil(stencils[iS]);
+            cpu.setBoundary(boundaries[iB]);
+
+            /* The perturbations are computed with floats: the CPU starts from the GPU state */
+            gpu.init();
+            gpu.touch(sf::Vector2f(0.3f, 0.4f), 0.05f, -0.8f);
+            gpu.touch(sf::Vector2f(0.9f, 0.5f), 0.2f, 0.5f);
+            readState(gpu, gpuState);
+            cpu.setState(gpuState.data());
+
+            for (unsigned long i = 0 ; i < nbSteps ; ++i) {
+                gpu.update(timestep);
+                cpu.update(timestep);
+            }
+            readState(gpu, gpuState);
+            cpu.getState(cpuState);
+
+            std::size_t differingCells = 0;
+            for (std::size_t i = 0 ; i < gpuState.size() ; i += 4) {
+                if (std::memcmp(gpuState.data() + i, cpuState.data() + i, 4) != 0)
+                    ++differingCells;
+            }
+            std::cout << stencilNames[iS] << ", " << boundaryNames[iB] << ": "
+                      << differingCells << " differing cells" << std::endl;
+            if (differingCells > 0)
+                result = EXIT_FAILURE;
+        }
+    }
+
+    return result;
+}
+
+/* Writes pixels (RGBA, bottom row first) to a PNG file */
+void savePNG (std::vector<std::uint8_t> const& pixels, sf::Vector2u size, std::string const& path)
+{
+    /* sf::Image is top row first */
+    const unsigned int rowSize = 4 * size.x;
+    std::vector<std::uint8_t> flipped(pixels.size());
+    for (unsigned int iY = 0 ; iY < size.y ; ++iY)
+        std::memcpy(flipped.data() + iY * rowSize, pixels.data() + (size.y - 1 - iY) * rowSize, rowSize);
+
+    sf::Image image;
+    image.create(size.x, size.y, flipped.data());
+    if (!image.saveToFile(path))
+        throw std::runtime_error("unable to write " + path + ".");
+    std::cout << "written to " << path << std::endl;
+}
+
+/* Renders a frame of a heightmap recording on the CPU, the last one if
+ * frame is out of range, to outputPrefix_2D.png, outputPrefix_lights.png
+ * and outputPrefix_3D.png, and prints the rendering speed of each. */
+int cpuRender (std::string const& recordingPath, std::string const& outputPrefix, std::size_t frame)
+{
+    const sf::Vector2u size(512, 512);
+    const unsigned int nbRenders = 100;
+
+    RecordingReader reader(recordingPath);
+    if (reader.getContent() != RecordingContent::Heightmap || reader.getFramesCount() == 0)
+        throw std::runtime_error("cpuRender: " + recordingPath + " holds no heightmap.");
+    frame = std::min(frame, reader.getFramesCount() - 1);
+    std::cout << "frame " << frame << " (step " << reader.getStep(frame) << ")" << std::endl;
+
+    std::vector<std::uint8_t> heightmap;
+    reader.readFrame(frame, heightmap);
+
+    sf::Image groundImage;
+    if (!groundImage.loadFromFile("rc/tiles.png"))
+        throw std::runtime_error("cpuRender: unable to load rc/tiles.png.");
+
+    /* Same settings as the interactive mode */
+    float amplitude = 0.2f;
+    float waterLevel = 0.5f;
+    float eta = 0.9f;
+    glm::vec4 waterColor(.1, .1, .6, 1);
+    float viewDistance = 1.5f;
+    CpuRenderer2D renderer2D (amplitude, waterLevel, eta, waterColor, viewDistance);
+    renderer2D.setGroundTexture(groundImage);
+    CpuLightsRenderer lightsRenderer(256);
+    CpuRenderer3D renderer3D (2.f*amplitude, waterLevel, eta, waterColor, viewDistance);
+    renderer3D.setGroundTexture(groundImage);
+
+    std::vector<std::uint8_t> pixels;
+    sf::Clock clock;
+    for (unsigned int i = 0 ; i < nbRenders ; ++i)
+        renderer2D.draw(heightmap.data(), reader.getSize(), size, pixels);
+    float duration = clock.getElapsedTime().asSeconds();
+    std::cout << "2D: " << nbRenders / duration << " frames/s at " << size.x << "x" << size.y << std::endl;
+    savePNG(pixels, size, outputPrefix + "_2D.png");
+
+    clock.restart();
+    for (unsigned int i = 0 ; i < nbRenders ; ++i)
+        lightsRenderer.update(heightmap.data(), reader.getSize());
+    duration = clock.getElapsedTime().asSeconds();
+    sf::Vector2u lightsSize(lightsRenderer.getQuality(), lightsRenderer.getQuality());
+    std::cout << "lights: " << nbRenders / duration << " updates/s at " << lightsSize.x << "x" << lightsSize.y << std::endl;
+    savePNG(lightsRenderer.getPixels(), lightsSize, outputPrefix + "_lights.png");
+
+    const sf::Vector2u size3D(1280, 720);
+    const unsigned int nbRenders3D = 10;
+    renderer3D.getCamera().setAspectRatio(size3D.x, size3D.y);
+    clock.restart();
+    for (unsigned int i = 0 ; i < nbRenders3D ; ++i)
+        renderer3D.draw(heightmap.data(), reader.getSize(), lightsRenderer.getPixels().data(), lightsSize, size3D, pixels);
+    duration = clock.getElapsedTime().asSeconds();
+    std::cout << "3D: " << duration / nbRenders3D << " s per frame at " << size3D.x << "x" << size3D.y << std::endl;
+    savePNG(pixels, size3D, outputPrefix + "_3D.png");
+
+    return EXIT_SUCCESS;
+}
+
+/* Disturbances of a weather: 0 calm, 1 rain, 2 storm */
+Disturbances createWeather (unsigned int weather)
+{
+    Disturbances disturbances;
+    if (weather == 0)
+        return disturbances;
+
+    Disturbances::Rain rain;
+    rain.rate = (weather == 1) ? 20.f : 400.f;
+    rain.minRadius = 0.005f;
+    rain.maxRadius = (weather == 1) ? 0.01f : 0.015f;
+    rain.extremum = -0.1f;
+    disturbances.setRain(rain);
+
+    if (weather == 2) {
+        /* A boat going round, and swell coming from the left */
+        Disturbances::PointSource boat;
+        boat.path = {sf::Vector2f(0.25f, 0.25f), sf::Vector2f(0.75f, 0.25f),
+                     sf::Vector2f(0.75f, 0.75f), sf::Vector2f(0.25f, 0.75f)};
+        boat.speed = 0.1f;
+        boat.radius = 0.02f;
+        boat.amplitude = -1.5f;
+        boat.frequency = 2.f;
+        disturbances.addPointSource(boat);
+
+        Disturbances::WaveMaker swell;
+        swell.from = sf::Vector2f(0.02f, 0.f);
+        swell.to = sf::Vector2f(0.02f, 1.f);
+        swell.width = 0.02f;
+        swell.amplitude = 0.3f;
+        swell.frequency = 0.5f;
+        disturbances.addWaveMaker(swell);
+    }
+
+    return disturbances;
+}
+
+/* Usage:
+ *   water-simulation                        interactive
+ *   water-simulation --record journal.txt   interactive, inputs saved to the journal
+ *   water-simulation --control control.sock   interactive, also driven through the socket
+ *   water-simulation --metrics 9100|metrics.sock   interactive, metrics served on the port or socket
+ *   water-simulation --metrics-snapshot metrics.prom   interactive, metrics written every 10 s
+ *     (these options can be combined)
+ *   water-simulation --replay journal.txt [steps]   headless replay
+ *   water-simulation --lights-benchmark quality updates   points and area ratio lights speed
+ *   water-simulation --cpu-benchmark width height steps [state.bin]   CPU solvers speed
+ *   water-simulation --cpu-render recording.bin prefix [frame]   CPU rendering of a recorded heightmap
+ *   water-simulation --fixed-point-check width height steps   GPU and CPU fixed-point arithmetics comparison
+ */
+int main(int argc, char* argv[])
+{
+    /* The linked programs are kept from one run to the next */
+    ProgramLoader::setCacheDirectory("cache");
+
+    std::string journalPath;
+    if (argc >= 3 && std::string(argv[1]) == "--replay") {
+        unsigned long nbSteps = (argc >= 4) ? std::strtoul(argv[3], nullptr, 10) : 0;
+        try {
+            return replay(argv[2], nbSteps);
+        } catch (std::exception const& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else if (argc >= 4 && std::string(argv[1]) == "--lights-benchmark") {
+        unsigned int quality = std::strtoul(argv[2], nullptr, 10);
+        unsigned int nbUpdates = std::strtoul(argv[3], nullptr, 10);
+        if (quality < 2 || nbUpdates < 1) {
+            std::cerr << "usage: --lights-benchmark quality updates (quality >= 2, updates >= 1)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            return lightsBenchmark(quality, nbUpdates);
+        } catch (std::exception const& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else if (argc >= 5 && std::string(argv[1]) == "--cpu-benchmark") {
+        sf::Vector2u gridSize(std::strtoul(argv[2], nullptr, 10), std::strtoul(argv[3], nullptr, 10));
+        unsigned long nbSteps = std::strtoul(argv[4], nullptr, 10);
+        std::string statePath = (argc >= 6) ? argv[5] : "cpu-state.bin";
+        if (gridSize.x < 1 || gridSize.y < 1 || nbSteps < 1) {
+            std::cerr << "usage: --cpu-benchmark width height steps [state.bin] (width, height, steps >= 1)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            return cpuBenchmark(gridSize, nbSteps, statePath);
+        } catch (std::exception const& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else if (argc >= 4 && std::string(argv[1]) == "--cpu-render") {
+        std::size_t frame = (argc >= 5) ? std::strtoul(argv[4], nullptr, 10) : static_cast<std::size_t>(-1);
+        try {
+            return cpuRender(argv[2], argv[3], frame);
+        } catch (std::exception const& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    } else if (argc >= 5 && std::string(argv[1]) == "--fixed-point-check") {
+        sf::Vector2u gridSize(std::strtoul(argv[2], nullptr, 10), std::strtoul(argv[3], nullptr, 10));
+        unsigned long nbSteps = std::strtoul(argv[4], nullptr, 10);
+        try {
+            return fixedPointCheck(gridSize, nbSteps);
+        } catch (std::exception const& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Options of the interactive mode, in any order */
+    std::string controlPath, metricsAddress, metricsSnapshotPath;
+    for (int i = 1 ; i < argc ; i += 2) {
+        std::string option = argv[i];
+        std::string* value = nullptr;
+        if (option == "--record")
+            value = &journalPath;
+        else if (option == "--control")
+            value = &controlPath;
+        else if (option == "--metrics")
+            value = &metricsAddress;
+        else if (option == "--metrics-snapshot")
+            value = &metricsSnapshotPath;
+
+        if (value == nullptr || i + 1 >= argc) {
+            std::cerr << (value == nullptr ? "unknown option: " : "missing value: ") << option << std::endl;
+            std::cerr << "usage: [--record journal.txt] [--control control.sock] [--metrics port|socket] [--metrics-snapshot metrics.prom]" << std::endl;
+            return EXIT_FAILURE;
+        }
+        *value = argv[i + 1];
+    }
+
     /* Creation of the windows and contexts */
     sf::ContextSettings openGL2DContext(0, 0, 0, //no depth, no stencil, no antialiasing
                                        3, 0, //openGL 3.0 requested
@@ -75,6 +545,19 @@ int main()
     sf::Vector2u gridSize(512, 512);
     Water water(gridSize, propagation, friction, elasticity);
 
+    /* Fixed timestep, so that sessions can be replayed exactly */
+    const float timestep = 1.f / 60.f;
+    const unsigned int maxStepsPerFrame = 4;
+
+    InputJournal journal;
+    InputJournal::Settings journalSettings;
+    journalSettings.gridSize = gridSize;
+    journalSettings.propagation = propagation;
+    journalSettings.friction = friction;
+    journalSettings.elasticity = elasticity;
+    journalSettings.timestep = timestep;
+    journal.setSettings(journalSettings);
+
 
     /* Creation of the renderers */
     float amplitude = 0.2f;
@@ -89,6 +572,7 @@ int main()
     
     sf::Vector2f mousePos3D = getRelativeMousePos(window3D);
     bool updateCamera = false;
+    bool cameraChanged = false;
 #endif //DISPLAY3D
     LightsRenderer lightsRenderer(256);
     
@@ -98,10 +582,113 @@ int main()
     groundTexture.setSmooth(true);
     groundTexture.setRepeated(true);
 
+    std::cout << "programs: " << ProgramLoader::getCacheHitsCount() << " from cache, "
+              << ProgramLoader::getCompiledCount() << " compiled" << std::endl;
+
+    std::unique_ptr<Recorder> recorder;
+    std::unique_ptr<HeightmapPublisher> publisher;
+    std::unique_ptr<FrameCapture> capture2D, capture3D;
+
+    /* Quality governor: the settings are adjusted to the GPU time of the passes.
+     * Disabled when recording a journal, whose settings must not change. */
+    enum Pass { SimulationPass, LightsPass, Display2DPass, Display3DPass, PassesCount };
+    const unsigned int gridSizes[] = {128, 256, 512, 1024};
+    const unsigned int surfaceQualities[] = {64, 128, 256, 512};
+    const unsigned int lightsQualities[] = {64, 128, 256, 512};
+    const unsigned int particlesPerPixel[] = {1, 2, 3, 4};
+    QualityGovernor governor(0.8f * timestep, PassesCount); //margin for the CPU and the compositor
+    unsigned int gridKnob = governor.addKnob(SimulationPass, 4, 2, 4.f);
+    unsigned int surfaceKnob = governor.addKnob(Display3DPass, 4, 2, 4.f);
+    unsigned int lightsKnob = governor.addKnob(LightsPass, 4, 2, 4.f);
+    unsigned int particlesKnob = governor.addKnob(LightsPass, 4, 1, 4.f); //at most 4 from 1 to 2 particles per pixel
+    window2D.setActive(true);
+    PassTimer passTimer(PassesCount);
+    bool governing = PassTimer::isAvailable() && journalPath.empty();
+    std::vector<float> passTimes;
+
+    /* Profiler trace, toggled with the T key: the GPU passes are timed too */
+    const char* passNames[] = {"simulation", "lights", "display 2D", "display 3D"};
+    bool tracing = false;
+    std::vector<std::uint64_t> passTimestamps;
+    Profiler::setThreadName("main");
+
+    /* Traced: a context switch can cost as much as a pass */
+    auto activate = [&] (sf::RenderWindow& window) {
+        PROFILE_ZONE("context switch");
+        window.setActive(true);
+    };
+
+    /* The timestamps are all written in the context of the 2D window */
+    auto endPass = [&] (Pass pass) {
+        if (governing || tracing) {
+            activate(window2D);
+            passTimer.endPass(pass);
+        }
+    };
+
+    /* Procedural disturbances, cycled with the W key.
+     * Not journaled: disabled when recording a journal. */
+    const char* weatherNames[] = {"calm", "rain", "storm"};
+    unsigned int weather = 0;
+
+    /* External forcing, toggled with the E key: a field streamed every
+     * frame, standing for sensor data. Not journaled either. */
+    std::unique_ptr<AsyncUpload> forcingUpload;
+    float forcingTime = 0.f;
+
+    /* Commands from other processes, applied and journaled like the other inputs */
+    std::unique_ptr<ControlServer> controlServer;
+    std::vector<ControlCommand> controlCommands;
+    if (!controlPath.empty()) {
+        controlServer.reset(new ControlServer(controlPath));
+        std::cout << "control socket: " << controlServer->getPath() << std::endl;
+    }
+
+    /* Runtime metrics, always updated: only their export is optional */
+    MetricsRegistry metrics;
+    MetricsHistogram& frameTimes = metrics.addHistogram("water_frame_seconds", "Time between two frames.", 1e-6, 26);
+    MetricsCounter& stepsCounter = metrics.addCounter("water_simulation_steps_total", "Simulation steps computed.");
+    MetricsGauge& stepsRate = metrics.addGauge("water_simulation_steps_per_second", "Simulation steps computed during the last second.");
+    MetricsCounter& lateFramesCounter = metrics.addCounter("water_late_frames_total", "Frames whose lag was dropped, the simulation being too slow.");
+    MetricsCounter& touchesCounter = metrics.addCounter("water_touches_total", "Touches applied, from the mouse and from the control socket.");
+    MetricsGauge& touchesRate = metrics.addGauge("water_touches_per_second", "Touches applied during the last second.");
+    MetricsCounter& commandsCounter = metrics.addCounter("water_control_commands_total", "Commands received through the control socket.");
+    MetricsCounter& ignoredCommandsCounter = metrics.addCounter("water_control_commands_ignored_total", "Parameters commands ignored while recording a journal.");
+    MetricsGauge& publisherDropped = metrics.addGauge("water_publisher_dropped_frames", "Frames dropped by the current heightmap publisher.");
+    MetricsGauge& recorderDropped = metrics.addGauge("water_recorder_dropped_frames", "Frames dropped by the current recorder.");
+    MetricsGauge& gpuMemory = metrics.addGauge("water_gpu_memory_used_bytes", "Video memory in use on the device, by every process.");
+    std::unique_ptr<MetricsExporter> metricsExporter;
+    if (!metricsAddress.empty() || !metricsSnapshotPath.empty()) {
+        metricsExporter.reset(new MetricsExporter(metrics, metricsAddress, metricsSnapshotPath));
+        if (!metricsAddress.empty())
+            std::cout << "metrics: " << metricsExporter->getAddress() << std::endl;
+        if (!metricsSnapshotPath.empty())
+            std::cout << "metrics snapshots: " << metricsSnapshotPath << std::endl;
+    }
+    sf::Clock metricsClock;
+    unsigned long stepsSinceRates = 0, touchesSinceRates = 0;
+
+    /* The touches are applied in a single batch before the next step,
+     * or before an input that can't be batched with them. The replay
+     * batches them the same way (see ReplayDriver). */
+    std::vector<Water::Touch> touches;
+    auto flushTouches = [&] () {
+        if (!touches.empty()) {
+            touchesCounter.increment(touches.size());
+            touchesSinceRates += touches.size();
+            water.touch(touches);
+            touches.clear();
+        }
+    };
+
     /* Main loop */
     int loops = 0;
+    float lag = 0.f;
     sf::Clock fpsCounter, clock;
     while (window2D.isOpen()) {
+        PROFILE_ZONE("frame");
+        PROFILE_SECTIONS("events");
+
         sf::Event event;
         while (window2D.pollEvent(event)) {
             switch (event.type) {
@@ -110,21 +697,220 @@ int main()
                 break;
                 case sf::Event::KeyReleased:
                     if (event.key.code == sf::Keyboard::R) {
+                        flushTouches();
+                        journal.recordInit(water.getStep());
                         water.init();
+                    } else if (event.key.code == sf::Keyboard::C) {
+                        if (lightsRenderer.getMode() == LightsRenderer::Mode::Points) {
+                            lightsRenderer.setMode(LightsRenderer::Mode::AreaRatio);
+                            std::cout << "caustics: area ratio" << std::endl;
+                        } else {
+                            lightsRenderer.setMode(LightsRenderer::Mode::Points);
+                            std::cout << "caustics: points" << std::endl;
+                        }
+                    } else if (event.key.code == sf::Keyboard::S) {
+                        /* The pending touches are not flushed: the replay
+                         * must batch them the same way (see ReplayDriver) */
+                        try {
+                            water.saveCheckpoint("checkpoint.bin");
+                            std::cout << "checkpoint saved" << std::endl;
+                        } catch (std::exception const& e) {
+                            std::cerr << e.what() << std::endl;
+                        }
+                    } else if (event.key.code == sf::Keyboard::L) {
+                        /* Not journaled, and rewinds the step: the journal would be unsorted */
+                        if (!journalPath.empty()) {
+                            std::cout << "checkpoint: loading disabled while recording a journal" << std::endl;
+                        } else {
+                            flushTouches();
+                            try {
+                                water.loadCheckpoint("checkpoint.bin");
+                                std::cout << "checkpoint loaded" << std::endl;
+                            } catch (std::exception const& e) {
+                                std::cerr << e.what() << std::endl;
+                            }
+                        }
+                    } else if (event.key.code == sf::Keyboard::V) {
+                        if (recorder) {
+                            std::cout << "recording stopped: " << recorder->getRecordedCount() << " frames, "
+                                      << recorder->getDroppedCount() << " dropped" << std::endl;
+                            recorder.reset();
+                        } else {
+                            sf::Vector2u heightmapSize = water.getHeightmap().getSize();
+                            recorder.reset(new Recorder("recording.bin", heightmapSize, RecordingContent::Heightmap, 2));
+                            std::cout << "recording started" << std::endl;
+                        }
+                    } else if (event.key.code == sf::Keyboard::P) {
+                        if (publisher) {
+                            std::cout << "publishing stopped: " << publisher->getPublishedCount() << " frames, "
+                                      << publisher->getDroppedCount() << " dropped" << std::endl;
+                            publisher.reset();
+                        } else {
+                            try {
+                                publisher.reset(new HeightmapPublisher(water.getHeightmap().getSize()));
+                                std::cout << "publishing to " << publisher->getName() << std::endl;
+                            } catch (std::exception const& e) {
+                                std::cerr << e.what() << std::endl;
+                            }
+                        }
+                    } else if (event.key.code == sf::Keyboard::F) {
+                        if (capture2D) {
+                            std::cout << "capture stopped: "
+                                      << capture2D->getCapturedCount() << " frames (" << capture2D->getDroppedCount() << " dropped) in 2D, "
+                                      << capture3D->getCapturedCount() << " frames (" << capture3D->getDroppedCount() << " dropped) in 3D" << std::endl;
+                            capture2D.reset();
+                            capture3D.reset();
+                        } else {
+                            /* Shift+F for PNG images, F for Y4M videos */
+                            FrameCapture::Format format = event.key.shift ? FrameCapture::Format::PNG : FrameCapture::Format::Y4M;
+                            capture2D.reset(new FrameCapture("capture2D", format));
+                            capture3D.reset(new FrameCapture("capture3D", format));
+                            std::cout << "capture started" << std::endl;
+                        }
+                    } else if (event.key.code == sf::Keyboard::Left || event.key.code == sf::Keyboard::Right ||
+                               event.key.code == sf::Keyboard::Down || event.key.code == sf::Keyboard::Up) {
+                        /* The window moves over the surface by 1/16 of its size */
+                        sf::Vector2i stepSize(water.getGridSize().x / 16, water.getGridSize().y / 16);
+                        sf::Vector2i offset(0, 0);
+                        if (event.key.code == sf::Keyboard::Left)
+                            offset.x = -stepSize.x;
+                        else if (event.key.code == sf::Keyboard::Right)
+                            offset.x = stepSize.x;
+                        else if (event.key.code == sf::Keyboard::Down)
+                            offset.y = -stepSize.y;
+                        else
+                            offset.y = stepSize.y;
+                        flushTouches();
+                        journal.recordScroll(water.getStep(), offset);
+                        water.scroll(offset);
+                    } else if (event.key.code == sf::Keyboard::G) {
+                        if (!PassTimer::isAvailable()) {
+                            std::cout << "quality governor: timer queries unsupported" << std::endl;
+                        } else if (!journalPath.empty()) {
+                            std::cout << "quality governor: disabled while recording a journal" << std::endl;
+                        } else {
+                            governing = !governing;
+                            if (!governing && !tracing)
+                                passTimer.reset();
+                            std::cout << "quality governor: " << (governing ? "on" : "off") << std::endl;
+                        }
+                    } else if (event.key.code == sf::Keyboard::W) {
+                        if (!journalPath.empty()) {
+                            std::cout << "weather: disabled while recording a journal" << std::endl;
+                        } else {
+                            weather = (weather + 1) % 3;
+                            water.setDisturbances(createWeather(weather));
+                            std::cout << "weather: " << weatherNames[weather] << std::endl;
+                        }
+                    } else if (event.key.code == sf::Keyboard::E) {
+                        if (!journalPath.empty()) {
+                            std::cout << "external forcing: disabled while recording a journal" << std::endl;
+                        } else if (forcingUpload) {
+                            water.setForcing(nullptr);
+                            std::cout << "external forcing: off (" << forcingUpload->getUploadedCount() << " frames, "
+                                      << forcingUpload->getDroppedCount() << " dropped)" << std::endl;
+                            forcingUpload.reset();
+                        } else {
+                            window2D.setActive(true);
+                            forcingUpload.reset(new AsyncUpload(sf::Vector2u(64, 64)));
+                            water.setForcing(&forcingUpload->getTexture(), 0.02f, 0.f);
+                            std::cout << "external forcing: on" << std::endl;
+                        }
+                    } else if (event.key.code == sf::Keyboard::T) {
+#ifdef PROFILING
+                        tracing = !tracing;
+                        if (tracing) {
+                            activate(window2D);
+                            Profiler::synchronizeGpuClock();
+                            Profiler::setEnabled(true);
+                            std::cout << "trace started" << std::endl;
+                        } else {
+                            Profiler::setEnabled(false);
+                            if (!governing)
+                                passTimer.reset();
+                            try {
+                                Profiler::exportTrace("trace.json");
+                                std::cout << "trace saved to trace.json (" << Profiler::getDroppedCount() << " zones dropped)" << std::endl;
+                            } catch (std::exception const& e) {
+                                std::cerr << e.what() << std::endl;
+                            }
+                        }
+#else
+                        std::cout << "profiler: compiled out, build with make PROFILE=1" << std::endl;
+#endif //PROFILING
+                    } else if (event.key.code == sf::Keyboard::A) {
+                        unsigned int subsets = lightsRenderer.getAmortization();
+                        subsets = (subsets >= 4) ? 1 : 2*subsets;
+                        lightsRenderer.setAmortization(subsets);
+                        std::cout << "caustics amortized over " << subsets << " frames" << std::endl;
                     }
                 break;
                 case sf::Event::MouseButtonPressed:
-                    if (event.mouseButton.button == sf::Mouse::Left)
-                        water.touch(getRelativeMousePos(window2D), touchRadius, touchExtremum);
+                    if (event.mouseButton.button == sf::Mouse::Left) {
+                        /* Read once: the journal must hold the position applied */
+                        sf::Vector2f pos = getRelativeMousePos(window2D);
+                        journal.recordTouch(water.getStep(), pos, touchRadius, touchExtremum);
+                        touches.push_back({pos, touchRadius, touchExtremum});
+                    }
                 break;
                 case sf::Event::MouseMoved:
-                    if (sf::Mouse::isButtonPressed(sf::Mouse::Left))
-                        water.touch(getRelativeMousePos(window2D), touchRadius, touchExtremum*0.1f);
+                    if (sf::Mouse::isButtonPressed(sf::Mouse::Left)) {
+                        sf::Vector2f pos = getRelativeMousePos(window2D);
+                        journal.recordTouch(water.getStep(), pos, touchRadius, touchExtremum*0.1f);
+                        touches.push_back({pos, touchRadius, touchExtremum*0.1f});
+                    }
                 break;
                 default:
                     break;
             }
         }
+
+        if (controlServer) {
+            controlCommands.clear();
+            commandsCounter.increment(controlServer->drain(controlCommands));
+            for (ControlCommand const& command : controlCommands) {
+                const float* values = command.values;
+                switch (command.type) {
+                    case ControlCommandType::Touch:
+                        journal.recordTouch(water.getStep(), sf::Vector2f(values[0], values[1]), values[2], values[3]);
+                        touches.push_back({sf::Vector2f(values[0], values[1]), values[2], values[3]});
+                    break;
+                    case ControlCommandType::Init:
+                        flushTouches();
+                        journal.recordInit(water.getStep());
+                        water.init();
+                    break;
+                    case ControlCommandType::Camera:
+#ifdef DISPLAY3D
+                        renderer3D.getCamera().setDistance(values[0]);
+                        renderer3D.getCamera().setLatitude(values[1]);
+                        renderer3D.getCamera().setLongitude(values[2]);
+                        cameraChanged = true;
+#endif //DISPLAY3D
+                    break;
+                    case ControlCommandType::Scroll:
+                    {
+                        sf::Vector2i offset(static_cast<int>(values[0]), static_cast<int>(values[1]));
+                        flushTouches();
+                        journal.recordScroll(water.getStep(), offset);
+                        water.scroll(offset);
+                    }
+                    break;
+                    case ControlCommandType::Parameters:
+                        /* Not journaled: the settings of a journal are fixed */
+                        if (journalPath.empty()) {
+                            water.setPropagation(values[0]);
+                            water.setFriction(values[1]);
+                            water.setElasticity(values[2]);
+                        } else {
+                            if (ignoredCommandsCounter.getValue() == 0)
+                                std::cout << "control parameters: ignored while recording a journal" << std::endl;
+                            ignoredCommandsCounter.increment();
+                        }
+                    break;
+                }
+            }
+        }
 #ifdef DISPLAY3D
         while (window3D.pollEvent(event)) {
             switch (event.type) {
@@ -137,6 +923,7 @@ int main()
                     float distance = renderer3D.getCamera().getDistance();
                     distance += 0.01f * event.mouseWheelScroll.delta;
                     renderer3D.getCamera().setDistance(distance);
+                    cameraChanged = true;
                 }
                 break;
                 case sf::Event::MouseMoved:
@@ -163,40 +950,168 @@ int main()
 
             renderer3D.getCamera().setLatitude(latitude);
             renderer3D.getCamera().setLongitude(longitude);
+            cameraChanged = true;
         }
         mousePos3D = newMousePos3D;
+
+        if (cameraChanged) {
+            cameraChanged = false;
+            Camera const& camera = renderer3D.getCamera();
+            journal.recordCamera(water.getStep(), camera.getDistance(), camera.getLatitude(), camera.getLongitude());
+        }
 #endif //DISPLAY3D
         
         sf::Time elapsedTime = clock.getElapsedTime();
         clock.restart();
+        frameTimes.record(elapsedTime.asMicroseconds());
+
+        if (governing || tracing) {
+            activate(window2D);
+            passTimer.beginFrame();
+        }
+
+        /* Travelling waves, written while the GPU still reads the previous frames */
+        PROFILE_NEXT_SECTION("forcing");
+        if (forcingUpload) {
+            activate(window2D);
+            forcingTime += elapsedTime.asSeconds();
+            sf::Vector2u size = forcingUpload->getSize();
+            float* field = forcingUpload->beginFrame();
+            if (field != nullptr) {
+                for (unsigned int iY = 0 ; iY < size.y ; ++iY) {
+                    float v = (static_cast<float>(iY) + 0.5f) / static_cast<float>(size.y);
+                    for (unsigned int iX = 0 ; iX < size.x ; ++iX) {
+                        float u = (static_cast<float>(iX) + 0.5f) / static_cast<float>(size.x);
+                        float* texel = field + 2 * (iY * size.x + iX);
+                        texel[0] = 0.5f * std::sin(6.283185307f * (4.f * u - 0.5f * forcingTime)) * std::sin(3.141592654f * v);
+                        texel[1] = 0.f;
+                    }
+                }
+                forcingUpload->endFrame();
+            }
+        }
+
+        /* Simulation, with a fixed timestep. If late, the lag is dropped. */
+        PROFILE_NEXT_SECTION("simulation");
+        lag += elapsedTime.asSeconds();
+        unsigned int nbSteps = 0;
+        while (lag >= timestep && nbSteps < maxStepsPerFrame) {
+            flushTouches();
+            water.update(timestep);
+            lag -= timestep;
+            ++nbSteps;
+        }
+        if (nbSteps == maxStepsPerFrame) {
+            lag = 0.f;
+            lateFramesCounter.increment();
+        }
+        stepsCounter.increment(nbSteps);
+        stepsSinceRates += nbSteps;
 
-        /* Simulation */
-        water.update(elapsedTime.asSeconds());
         water.generateHeightmap();
+        if (recorder)
+            recorder->update(water);
+        if (publisher)
+            publisher->update(water);
+        endPass(SimulationPass);
+        PROFILE_NEXT_SECTION("lights");
 #ifdef DISPLAYLIGHTS
         lightsRenderer.update(water.getHeightmap());
 #endif //DISPLAYLIGHTS
+        endPass(LightsPass);
 
         /* Rendering */
+        PROFILE_NEXT_SECTION("draw 2D");
         window2D.clear(sf::Color::Green);
-        window2D.setActive(true);
+        activate(window2D);
         renderer2D.draw (water.getHeightmap(), groundTexture);
+        if (capture2D)
+            capture2D->capture(window2D.getSize());
+        endPass(Display2DPass);
+        PROFILE_NEXT_SECTION("display 2D");
         window2D.display();
 
+        PROFILE_NEXT_SECTION("draw 3D");
 #ifdef DISPLAY3D
         window3D.clear(sf::Color(0.2,0.2,0.2));
         glViewport(0,0,window3D.getSize().x,window3D.getSize().y);
-        window3D.setActive(true);
+        activate(window3D);
         renderer3D.draw (water.getHeightmap(), groundTexture, lightsRenderer.getTexture());
+        if (capture3D)
+            capture3D->capture(window3D.getSize());
+#endif //DISPLAY3D
+        endPass(Display3DPass);
+        PROFILE_NEXT_SECTION("display 3D");
+#ifdef DISPLAY3D
         window3D.display();
 #endif //DISPLAY3D
 
+        /* Timings of a frame from a few frames ago */
+        PROFILE_NEXT_SECTION("timings");
+        bool measured = (governing || tracing) && passTimer.retrieve(passTimes, passTimestamps);
+        if (measured && tracing) {
+            for (unsigned int pass = 0 ; pass < PassesCount ; ++pass)
+                Profiler::recordGpu(passNames[pass], passTimestamps[pass], passTimestamps[pass + 1]);
+        }
+        if (measured && governing && governor.update(passTimes)) {
+            unsigned int gridSize = gridSizes[governor.getLevel(gridKnob)];
+            water.setGridSize(sf::Vector2u(gridSize, gridSize));
+#ifdef DISPLAY3D
+            renderer3D.setQuality(surfaceQualities[governor.getLevel(surfaceKnob)]);
+#endif //DISPLAY3D
+            lightsRenderer.setQuality(lightsQualities[governor.getLevel(lightsKnob)]);
+            lightsRenderer.setParticlesPerPixel(particlesPerPixel[governor.getLevel(particlesKnob)]);
+
+            std::cout << "quality: grid " << gridSize
+                      << ", surface " << surfaceQualities[governor.getLevel(surfaceKnob)]
+                      << ", lights " << lightsRenderer.getQuality() << " x " << lightsRenderer.getParticlesPerPixel()
+                      << std::endl;
+        }
+
+        /* Rates and polled values, once per second */
+        float metricsPeriod = metricsClock.getElapsedTime().asSeconds();
+        if (metricsPeriod >= 1.f) {
+            metricsClock.restart();
+            stepsRate.setValue(stepsSinceRates / metricsPeriod);
+            touchesRate.setValue(touchesSinceRates / metricsPeriod);
+            stepsSinceRates = 0;
+            touchesSinceRates = 0;
+
+            publisherDropped.setValue(publisher ? publisher->getDroppedCount() : 0);
+            recorderDropped.setValue(recorder ? recorder->getDroppedCount() : 0);
+            GLuint64 usedBytes = 0;
+            if (getGpuMemoryUsage(usedBytes))
+                gpuMemory.setValue(static_cast<double>(usedBytes));
+        }
+
        // std::cout << 1.f / elapsedTime.asSeconds() << std::endl;
         ++loops;
 
     }
 
     std::cout << "average fps: " << static_cast<float>(loops) / fpsCounter.getElapsedTime().asSeconds() << std::endl;
+    /* In the overflow bucket, only a lower bound is known */
+    auto formatFrameTime = [&frameTimes](double q) {
+        std::ostringstream text;
+        std::uint64_t quantile = frameTimes.getQuantile(q);
+        if (quantile == std::numeric_limits<std::uint64_t>::max())
+            text << "> " << (frameTimes.getBucketLimit(frameTimes.getBucketsCount() - 1) + 1) / 1e6 << " s";
+        else
+            text << quantile / 1000.f << " ms";
+        return text.str();
+    };
+    std::cout << "frame time: " << formatFrameTime(0.5) << " median, "
+              << formatFrameTime(0.99) << " at the 99th percentile" << std::endl;
+
+    if (!journalPath.empty()) {
+        try {
+            journal.setStepsCount(water.getStep());
+            journal.save(journalPath);
+            std::cout << "journal saved to " << journalPath << " (" << water.getStep() << " steps)" << std::endl;
+        } catch (std::exception const& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,87 @@
+/* Load generator for the control socket (see ControlProtocol.hpp).
+ *
+ * Usage: controlLoad [socket] [commands per second] [seconds]
+ *
+ * Sends small touches at random positions, at the given rate
+ * (100000 by default) for the given duration (10 s by default),
+ * then prints the rate actually sustained.
+ */
+
+#include "ControlProtocol.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+int main (int argc, char** argv)
+{
+    std::string path = (argc > 1) ? argv[1] : CONTROL_SOCKET_PATH;
+    double rate = (argc > 2) ? std::strtod(argv[2], nullptr) : 100000.0;
+    double duration = (argc > 3) ? std::strtod(argv[3], nullptr) : 10.0;
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "controlLoad: unable to connect to " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> position(0.f, 1.f);
+
+    /* Batches of 1 ms worth of commands */
+    typedef std::chrono::steady_clock Clock;
+    const std::chrono::milliseconds period(1);
+    std::size_t batchSize = std::max(1.0, rate / 1000.0);
+    std::vector<ControlCommand> batch(batchSize);
+
+    unsigned long sentCount = 0;
+    Clock::time_point start = Clock::now();
+    Clock::time_point next = start;
+    while (std::chrono::duration<double>(Clock::now() - start).count() < duration) {
+        for (ControlCommand& command : batch) {
+            command.type = ControlCommandType::Touch;
+            command.values[0] = position(generator);
+            command.values[1] = position(generator);
+            command.values[2] = 0.01f;
+            command.values[3] = -0.01f;
+        }
+
+        const char* data = reinterpret_cast<const char*>(batch.data());
+        std::size_t size = batch.size() * sizeof(ControlCommand);
+        while (size > 0) {
+            ssize_t written = write(fd, data, size);
+            if (written < 0) {
+                std::cerr << "controlLoad: connection lost" << std::endl;
+                return EXIT_FAILURE;
+            }
+            data += written;
+            size -= written;
+        }
+        sentCount += batch.size();
+
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << sentCount << " commands in " << elapsed << " s: "
+              << sentCount / elapsed << " commands per second" << std::endl;
+    close(fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/* Build step: embeds the shaders in the executable.
+ *
+ * Usage: embedShaders output.cpp shader1 [shader2 ...]
+ *
+ * Writes a source file defining EMBEDDED_SHADERS (see ShaderSources.hpp):
+ * one entry per shader, named after the file, with every
+ * #include "file" directive replaced by the content of the file.
+ * Included files are looked up in the directory of the including one,
+ * and each one is included at most once per shader.
+ *
+ * #line directives are inserted around the included content, so that
+ * the compilation errors refer to the lines of the original files:
+ * source string 0 is the shader itself, 1, 2... the included files
+ * in their order of inclusion.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+    const std::string RAW_DELIMITER = "GLSL";
+
+    std::string getDirectory (std::string const& path)
+    {
+        std::string::size_type slash = path.find_last_of("/\\");
+        return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+    }
+
+    std::string getFileName (std::string const& path)
+    {
+        std::string::size_type slash = path.find_last_of("/\\");
+        return (slash == std::string::npos) ? path : path.substr(slash + 1);
+    }
+
+    /* Returns true and the included path if line is an #include directive. */
+    bool parseInclude (std::string const& line, std::string& included)
+    {
+        std::string::size_type pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line.compare(pos, 1, "#") != 0)
+            return false;
+
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if (pos == std::string::npos || line.compare(pos, 7, "include") != 0)
+            return false;
+
+        std::string::size_type begin = line.find('"', pos + 7);
+        std::string::size_type end = (begin == std::string::npos) ? begin : line.find('"', begin + 1);
+        if (end == std::string::npos)
+            throw std::runtime_error("malformed directive: " + line);
+
+        included = line.substr(begin + 1, end - begin - 1);
+        return true;
+    }
+
+    void expand (std::string const& path,
+                 unsigned int sourceNumber,
+                 std::set<std::string>& included,
+                 unsigned int& sourcesCount,
+                 std::ostringstream& output)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+            throw std::runtime_error("unable to open " + path);
+
+        std::string line, includedPath;
+        unsigned int lineNumber = 0;
+        while (std::getline(file, line)) {
+            ++lineNumber;
+
+            if (!parseInclude(line, includedPath)) {
+                output << line << "\n";
+                continue;
+            }
+
+            includedPath = getDirectory(path) + includedPath;
+            if (included.insert(includedPath).second) {
+                unsigned int includedNumber = ++sourcesCount;
+                output << "#line 1 " << includedNumber << "\n";
+                expand(includedPath, includedNumber, included, sourcesCount, output);
+            }
+            output << "#line " << lineNumber + 1 << " " << sourceNumber << "\n";
+        }
+    }
+}
+
+int main (int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " output.cpp shader1 [shader2 ...]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ostringstream table;
+    try {
+        for (int i = 2 ; i < argc ; ++i) {
+            std::set<std::string> included;
+            unsigned int sourcesCount = 0;
+            std::ostringstream source;
+            expand(argv[i], 0, included, sourcesCount, source);
+
+            if (source.str().find(")" + RAW_DELIMITER + "\"") != std::string::npos)
+                throw std::runtime_error(std::string(argv[i]) + " contains the raw string delimiter");
+
+            table << "    {\"" << getFileName(argv[i]) << "\", R\"" << RAW_DELIMITER << "(" << source.str()
+                  << ")" << RAW_DELIMITER << "\"},\n";
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "embedShaders: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream output(argv[1], std::ios::trunc);
+    output << "/* Generated by tools/embedShaders.cpp: do not edit. */\n\n"
+           << "#include \"ShaderSources.hpp\"\n\n\n"
+           << "const EmbeddedShader EMBEDDED_SHADERS[] = {\n"
+           << table.str()
+           << "};\n\n"
+           << "const std::size_t EMBEDDED_SHADERS_COUNT = sizeof(EMBEDDED_SHADERS) / sizeof(EMBEDDED_SHADERS[0]);\n";
+
+    if (!output) {
+        std::cerr << "embedShaders: unable to write " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
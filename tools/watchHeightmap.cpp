@@ -0,0 +1,50 @@
+/* Example subscriber: follows the heightmap published by the simulation
+ * (press P in the 2D window), reading the frames in place.
+ *
+ * Usage: watchHeightmap [name]
+ *
+ * Prints the step and the mean relative height of the latest frame,
+ * about once per second, until interrupted.
+ */
+
+#include "HeightmapSubscriber.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+
+int main (int argc, char** argv)
+{
+    try {
+        HeightmapSubscriber subscriber(argc > 1 ? argv[1] : SHARED_HEIGHTMAP_NAME);
+
+        std::uint64_t lastFrame = 0;
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+
+            HeightmapSubscriber::Frame frame;
+            if (subscriber.getLatestFrame() == lastFrame || !subscriber.acquire(frame))
+                continue;
+
+            /* The height is in the alpha channel, 0.5 at rest */
+            std::uint64_t sum = 0;
+            std::size_t pixelsCount = std::size_t(frame.width) * frame.height;
+            for (std::size_t i = 0 ; i < pixelsCount ; ++i)
+                sum += frame.pixels[4*i + 3];
+
+            /* Otherwise the sum mixes two frames */
+            if (!subscriber.isValid(frame))
+                continue;
+
+            lastFrame = frame.frame;
+            std::cout << "step " << frame.step << ": mean height "
+                      << double(sum) / (255.0 * pixelsCount) - 0.5 << std::endl;
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "watchHeightmap: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}